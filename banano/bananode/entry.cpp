@@ -129,9 +129,11 @@ int main (int argc, char * const * argv)
 		("debug_verify_profile", "Profile signature verification")
 		("debug_profile_sign", "Profile signature generation")
 		("debug_xorshift_profile", "Profile xorshift algorithms")
+		("debug_validate_ledger", "Check block chains and the tables derived from them, using <threads> cores")
+		("rebuild_derived", "Rebuild representation, block info, checksum and account totals from the block chains")
 		("platform", boost::program_options::value<std::string> (), "Defines the <platform> for OpenCL commands")
 		("device", boost::program_options::value<std::string> (), "Defines <device> for OpenCL command")
-		("threads", boost::program_options::value<std::string> (), "Defines <threads> count for OpenCL command");
+		("threads", boost::program_options::value<std::string> (), "Defines <threads> count for OpenCL and ledger validation commands");
 	// clang-format on
 
 	boost::program_options::variables_map vm;
@@ -235,6 +237,40 @@ int main (int argc, char * const * argv)
 			std::cout << boost::str (boost::format ("%1% %2% %3%\n") % i->first.to_account () % i->second.convert_to<std::string> () % total.convert_to<std::string> ());
 		}
 	}
+	else if (vm.count ("debug_validate_ledger") || vm.count ("rebuild_derived"))
+	{
+		auto threads (std::max<unsigned> (1, std::thread::hardware_concurrency ()));
+		if (vm.count ("threads") == 1)
+		{
+			try
+			{
+				threads = boost::lexical_cast<unsigned> (vm["threads"].as<std::string> ());
+			}
+			catch (boost::bad_lexical_cast & e)
+			{
+				std::cerr << "Invalid threads count\n";
+				result = -1;
+			}
+		}
+		if (!result)
+		{
+			auto rebuild (vm.count ("rebuild_derived") > 0);
+			rai::inactive_node node (data_path);
+			rai::ledger_validator validator (node.node->ledger, threads);
+			auto begin (std::chrono::steady_clock::now ());
+			auto errors (rebuild ? validator.rebuild () : validator.validate ());
+			auto end (std::chrono::steady_clock::now ());
+			for (auto & i : errors)
+			{
+				std::cerr << i << '\n';
+			}
+			std::cout << boost::str (boost::format ("%1% %2% accounts and %3% blocks with %4% threads in %5% milliseconds, %6% problems found\n") % (rebuild ? "Rebuilt" : "Validated") % validator.accounts % validator.blocks % threads % std::chrono::duration_cast<std::chrono::milliseconds> (end - begin).count () % errors.size ());
+			if (!errors.empty ())
+			{
+				result = -1;
+			}
+		}
+	}
 	else if (vm.count ("debug_frontier_count"))
 	{
 		rai::inactive_node node (data_path);
@@ -1,5 +1,6 @@
 #include <queue>
 #include <banano/blockstore.hpp>
+#include <banano/node/common.hpp>
 #include <banano/versioning.hpp>
 
 namespace
@@ -22,9 +23,10 @@ public:
 		rai::block_type type;
 		auto value (store.block_get_raw (transaction, block_a.previous (), type));
 		assert (value.mv_size != 0);
-		std::vector<uint8_t> data (static_cast<uint8_t *> (value.mv_data), static_cast<uint8_t *> (value.mv_data) + value.mv_size);
+		std::vector<uint8_t> data (1, static_cast<uint8_t> (type));
+		data.insert (data.end (), static_cast<uint8_t *> (value.mv_data), static_cast<uint8_t *> (value.mv_data) + value.mv_size);
 		std::copy (hash.bytes.begin (), hash.bytes.end (), data.end () - hash.bytes.size ());
-		store.block_put_raw (transaction, store.block_database (type), block_a.previous (), rai::mdb_val (data.size (), data.data ()));
+		store.block_put_raw (transaction, block_a.previous (), rai::mdb_val (data.size (), data.data ()));
 	}
 	void send_block (rai::send_block const & block_a) override
 	{
@@ -45,6 +47,59 @@ public:
 	MDB_txn * transaction;
 	rai::block_store & store;
 };
+
+// Arrival is big endian so keys sort oldest first
+std::array<uint8_t, 72> unchecked_arrival_key (uint64_t arrival_a, rai::block_hash const & dependency_a, rai::block_hash const & hash_a)
+{
+	std::array<uint8_t, 72> result;
+	for (auto i (0); i < 8; ++i)
+	{
+		result[i] = static_cast<uint8_t> (arrival_a >> (56 - 8 * i));
+	}
+	std::copy (dependency_a.bytes.begin (), dependency_a.bytes.end (), result.begin () + 8);
+	std::copy (hash_a.bytes.begin (), hash_a.bytes.end (), result.begin () + 40);
+	return result;
+}
+
+// Unchecked values are the serialized block followed by the arrival time
+uint64_t unchecked_arrival_read (rai::mdb_val const & value_a)
+{
+	uint64_t result (0);
+	assert (value_a.size () >= sizeof (result));
+	std::memcpy (&result, reinterpret_cast<uint8_t const *> (value_a.data ()) + value_a.size () - sizeof (result), sizeof (result));
+	return result;
+}
+
+bool unchecked_matches (rai::mdb_val const & value_a, std::vector<uint8_t> const & block_a)
+{
+	return value_a.size () == block_a.size () + sizeof (uint64_t) && std::memcmp (value_a.data (), block_a.data (), block_a.size ()) == 0;
+}
+
+std::array<uint8_t, 64> delegator_key (rai::account const & representative_a, rai::account const & account_a)
+{
+	std::array<uint8_t, 64> result;
+	std::copy (representative_a.bytes.begin (), representative_a.bytes.end (), result.begin ());
+	std::copy (account_a.bytes.begin (), account_a.bytes.end (), result.begin () + 32);
+	return result;
+}
+
+// Big endian height so a chain iterates in order
+std::array<uint8_t, 40> chain_height_key (rai::account const & account_a, uint64_t height_a)
+{
+	std::array<uint8_t, 40> result;
+	std::copy (account_a.bytes.begin (), account_a.bytes.end (), result.begin ());
+	for (auto i (0); i < 8; ++i)
+	{
+		result[32 + i] = static_cast<uint8_t> (height_a >> (56 - 8 * i));
+	}
+	return result;
+}
+}
+
+rai::pending_total::pending_total () :
+count (0),
+amount (0)
+{
 }
 
 rai::store_entry::store_entry () :
@@ -232,19 +287,276 @@ rai::store_iterator rai::block_store::vote_end ()
 	return rai::store_iterator (nullptr);
 }
 
-rai::block_store::block_store (bool & error_a, boost::filesystem::path const & path_a, int lmdb_max_dbs) :
-environment (error_a, path_a, lmdb_max_dbs),
+size_t constexpr rai::block_cache::shard_count;
+
+rai::block_cache::block_cache (size_t capacity_a) :
+capacity (capacity_a),
+hits (0),
+misses (0),
+shard_capacity ((capacity_a + shard_count - 1) / shard_count)
+{
+	for (auto & i : shards)
+	{
+		i.last_delete = 0;
+	}
+}
+
+rai::block_cache::shard & rai::block_cache::shard_for (rai::block_hash const & hash_a)
+{
+	return shards[hash_a.bytes[0] % shard_count];
+}
+
+std::shared_ptr<rai::block const> rai::block_cache::get (rai::block_hash const & hash_a)
+{
+	std::shared_ptr<rai::block const> result;
+	auto & shard_l (shard_for (hash_a));
+	{
+		std::lock_guard<std::mutex> lock (shard_l.mutex);
+		auto existing (shard_l.index.find (hash_a));
+		if (existing != shard_l.index.end ())
+		{
+			shard_l.entries.splice (shard_l.entries.begin (), shard_l.entries, existing->second);
+			result = existing->second->second;
+		}
+	}
+	if (result != nullptr)
+	{
+		++hits;
+	}
+	else
+	{
+		++misses;
+	}
+	return result;
+}
+
+void rai::block_cache::put (rai::block_hash const & hash_a, std::shared_ptr<rai::block const> const & block_a, size_t transaction_id_a)
+{
+	if (shard_capacity > 0)
+	{
+		auto & shard_l (shard_for (hash_a));
+		std::lock_guard<std::mutex> lock (shard_l.mutex);
+		if (transaction_id_a >= shard_l.last_delete)
+		{
+			auto existing (shard_l.index.find (hash_a));
+			if (existing != shard_l.index.end ())
+			{
+				shard_l.entries.splice (shard_l.entries.begin (), shard_l.entries, existing->second);
+			}
+			else
+			{
+				shard_l.entries.emplace_front (hash_a, block_a);
+				shard_l.index[hash_a] = shard_l.entries.begin ();
+				if (shard_l.entries.size () > shard_capacity)
+				{
+					shard_l.index.erase (shard_l.entries.back ().first);
+					shard_l.entries.pop_back ();
+				}
+			}
+		}
+	}
+}
+
+void rai::block_cache::erase (rai::block_hash const & hash_a, size_t transaction_id_a)
+{
+	auto & shard_l (shard_for (hash_a));
+	std::lock_guard<std::mutex> lock (shard_l.mutex);
+	shard_l.last_delete = std::max (shard_l.last_delete, transaction_id_a);
+	auto existing (shard_l.index.find (hash_a));
+	if (existing != shard_l.index.end ())
+	{
+		shard_l.entries.erase (existing->second);
+		shard_l.index.erase (existing);
+	}
+}
+
+void rai::block_cache::clear ()
+{
+	for (auto & i : shards)
+	{
+		std::lock_guard<std::mutex> lock (i.mutex);
+		i.entries.clear ();
+		i.index.clear ();
+	}
+}
+
+size_t rai::block_cache::size ()
+{
+	size_t result (0);
+	for (auto & i : shards)
+	{
+		std::lock_guard<std::mutex> lock (i.mutex);
+		result += i.entries.size ();
+	}
+	return result;
+}
+
+rai::uint128_t rai::rep_weights::get (rai::account const & account_a)
+{
+	rai::uint128_t result (0);
+	std::shared_lock<std::shared_timed_mutex> lock (mutex);
+	auto existing (weights.find (account_a));
+	if (existing != weights.end ())
+	{
+		result = existing->second;
+	}
+	return result;
+}
+
+void rai::rep_weights::put (rai::account const & account_a, rai::uint128_t const & weight_a)
+{
+	std::lock_guard<std::shared_timed_mutex> lock (mutex);
+	weights[account_a] = weight_a;
+}
+
+void rai::rep_weights::clear ()
+{
+	std::lock_guard<std::shared_timed_mutex> lock (mutex);
+	weights.clear ();
+}
+
+std::vector<std::pair<rai::account, rai::uint128_t>> rai::rep_weights::list ()
+{
+	std::vector<std::pair<rai::account, rai::uint128_t>> result;
+	{
+		std::shared_lock<std::shared_timed_mutex> lock (mutex);
+		result.assign (weights.begin (), weights.end ());
+	}
+	std::sort (result.begin (), result.end (), [](std::pair<rai::account, rai::uint128_t> const & lhs, std::pair<rai::account, rai::uint128_t> const & rhs) {
+		return lhs.first < rhs.first;
+	});
+	return result;
+}
+
+size_t rai::rep_weights::size ()
+{
+	std::shared_lock<std::shared_timed_mutex> lock (mutex);
+	return weights.size ();
+}
+
+rai::unchecked_cache::unchecked_cache (size_t capacity_a) :
+capacity (capacity_a)
+{
+}
+
+bool rai::unchecked_cache::put (rai::unchecked_info const & info_a)
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	auto result (!entries.insert (info_a).second);
+	return result;
+}
+
+bool rai::unchecked_cache::exists (rai::block_hash const & dependency_a, rai::block_hash const & hash_a)
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	auto result (entries.find (boost::make_tuple (dependency_a, hash_a)) != entries.end ());
+	return result;
+}
+
+std::vector<std::shared_ptr<rai::block>> rai::unchecked_cache::get (rai::block_hash const & dependency_a)
+{
+	std::vector<std::shared_ptr<rai::block>> result;
+	std::lock_guard<std::mutex> lock (mutex);
+	auto range (entries.equal_range (boost::make_tuple (dependency_a)));
+	for (auto i (range.first); i != range.second; ++i)
+	{
+		result.push_back (i->block);
+	}
+	return result;
+}
+
+void rai::unchecked_cache::erase (rai::block_hash const & dependency_a, rai::block_hash const & hash_a)
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	auto existing (entries.find (boost::make_tuple (dependency_a, hash_a)));
+	if (existing != entries.end ())
+	{
+		entries.erase (existing);
+	}
+}
+
+std::vector<std::shared_ptr<rai::block>> rai::unchecked_cache::release (rai::block_hash const & dependency_a)
+{
+	std::vector<std::shared_ptr<rai::block>> result;
+	std::lock_guard<std::mutex> lock (mutex);
+	auto range (entries.equal_range (boost::make_tuple (dependency_a)));
+	for (auto i (range.first); i != range.second; ++i)
+	{
+		result.push_back (i->block);
+	}
+	entries.erase (range.first, range.second);
+	return result;
+}
+
+std::vector<rai::unchecked_info> rai::unchecked_cache::pop_oldest (size_t count_a)
+{
+	std::vector<rai::unchecked_info> result;
+	std::lock_guard<std::mutex> lock (mutex);
+	auto & sequence (entries.get<1> ());
+	while (!sequence.empty () && result.size () < count_a)
+	{
+		result.push_back (sequence.front ());
+		sequence.pop_front ();
+	}
+	return result;
+}
+
+std::vector<rai::unchecked_info> rai::unchecked_cache::drain ()
+{
+	std::vector<rai::unchecked_info> result;
+	std::lock_guard<std::mutex> lock (mutex);
+	auto & sequence (entries.get<1> ());
+	result.reserve (sequence.size ());
+	result.assign (sequence.begin (), sequence.end ());
+	entries.clear ();
+	return result;
+}
+
+size_t rai::unchecked_cache::purge (uint64_t cutoff_a)
+{
+	size_t result (0);
+	std::lock_guard<std::mutex> lock (mutex);
+	auto & sequence (entries.get<1> ());
+	while (!sequence.empty () && sequence.front ().arrival < cutoff_a)
+	{
+		sequence.pop_front ();
+		++result;
+	}
+	return result;
+}
+
+void rai::unchecked_cache::clear ()
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	entries.clear ();
+}
+
+size_t rai::unchecked_cache::size ()
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	return entries.size ();
+}
+
+rai::block_store::block_store (bool & error_a, boost::filesystem::path const & path_a, int lmdb_max_dbs, size_t block_cache_size_a, size_t unchecked_cache_size_a, unsigned lmdb_flags_a, size_t lmdb_map_size_a, uint64_t block_info_max_a, uint64_t block_info_dense_a) :
+block_info_max (block_info_max_a),
+block_info_dense (block_info_dense_a),
+unchecked_cache (unchecked_cache_size_a),
+block_cache (block_cache_size_a),
+environment (error_a, path_a, lmdb_max_dbs, lmdb_flags_a, lmdb_map_size_a),
 frontiers (0),
 accounts (0),
-send_blocks (0),
-receive_blocks (0),
-open_blocks (0),
-change_blocks (0),
+blocks (0),
 pending (0),
+pending_totals (0),
 blocks_info (0),
+block_heights (0),
+chain_heights (0),
+delegators (0),
 representation (0),
 unchecked (0),
+unchecked_arrival (0),
 unsynced (0),
+bootstrap (0),
 checksum (0)
 {
 	if (!error_a)
@@ -252,21 +564,33 @@ checksum (0)
 		rai::transaction transaction (environment, nullptr, true);
 		error_a |= mdb_dbi_open (transaction, "frontiers", MDB_CREATE, &frontiers) != 0;
 		error_a |= mdb_dbi_open (transaction, "accounts", MDB_CREATE, &accounts) != 0;
-		error_a |= mdb_dbi_open (transaction, "send", MDB_CREATE, &send_blocks) != 0;
-		error_a |= mdb_dbi_open (transaction, "receive", MDB_CREATE, &receive_blocks) != 0;
-		error_a |= mdb_dbi_open (transaction, "open", MDB_CREATE, &open_blocks) != 0;
-		error_a |= mdb_dbi_open (transaction, "change", MDB_CREATE, &change_blocks) != 0;
+		error_a |= mdb_dbi_open (transaction, "blocks", MDB_CREATE, &blocks) != 0;
 		error_a |= mdb_dbi_open (transaction, "pending", MDB_CREATE, &pending) != 0;
+		error_a |= mdb_dbi_open (transaction, "pending_totals", MDB_CREATE, &pending_totals) != 0;
 		error_a |= mdb_dbi_open (transaction, "blocks_info", MDB_CREATE, &blocks_info) != 0;
+		error_a |= mdb_dbi_open (transaction, "block_heights", MDB_CREATE, &block_heights) != 0;
+		error_a |= mdb_dbi_open (transaction, "chain_heights", MDB_CREATE, &chain_heights) != 0;
+		error_a |= mdb_dbi_open (transaction, "delegators", MDB_CREATE, &delegators) != 0;
 		error_a |= mdb_dbi_open (transaction, "representation", MDB_CREATE, &representation) != 0;
 		error_a |= mdb_dbi_open (transaction, "unchecked", MDB_CREATE | MDB_DUPSORT, &unchecked) != 0;
+		error_a |= mdb_dbi_open (transaction, "unchecked_arrival", MDB_CREATE, &unchecked_arrival) != 0;
 		error_a |= mdb_dbi_open (transaction, "unsynced", MDB_CREATE, &unsynced) != 0;
+		error_a |= mdb_dbi_open (transaction, "bootstrap", MDB_CREATE, &bootstrap) != 0;
 		error_a |= mdb_dbi_open (transaction, "checksum", MDB_CREATE, &checksum) != 0;
 		error_a |= mdb_dbi_open (transaction, "vote", MDB_CREATE, &vote) != 0;
 		error_a |= mdb_dbi_open (transaction, "meta", MDB_CREATE, &meta) != 0;
 		if (!error_a)
 		{
+			for (auto i (representation_begin (transaction)), n (representation_end ()); i != n; ++i)
+			{
+				rai::uint128_union weight;
+				rai::bufferstream stream (reinterpret_cast<uint8_t const *> (i->second.data ()), i->second.size ());
+				auto error (rai::read (stream, weight));
+				assert (!error);
+				rep_weights.put (i->first.uint256 (), weight.number ());
+			}
 			do_upgrades (transaction);
+			block_info_upgrade (transaction);
 			checksum_put (transaction, 0, 0, 0);
 		}
 	}
@@ -301,7 +625,13 @@ int rai::block_store::version_get (MDB_txn * transaction_a)
 
 void rai::block_store::do_upgrades (MDB_txn * transaction_a)
 {
-	switch (version_get (transaction_a))
+	auto version (version_get (transaction_a));
+	if (version < 11)
+	{
+		// Every upgrade reads blocks through the unified table so the per type tables are merged before any of them run
+		merge_block_tables (transaction_a);
+	}
+	switch (version)
 	{
 		case 1:
 			upgrade_v1_to_v2 (transaction_a);
@@ -322,6 +652,18 @@ void rai::block_store::do_upgrades (MDB_txn * transaction_a)
 		case 9:
 			upgrade_v9_to_v10 (transaction_a);
 		case 10:
+			upgrade_v10_to_v11 (transaction_a);
+		case 11:
+			upgrade_v11_to_v12 (transaction_a);
+		case 12:
+			upgrade_v12_to_v13 (transaction_a);
+		case 13:
+			upgrade_v13_to_v14 (transaction_a);
+		case 14:
+			upgrade_v14_to_v15 (transaction_a);
+		case 15:
+			upgrade_v15_to_v16 (transaction_a);
+		case 16:
 			break;
 		default:
 			assert (false);
@@ -366,6 +708,7 @@ void rai::block_store::upgrade_v2_to_v3 (MDB_txn * transaction_a)
 {
 	version_put (transaction_a, 3);
 	mdb_drop (transaction_a, representation, 0);
+	rep_weights.clear ();
 	for (auto i (latest_begin (transaction_a)), n (latest_end ()); i != n; ++i)
 	{
 		rai::account account_l (i->first.uint256 ());
@@ -507,6 +850,7 @@ void rai::block_store::upgrade_v9_to_v10 (MDB_txn * transaction_a)
 					block_info.account = account;
 					rai::amount balance (block_balance (transaction_a, hash));
 					block_info.balance = balance;
+					block_info.height = block_count;
 					block_info_put (transaction_a, hash, block_info);
 				}
 				hash = block_successor (transaction_a, hash);
@@ -517,11 +861,155 @@ void rai::block_store::upgrade_v9_to_v10 (MDB_txn * transaction_a)
 	//std::cerr << boost::str (boost::format ("Database upgrade is completed\n"));
 }
 
+void rai::block_store::upgrade_v10_to_v11 (MDB_txn * transaction_a)
+{
+	// Block tables were already merged by do_upgrades
+	version_put (transaction_a, 11);
+}
+
+void rai::block_store::upgrade_v11_to_v12 (MDB_txn * transaction_a)
+{
+	// Unchecked rows gained an arrival time, older rows have none so they're dropped and fetched again by bootstrap
+	version_put (transaction_a, 12);
+	mdb_drop (transaction_a, unchecked, 0);
+	mdb_drop (transaction_a, unchecked_arrival, 0);
+}
+
+void rai::block_store::upgrade_v12_to_v13 (MDB_txn * transaction_a)
+{
+	// Blocks info gained a height, no layout is recorded yet so block_info_upgrade rebuilds the table
+	version_put (transaction_a, 13);
+}
+
+void rai::block_store::upgrade_v13_to_v14 (MDB_txn * transaction_a)
+{
+	// Index every block by its position in its account chain
+	version_put (transaction_a, 14);
+	for (auto i (latest_begin (transaction_a)), n (latest_end ()); i != n; ++i)
+	{
+		rai::account account (i->first.uint256 ());
+		rai::account_info info (i->second);
+		uint64_t height (1);
+		for (auto hash (info.open_block); !hash.is_zero (); hash = block_successor (transaction_a, hash))
+		{
+			block_height_put (transaction_a, hash, account, height);
+			++height;
+		}
+	}
+}
+
+void rai::block_store::upgrade_v14_to_v15 (MDB_txn * transaction_a)
+{
+	// Index accounts by the representative they delegate to
+	version_put (transaction_a, 15);
+	for (auto i (latest_begin (transaction_a)), n (latest_end ()); i != n; ++i)
+	{
+		rai::account_info info (i->second);
+		auto block (block_get (transaction_a, info.rep_block));
+		assert (block != nullptr);
+		delegator_put (transaction_a, block->representative (), i->first.uint256 ());
+	}
+}
+
+void rai::block_store::upgrade_v15_to_v16 (MDB_txn * transaction_a)
+{
+	// Earlier upgrades may have added to the totals through pending_put so they're summed from scratch
+	version_put (transaction_a, 16);
+	mdb_drop (transaction_a, pending_totals, 0);
+	for (auto i (pending_begin (transaction_a)), n (pending_end ()); i != n; ++i)
+	{
+		rai::pending_key key (i->first);
+		rai::pending_info info (i->second);
+		pending_total_add (transaction_a, key.account, 1, info.amount.number ());
+	}
+}
+
+void rai::block_store::block_info_upgrade (MDB_txn * transaction_a)
+{
+	rai::uint256_union layout_key (3);
+	rai::mdb_val data;
+	auto error (mdb_get (transaction_a, meta, rai::mdb_val (layout_key), data));
+	std::array<uint64_t, 2> layout ({ block_info_max, block_info_dense });
+	if (error == MDB_NOTFOUND || data.size () != sizeof (layout) || std::memcmp (data.data (), layout.data (), sizeof (layout)) != 0)
+	{
+		if (latest_begin (transaction_a) != latest_end ())
+		{
+			std::cerr << boost::str (boost::format ("Rebuilding blocks info for stride %1% and dense threshold %2%, this may take a while\n") % block_info_max % block_info_dense);
+		}
+		block_info_rebuild (transaction_a);
+		auto status (mdb_put (transaction_a, meta, rai::mdb_val (layout_key), rai::mdb_val (sizeof (layout), layout.data ()), 0));
+		assert (status == 0);
+	}
+}
+
+void rai::block_store::block_info_rebuild (MDB_txn * transaction_a)
+{
+	auto status (mdb_drop (transaction_a, blocks_info, 0));
+	assert (status == 0);
+	auto first (block_info_dense != 0 ? std::min (block_info_max, block_info_dense) : block_info_max);
+	for (auto i (latest_begin (transaction_a)), n (latest_end ()); i != n; ++i)
+	{
+		rai::account_info info (i->second);
+		if (info.block_count >= first)
+		{
+			rai::account account (i->first.uint256 ());
+			uint64_t height (1);
+			auto hash (info.open_block);
+			while (!hash.is_zero ())
+			{
+				if (block_info_due (height))
+				{
+					// Earlier records are already written so each balance is found within one stride
+					block_info_put (transaction_a, hash, rai::block_info (account, block_balance (transaction_a, hash), height));
+				}
+				hash = block_successor (transaction_a, hash);
+				++height;
+			}
+		}
+	}
+}
+
+bool rai::block_store::block_info_due (uint64_t height_a) const
+{
+	return (height_a % block_info_max) == 0 || (block_info_dense != 0 && height_a >= block_info_dense);
+}
+
+void rai::block_store::merge_block_tables (MDB_txn * transaction_a)
+{
+	std::array<std::pair<char const *, rai::block_type>, 4> tables ({ { { "send", rai::block_type::send }, { "receive", rai::block_type::receive }, { "open", rai::block_type::open }, { "change", rai::block_type::change } } });
+	std::vector<uint8_t> record;
+	for (auto & i : tables)
+	{
+		MDB_dbi table;
+		auto status1 (mdb_dbi_open (transaction_a, i.first, MDB_CREATE, &table));
+		assert (status1 == 0);
+		for (rai::store_iterator j (transaction_a, table), n (nullptr); j != n; ++j)
+		{
+			auto data (reinterpret_cast<uint8_t const *> (j->second.data ()));
+			record.assign (1, static_cast<uint8_t> (i.second));
+			record.insert (record.end (), data, data + j->second.size ());
+			block_put_raw (transaction_a, j->first.uint256 (), rai::mdb_val (record.size (), record.data ()));
+		}
+		auto status2 (mdb_drop (transaction_a, table, 1));
+		assert (status2 == 0);
+	}
+}
+
 void rai::block_store::clear (MDB_dbi db_a)
 {
 	rai::transaction transaction (environment, nullptr, true);
-	auto status (mdb_drop (transaction, db_a, 0));
+	clear (transaction, db_a);
+}
+
+void rai::block_store::clear (MDB_txn * transaction_a, MDB_dbi db_a)
+{
+	auto status (mdb_drop (transaction_a, db_a, 0));
 	assert (status == 0);
+	block_cache.clear ();
+	if (db_a == representation)
+	{
+		rep_weights.clear ();
+	}
 }
 
 rai::uint128_t rai::block_store::block_balance (MDB_txn * transaction_a, rai::block_hash const & hash_a)
@@ -541,34 +1029,27 @@ void rai::block_store::representation_add (MDB_txn * transaction_a, rai::block_h
 	representation_put (transaction_a, source_rep, source_previous + amount_a);
 }
 
-MDB_dbi rai::block_store::block_database (rai::block_type type_a)
+void rai::block_store::block_put_raw (MDB_txn * transaction_a, rai::block_hash const & hash_a, MDB_val value_a)
 {
-	MDB_dbi result;
-	switch (type_a)
+	assert (value_a.mv_size > 1);
+	auto existing (value_a);
+	auto status1 (mdb_put (transaction_a, blocks, rai::mdb_val (hash_a), &existing, MDB_NOOVERWRITE));
+	assert (status1 == 0 || status1 == MDB_KEYEXIST);
+	if (status1 == MDB_KEYEXIST)
 	{
-		case rai::block_type::send:
-			result = send_blocks;
-			break;
-		case rai::block_type::receive:
-			result = receive_blocks;
-			break;
-		case rai::block_type::open:
-			result = open_blocks;
-			break;
-		case rai::block_type::change:
-			result = change_blocks;
-			break;
-		default:
-			assert (false);
-			break;
+		// Rewrites that only change the trailing successor leave the cached block valid, anything else e.g. higher work replaces it
+		auto body (value_a.mv_size - sizeof (rai::block_hash));
+		if (existing.mv_size != value_a.mv_size || std::memcmp (existing.mv_data, value_a.mv_data, body) != 0)
+		{
+			block_cache.erase (hash_a, mdb_txn_id (transaction_a));
+		}
+		auto status2 (mdb_put (transaction_a, blocks, rai::mdb_val (hash_a), &value_a, 0));
+		assert (status2 == 0);
+	}
+	else
+	{
+		block_count_add (transaction_a, static_cast<rai::block_type> (static_cast<uint8_t const *> (value_a.mv_data)[0]), 1);
 	}
-	return result;
-}
-
-void rai::block_store::block_put_raw (MDB_txn * transaction_a, MDB_dbi database_a, rai::block_hash const & hash_a, MDB_val value_a)
-{
-	auto status2 (mdb_put (transaction_a, database_a, rai::mdb_val (hash_a), &value_a, 0));
-	assert (status2 == 0);
 }
 
 void rai::block_store::block_put (MDB_txn * transaction_a, rai::block_hash const & hash_a, rai::block const & block_a, rai::block_hash const & successor_a)
@@ -577,10 +1058,11 @@ void rai::block_store::block_put (MDB_txn * transaction_a, rai::block_hash const
 	std::vector<uint8_t> vector;
 	{
 		rai::vectorstream stream (vector);
+		rai::write (stream, block_a.type ());
 		block_a.serialize (stream);
 		rai::write (stream, successor_a.bytes);
 	}
-	block_put_raw (transaction_a, block_database (block_a.type ()), hash_a, { vector.size (), vector.data () });
+	block_put_raw (transaction_a, hash_a, { vector.size (), vector.data () });
 	set_predecessor predecessor (transaction_a, *this);
 	block_a.visit (predecessor);
 	assert (block_a.previous ().is_zero () || block_successor (transaction_a, block_a.previous ()) == hash_a);
@@ -588,89 +1070,33 @@ void rai::block_store::block_put (MDB_txn * transaction_a, rai::block_hash const
 
 MDB_val rai::block_store::block_get_raw (MDB_txn * transaction_a, rai::block_hash const & hash_a, rai::block_type & type_a)
 {
-	rai::mdb_val result;
-	auto status (mdb_get (transaction_a, send_blocks, rai::mdb_val (hash_a), result));
+	rai::mdb_val value;
+	MDB_val result{ 0, nullptr };
+	auto status (mdb_get (transaction_a, blocks, rai::mdb_val (hash_a), value));
 	assert (status == 0 || status == MDB_NOTFOUND);
-	if (status != 0)
+	if (status == 0)
 	{
-		auto status (mdb_get (transaction_a, receive_blocks, rai::mdb_val (hash_a), result));
-		assert (status == 0 || status == MDB_NOTFOUND);
-		if (status != 0)
-		{
-			auto status (mdb_get (transaction_a, open_blocks, rai::mdb_val (hash_a), result));
-			assert (status == 0 || status == MDB_NOTFOUND);
-			if (status != 0)
-			{
-				auto status (mdb_get (transaction_a, change_blocks, rai::mdb_val (hash_a), result));
-				assert (status == 0 || status == MDB_NOTFOUND);
-				if (status == 0)
-				{
-					type_a = rai::block_type::change;
-				}
-			}
-			else
-			{
-				type_a = rai::block_type::open;
-			}
-		}
-		else
-		{
-			type_a = rai::block_type::receive;
-		}
-	}
-	else
-	{
-		type_a = rai::block_type::send;
+		assert (value.size () > 1);
+		auto data (static_cast<uint8_t *> (value.data ()));
+		type_a = static_cast<rai::block_type> (data[0]);
+		result = { value.size () - 1, data + 1 };
 	}
 	return result;
 }
 
-std::unique_ptr<rai::block> rai::block_store::block_random (MDB_txn * transaction_a, MDB_dbi database)
+std::unique_ptr<rai::block> rai::block_store::block_random (MDB_txn * transaction_a)
 {
 	rai::block_hash hash;
 	rai::random_pool.GenerateBlock (hash.bytes.data (), hash.bytes.size ());
-	rai::store_iterator existing (transaction_a, database, rai::mdb_val (hash));
+	rai::store_iterator existing (transaction_a, blocks, rai::mdb_val (hash));
 	if (existing == rai::store_iterator (nullptr))
 	{
-		existing = rai::store_iterator (transaction_a, database);
+		existing = rai::store_iterator (transaction_a, blocks);
 	}
 	assert (existing != rai::store_iterator (nullptr));
 	return block_get (transaction_a, rai::block_hash (existing->first.uint256 ()));
 }
 
-std::unique_ptr<rai::block> rai::block_store::block_random (MDB_txn * transaction_a)
-{
-	auto count (block_count (transaction_a));
-	auto region (rai::random_pool.GenerateWord32 (0, count.sum () - 1));
-	std::unique_ptr<rai::block> result;
-	if (region < count.send)
-	{
-		result = block_random (transaction_a, send_blocks);
-	}
-	else
-	{
-		region -= count.send;
-		if (region < count.receive)
-		{
-			result = block_random (transaction_a, receive_blocks);
-		}
-		else
-		{
-			region -= count.receive;
-			if (region < count.open)
-			{
-				result = block_random (transaction_a, open_blocks);
-			}
-			else
-			{
-				// change
-				result = block_random (transaction_a, change_blocks);
-			}
-		}
-	}
-	return result;
-}
-
 rai::block_hash rai::block_store::block_successor (MDB_txn * transaction_a, rai::block_hash const & hash_a)
 {
 	rai::block_type type;
@@ -710,77 +1136,90 @@ std::unique_ptr<rai::block> rai::block_store::block_get (MDB_txn * transaction_a
 	return result;
 }
 
-void rai::block_store::block_del (MDB_txn * transaction_a, rai::block_hash const & hash_a)
+std::shared_ptr<rai::block const> rai::block_store::block_get_cached (MDB_txn * transaction_a, rai::block_hash const & hash_a)
 {
-	auto status (mdb_del (transaction_a, send_blocks, rai::mdb_val (hash_a), nullptr));
-	assert (status == 0 || status == MDB_NOTFOUND);
-	if (status != 0)
+	auto result (block_cache.get (hash_a));
+	if (result == nullptr)
 	{
-		auto status (mdb_del (transaction_a, receive_blocks, rai::mdb_val (hash_a), nullptr));
-		assert (status == 0 || status == MDB_NOTFOUND);
-		if (status != 0)
+		rai::block_type type;
+		auto value (block_get_raw (transaction_a, hash_a, type));
+		if (value.mv_size != 0)
 		{
-			auto status (mdb_del (transaction_a, open_blocks, rai::mdb_val (hash_a), nullptr));
-			assert (status == 0 || status == MDB_NOTFOUND);
-			if (status != 0)
-			{
-				auto status (mdb_del (transaction_a, change_blocks, rai::mdb_val (hash_a), nullptr));
-				assert (status == 0);
-			}
+			rai::bufferstream stream (reinterpret_cast<uint8_t const *> (value.mv_data), value.mv_size);
+			result = rai::deserialize_block_pooled (stream, type);
+			assert (result != nullptr);
+			block_cache.put (hash_a, result, mdb_txn_id (transaction_a));
 		}
 	}
+	return result;
+}
+
+void rai::block_store::block_del (MDB_txn * transaction_a, rai::block_hash const & hash_a)
+{
+	block_cache.erase (hash_a, mdb_txn_id (transaction_a));
+	rai::block_type type;
+	auto value (block_get_raw (transaction_a, hash_a, type));
+	assert (value.mv_size != 0);
+	auto status (mdb_del (transaction_a, blocks, rai::mdb_val (hash_a), nullptr));
+	assert (status == 0);
+	block_count_add (transaction_a, type, -1);
 }
 
 bool rai::block_store::block_exists (MDB_txn * transaction_a, rai::block_hash const & hash_a)
 {
-	auto exists (true);
 	rai::mdb_val junk;
-	auto status (mdb_get (transaction_a, send_blocks, rai::mdb_val (hash_a), junk));
+	auto status (mdb_get (transaction_a, blocks, rai::mdb_val (hash_a), junk));
 	assert (status == 0 || status == MDB_NOTFOUND);
-	exists = status == 0;
-	if (!exists)
-	{
-		auto status (mdb_get (transaction_a, receive_blocks, rai::mdb_val (hash_a), junk));
-		assert (status == 0 || status == MDB_NOTFOUND);
-		exists = status == 0;
-		if (!exists)
-		{
-			auto status (mdb_get (transaction_a, open_blocks, rai::mdb_val (hash_a), junk));
-			assert (status == 0 || status == MDB_NOTFOUND);
-			exists = status == 0;
-			if (!exists)
-			{
-				auto status (mdb_get (transaction_a, change_blocks, rai::mdb_val (hash_a), junk));
-				assert (status == 0 || status == MDB_NOTFOUND);
-				exists = status == 0;
-			}
-		}
-	}
-	return exists;
+	return status == 0;
 }
 
 rai::block_counts rai::block_store::block_count (MDB_txn * transaction_a)
 {
 	rai::block_counts result;
-	MDB_stat send_stats;
-	auto status1 (mdb_stat (transaction_a, send_blocks, &send_stats));
-	assert (status1 == 0);
-	MDB_stat receive_stats;
-	auto status2 (mdb_stat (transaction_a, receive_blocks, &receive_stats));
-	assert (status2 == 0);
-	MDB_stat open_stats;
-	auto status3 (mdb_stat (transaction_a, open_blocks, &open_stats));
-	assert (status3 == 0);
-	MDB_stat change_stats;
-	auto status4 (mdb_stat (transaction_a, change_blocks, &change_stats));
-	assert (status4 == 0);
-	result.send = send_stats.ms_entries;
-	result.receive = receive_stats.ms_entries;
-	result.open = open_stats.ms_entries;
-	result.change = change_stats.ms_entries;
+	rai::uint256_union counts_key (2);
+	rai::mdb_val value;
+	auto status (mdb_get (transaction_a, meta, rai::mdb_val (counts_key), value));
+	assert (status == 0 || status == MDB_NOTFOUND);
+	if (status == 0)
+	{
+		std::array<uint64_t, 4> counts;
+		assert (value.size () == sizeof (counts));
+		std::copy (static_cast<uint8_t *> (value.data ()), static_cast<uint8_t *> (value.data ()) + sizeof (counts), reinterpret_cast<uint8_t *> (counts.data ()));
+		result.send = counts[0];
+		result.receive = counts[1];
+		result.open = counts[2];
+		result.change = counts[3];
+	}
 	return result;
 }
 
+void rai::block_store::block_count_add (MDB_txn * transaction_a, rai::block_type type_a, int64_t amount_a)
+{
+	auto current (block_count (transaction_a));
+	std::array<uint64_t, 4> counts ({ { current.send, current.receive, current.open, current.change } });
+	switch (type_a)
+	{
+		case rai::block_type::send:
+			counts[0] += amount_a;
+			break;
+		case rai::block_type::receive:
+			counts[1] += amount_a;
+			break;
+		case rai::block_type::open:
+			counts[2] += amount_a;
+			break;
+		case rai::block_type::change:
+			counts[3] += amount_a;
+			break;
+		default:
+			assert (false);
+			break;
+	}
+	rai::uint256_union counts_key (2);
+	auto status (mdb_put (transaction_a, meta, rai::mdb_val (counts_key), rai::mdb_val (sizeof (counts), counts.data ()), 0));
+	assert (status == 0);
+}
+
 void rai::block_store::account_del (MDB_txn * transaction_a, rai::account const & account_a)
 {
 	auto status (mdb_del (transaction_a, accounts, rai::mdb_val (account_a), nullptr));
@@ -854,14 +1293,107 @@ void rai::block_store::account_put (MDB_txn * transaction_a, rai::account const
 
 void rai::block_store::pending_put (MDB_txn * transaction_a, rai::pending_key const & key_a, rai::pending_info const & pending_a)
 {
-	auto status (mdb_put (transaction_a, pending, key_a.val (), pending_a.val (), 0));
-	assert (status == 0);
+	auto status (mdb_put (transaction_a, pending, key_a.val (), pending_a.val (), MDB_NOOVERWRITE));
+	assert (status == 0 || status == MDB_KEYEXIST);
+	if (status == MDB_KEYEXIST)
+	{
+		// Replacing an entry only changes the sum
+		rai::pending_info existing;
+		auto error (pending_get (transaction_a, key_a, existing));
+		assert (!error);
+		pending_total_add (transaction_a, key_a.account, 0, pending_a.amount.number () - existing.amount.number ());
+		auto status1 (mdb_put (transaction_a, pending, key_a.val (), pending_a.val (), 0));
+		assert (status1 == 0);
+	}
+	else
+	{
+		pending_total_add (transaction_a, key_a.account, 1, pending_a.amount.number ());
+	}
 }
 
 void rai::block_store::pending_del (MDB_txn * transaction_a, rai::pending_key const & key_a)
 {
+	rai::pending_info existing;
+	auto error (pending_get (transaction_a, key_a, existing));
+	assert (!error);
 	auto status (mdb_del (transaction_a, pending, key_a.val (), nullptr));
 	assert (status == 0);
+	pending_total_add (transaction_a, key_a.account, -1, 0 - existing.amount.number ());
+}
+
+rai::pending_total rai::block_store::pending_total_get (MDB_txn * transaction_a, rai::account const & account_a)
+{
+	rai::pending_total result;
+	rai::mdb_val value;
+	auto status (mdb_get (transaction_a, pending_totals, rai::mdb_val (account_a), value));
+	assert (status == 0 || status == MDB_NOTFOUND);
+	if (status == 0)
+	{
+		rai::uint128_union amount;
+		assert (value.size () == sizeof (result.count) + sizeof (amount.bytes));
+		std::memcpy (&result.count, value.data (), sizeof (result.count));
+		std::memcpy (amount.bytes.data (), reinterpret_cast<uint8_t const *> (value.data ()) + sizeof (result.count), sizeof (amount.bytes));
+		result.amount = amount.number ();
+	}
+	return result;
+}
+
+void rai::block_store::pending_total_add (MDB_txn * transaction_a, rai::account const & account_a, int64_t count_a, rai::uint128_t const & amount_a)
+{
+	auto total (pending_total_get (transaction_a, account_a));
+	total.count += count_a;
+	total.amount += amount_a;
+	if (total.count != 0)
+	{
+		rai::uint128_union amount (total.amount);
+		std::array<uint8_t, sizeof (total.count) + sizeof (amount.bytes)> value;
+		std::memcpy (value.data (), &total.count, sizeof (total.count));
+		std::copy (amount.bytes.begin (), amount.bytes.end (), value.begin () + sizeof (total.count));
+		auto status (mdb_put (transaction_a, pending_totals, rai::mdb_val (account_a), rai::mdb_val (value.size (), value.data ()), 0));
+		assert (status == 0);
+	}
+	else
+	{
+		auto status (mdb_del (transaction_a, pending_totals, rai::mdb_val (account_a), nullptr));
+		assert (status == 0);
+	}
+}
+
+rai::store_iterator rai::block_store::pending_totals_begin (MDB_txn * transaction_a)
+{
+	rai::store_iterator result (transaction_a, pending_totals);
+	return result;
+}
+
+rai::store_iterator rai::block_store::pending_totals_end ()
+{
+	rai::store_iterator result (nullptr);
+	return result;
+}
+
+void rai::block_store::pending_for_each (MDB_txn * transaction_a, std::vector<rai::account> const & accounts_a, std::function<bool(rai::pending_key const &, rai::pending_info const &)> const & visitor_a)
+{
+	std::vector<rai::account> accounts (accounts_a);
+	std::sort (accounts.begin (), accounts.end (), [](rai::account const & one_a, rai::account const & two_a) {
+		return one_a.number () < two_a.number ();
+	});
+	accounts.erase (std::unique (accounts.begin (), accounts.end ()), accounts.end ());
+	MDB_cursor * cursor;
+	auto status (mdb_cursor_open (transaction_a, pending, &cursor));
+	assert (status == 0);
+	for (auto & account : accounts)
+	{
+		rai::pending_key start (account, 0);
+		MDB_val key (start.val ());
+		MDB_val value;
+		auto more (mdb_cursor_get (cursor, &key, &value, MDB_SET_RANGE) == 0);
+		while (more)
+		{
+			rai::pending_key current (key);
+			more = current.account == account && visitor_a (current, rai::pending_info (value)) && mdb_cursor_get (cursor, &key, &value, MDB_NEXT) == 0;
+		}
+	}
+	mdb_cursor_close (cursor);
 }
 
 bool rai::block_store::pending_exists (MDB_txn * transaction_a, rai::pending_key const & key_a)
@@ -942,71 +1474,197 @@ bool rai::block_store::block_info_get (MDB_txn * transaction_a, rai::block_hash
 	else
 	{
 		result = false;
-		assert (value.size () == sizeof (block_info_a.account.bytes) + sizeof (block_info_a.balance.bytes));
+		assert (value.size () == sizeof (block_info_a.account.bytes) + sizeof (block_info_a.balance.bytes) + sizeof (block_info_a.height));
 		rai::bufferstream stream (reinterpret_cast<uint8_t const *> (value.data ()), value.size ());
-		auto error1 (rai::read (stream, block_info_a.account));
-		assert (!error1);
-		auto error2 (rai::read (stream, block_info_a.balance));
-		assert (!error2);
+		auto error (block_info_a.deserialize (stream));
+		assert (!error);
 	}
 	return result;
 }
 
-rai::uint128_t rai::block_store::representation_get (MDB_txn * transaction_a, rai::account const & account_a)
+void rai::block_store::block_height_put (MDB_txn * transaction_a, rai::block_hash const & hash_a, rai::account const & account_a, uint64_t height_a)
+{
+	std::array<uint8_t, 40> value;
+	std::copy (account_a.bytes.begin (), account_a.bytes.end (), value.begin ());
+	std::memcpy (value.data () + 32, &height_a, sizeof (height_a));
+	auto status1 (mdb_put (transaction_a, block_heights, rai::mdb_val (hash_a), rai::mdb_val (value.size (), value.data ()), 0));
+	assert (status1 == 0);
+	auto key (chain_height_key (account_a, height_a));
+	auto status2 (mdb_put (transaction_a, chain_heights, rai::mdb_val (key.size (), key.data ()), rai::mdb_val (hash_a), 0));
+	assert (status2 == 0);
+}
+
+void rai::block_store::block_height_del (MDB_txn * transaction_a, rai::block_hash const & hash_a)
+{
+	rai::account account;
+	uint64_t height;
+	if (!block_height_get (transaction_a, hash_a, account, height))
+	{
+		auto status1 (mdb_del (transaction_a, block_heights, rai::mdb_val (hash_a), nullptr));
+		assert (status1 == 0);
+		auto key (chain_height_key (account, height));
+		auto status2 (mdb_del (transaction_a, chain_heights, rai::mdb_val (key.size (), key.data ()), nullptr));
+		assert (status2 == 0);
+	}
+}
+
+bool rai::block_store::block_height_get (MDB_txn * transaction_a, rai::block_hash const & hash_a, rai::account & account_a, uint64_t & height_a)
 {
 	rai::mdb_val value;
-	auto status (mdb_get (transaction_a, representation, rai::mdb_val (account_a), value));
+	auto status (mdb_get (transaction_a, block_heights, rai::mdb_val (hash_a), value));
 	assert (status == 0 || status == MDB_NOTFOUND);
-	rai::uint128_t result;
-	if (status == 0)
+	auto result (status == MDB_NOTFOUND);
+	if (!result)
 	{
-		rai::uint128_union rep;
-		rai::bufferstream stream (reinterpret_cast<uint8_t const *> (value.data ()), value.size ());
-		auto error (rai::read (stream, rep));
-		assert (!error);
-		result = rep.number ();
+		assert (value.size () == sizeof (account_a.bytes) + sizeof (height_a));
+		auto data (reinterpret_cast<uint8_t const *> (value.data ()));
+		std::copy (data, data + sizeof (account_a.bytes), account_a.bytes.begin ());
+		std::memcpy (&height_a, data + sizeof (account_a.bytes), sizeof (height_a));
 	}
-	else
+	return result;
+}
+
+rai::block_hash rai::block_store::block_at_height (MDB_txn * transaction_a, rai::account const & account_a, uint64_t height_a)
+{
+	rai::block_hash result (0);
+	auto key (chain_height_key (account_a, height_a));
+	rai::mdb_val value;
+	auto status (mdb_get (transaction_a, chain_heights, rai::mdb_val (key.size (), key.data ()), value));
+	assert (status == 0 || status == MDB_NOTFOUND);
+	if (status == 0)
 	{
-		result = 0;
+		result = value.uint256 ();
 	}
 	return result;
 }
 
+rai::store_iterator rai::block_store::chain_begin (MDB_txn * transaction_a, rai::account const & account_a, uint64_t height_a)
+{
+	auto key (chain_height_key (account_a, height_a));
+	rai::store_iterator result (transaction_a, chain_heights, rai::mdb_val (key.size (), key.data ()));
+	return result;
+}
+
+rai::store_iterator rai::block_store::chain_end ()
+{
+	rai::store_iterator result (nullptr);
+	return result;
+}
+
+void rai::block_store::delegator_put (MDB_txn * transaction_a, rai::account const & representative_a, rai::account const & account_a)
+{
+	auto key (delegator_key (representative_a, account_a));
+	auto status (mdb_put (transaction_a, delegators, rai::mdb_val (key.size (), key.data ()), rai::mdb_val (0, nullptr), 0));
+	assert (status == 0);
+}
+
+void rai::block_store::delegator_del (MDB_txn * transaction_a, rai::account const & representative_a, rai::account const & account_a)
+{
+	auto key (delegator_key (representative_a, account_a));
+	auto status (mdb_del (transaction_a, delegators, rai::mdb_val (key.size (), key.data ()), nullptr));
+	assert (status == 0);
+}
+
+bool rai::block_store::delegator_exists (MDB_txn * transaction_a, rai::account const & representative_a, rai::account const & account_a)
+{
+	auto key (delegator_key (representative_a, account_a));
+	rai::mdb_val value;
+	auto status (mdb_get (transaction_a, delegators, rai::mdb_val (key.size (), key.data ()), value));
+	assert (status == 0 || status == MDB_NOTFOUND);
+	return status == 0;
+}
+
+rai::store_iterator rai::block_store::delegators_begin (MDB_txn * transaction_a, rai::account const & representative_a)
+{
+	auto key (delegator_key (representative_a, rai::account (0)));
+	rai::store_iterator result (transaction_a, delegators, rai::mdb_val (key.size (), key.data ()));
+	return result;
+}
+
+rai::store_iterator rai::block_store::delegators_begin (MDB_txn * transaction_a)
+{
+	rai::store_iterator result (transaction_a, delegators);
+	return result;
+}
+
+rai::store_iterator rai::block_store::delegators_end ()
+{
+	rai::store_iterator result (nullptr);
+	return result;
+}
+
+rai::uint128_t rai::block_store::representation_get (MDB_txn * transaction_a, rai::account const & account_a)
+{
+	return rep_weights.get (account_a);
+}
+
 void rai::block_store::representation_put (MDB_txn * transaction_a, rai::account const & account_a, rai::uint128_t const & representation_a)
 {
 	rai::uint128_union rep (representation_a);
 	auto status (mdb_put (transaction_a, representation, rai::mdb_val (account_a), rai::mdb_val (rep), 0));
 	assert (status == 0);
+	rep_weights.put (account_a, representation_a);
 }
 
 void rai::block_store::unchecked_clear (MDB_txn * transaction_a)
 {
+	unchecked_cache.clear ();
 	auto status (mdb_drop (transaction_a, unchecked, 0));
 	assert (status == 0);
+	auto status1 (mdb_drop (transaction_a, unchecked_arrival, 0));
+	assert (status1 == 0);
 }
 
 void rai::block_store::unchecked_put (MDB_txn * transaction_a, rai::block_hash const & hash_a, std::shared_ptr<rai::block> const & block_a)
 {
-	// Checking if same unchecked block is already in database
-	bool exists (false);
 	auto block_hash (block_a->hash ());
-	auto cached (unchecked_get (transaction_a, hash_a));
-	for (auto i (cached.begin ()), n (cached.end ()); i != n && !exists; ++i)
+	// Checking if same unchecked block is already in memory or in the database
+	auto exists (unchecked_cache.exists (hash_a, block_hash));
+	if (!exists)
 	{
-		if ((*i)->hash () == block_hash)
+		std::vector<uint8_t> vector;
 		{
-			exists = true;
+			rai::vectorstream stream (vector);
+			rai::serialize_block (stream, *block_a);
+		}
+		for (auto i (unchecked_begin (transaction_a, hash_a)), n (unchecked_end ()); i != n && !exists && rai::block_hash (i->first.uint256 ()) == hash_a; i.next_dup ())
+		{
+			exists = unchecked_matches (i->second, vector);
 		}
 	}
-	// Inserting block if it wasn't found in database
+	// Inserting block if it wasn't found
 	if (!exists)
 	{
-		std::lock_guard<std::mutex> lock (cache_mutex);
-		unchecked_cache.insert (std::make_pair (hash_a, block_a));
+		unchecked_cache.put ({ hash_a, block_hash, block_a, rai::seconds_since_epoch () });
+		auto size (unchecked_cache.size ());
+		if (size > unchecked_cache.capacity)
+		{
+			// Spill the oldest entries down to three quarters of capacity so spills happen in batches
+			auto spill (unchecked_cache.pop_oldest (size - (unchecked_cache.capacity - unchecked_cache.capacity / 4)));
+			std::vector<uint8_t> buffer;
+			for (auto & i : spill)
+			{
+				unchecked_write (transaction_a, i, buffer);
+			}
+		}
 	}
 }
 
+void rai::block_store::unchecked_write (MDB_txn * transaction_a, rai::unchecked_info const & info_a, std::vector<uint8_t> & buffer_a)
+{
+	buffer_a.clear ();
+	{
+		rai::vectorstream stream (buffer_a);
+		rai::serialize_block (stream, *info_a.block);
+		rai::write (stream, info_a.arrival);
+	}
+	auto status (mdb_put (transaction_a, unchecked, rai::mdb_val (info_a.dependency), rai::mdb_val (buffer_a.size (), buffer_a.data ()), 0));
+	assert (status == 0);
+	auto key (unchecked_arrival_key (info_a.arrival, info_a.dependency, info_a.hash));
+	auto status1 (mdb_put (transaction_a, unchecked_arrival, rai::mdb_val (key.size (), key.data ()), rai::mdb_val (0, nullptr), 0));
+	assert (status1 == 0);
+}
+
 std::shared_ptr<rai::vote> rai::block_store::vote_get (MDB_txn * transaction_a, rai::account const & account_a)
 {
 	std::shared_ptr<rai::vote> result;
@@ -1023,45 +1681,109 @@ std::shared_ptr<rai::vote> rai::block_store::vote_get (MDB_txn * transaction_a,
 
 std::vector<std::shared_ptr<rai::block>> rai::block_store::unchecked_get (MDB_txn * transaction_a, rai::block_hash const & hash_a)
 {
-	std::vector<std::shared_ptr<rai::block>> result;
+	auto result (unchecked_cache.get (hash_a));
+	for (auto i (unchecked_begin (transaction_a, hash_a)), n (unchecked_end ()); i != n && rai::block_hash (i->first.uint256 ()) == hash_a; i.next_dup ())
 	{
-		std::lock_guard<std::mutex> lock (cache_mutex);
-		for (auto i (unchecked_cache.find (hash_a)), n (unchecked_cache.end ()); i != n && i->first == hash_a; ++i)
+		rai::bufferstream stream (reinterpret_cast<uint8_t const *> (i->second.data ()), i->second.size ());
+		result.push_back (rai::deserialize_block (stream));
+	}
+	return result;
+}
+
+void rai::block_store::unchecked_del (MDB_txn * transaction_a, rai::block_hash const & hash_a, rai::block const & block_a)
+{
+	auto block_hash (block_a.hash ());
+	unchecked_cache.erase (hash_a, block_hash);
+	std::vector<uint8_t> vector;
+	{
+		rai::vectorstream stream (vector);
+		rai::serialize_block (stream, block_a);
+	}
+	auto found (false);
+	for (auto i (unchecked_begin (transaction_a, hash_a)), n (unchecked_end ()); i != n && !found && rai::block_hash (i->first.uint256 ()) == hash_a; i.next_dup ())
+	{
+		if (unchecked_matches (i->second, vector))
 		{
-			result.push_back (i->second);
+			found = true;
+			auto key (unchecked_arrival_key (unchecked_arrival_read (i->second), hash_a, block_hash));
+			auto status (mdb_del (transaction_a, unchecked_arrival, rai::mdb_val (key.size (), key.data ()), nullptr));
+			assert (status == 0 || status == MDB_NOTFOUND);
+			auto status1 (mdb_cursor_del (i.cursor, 0));
+			assert (status1 == 0);
 		}
 	}
+}
+
+std::vector<std::shared_ptr<rai::block>> rai::block_store::unchecked_release (MDB_txn * transaction_a, rai::block_hash const & hash_a)
+{
+	auto result (unchecked_cache.release (hash_a));
+	auto found (false);
 	for (auto i (unchecked_begin (transaction_a, hash_a)), n (unchecked_end ()); i != n && rai::block_hash (i->first.uint256 ()) == hash_a; i.next_dup ())
 	{
+		found = true;
 		rai::bufferstream stream (reinterpret_cast<uint8_t const *> (i->second.data ()), i->second.size ());
-		result.push_back (rai::deserialize_block (stream));
+		std::shared_ptr<rai::block> block (rai::deserialize_block (stream));
+		assert (block != nullptr);
+		auto key (unchecked_arrival_key (unchecked_arrival_read (i->second), hash_a, block->hash ()));
+		auto status (mdb_del (transaction_a, unchecked_arrival, rai::mdb_val (key.size (), key.data ()), nullptr));
+		assert (status == 0 || status == MDB_NOTFOUND);
+		result.push_back (block);
+	}
+	if (found)
+	{
+		// Drops every duplicate under the dependency in one operation
+		auto status (mdb_del (transaction_a, unchecked, rai::mdb_val (hash_a), nullptr));
+		assert (status == 0);
 	}
 	return result;
 }
 
-void rai::block_store::unchecked_del (MDB_txn * transaction_a, rai::block_hash const & hash_a, rai::block const & block_a)
+size_t rai::block_store::unchecked_purge (MDB_txn * transaction_a, uint64_t cutoff_a, size_t max_a)
 {
+	auto result (unchecked_cache.purge (cutoff_a));
+	std::vector<std::array<uint8_t, 72>> expired;
+	auto done (false);
+	for (rai::store_iterator i (transaction_a, unchecked_arrival), n (nullptr); i != n && !done && expired.size () < max_a; ++i)
 	{
-		std::lock_guard<std::mutex> lock (cache_mutex);
-		for (auto i (unchecked_cache.find (hash_a)), n (unchecked_cache.end ()); i != n && i->first == hash_a;)
+		assert (i->first.size () == 72);
+		std::array<uint8_t, 72> key;
+		std::copy (reinterpret_cast<uint8_t const *> (i->first.data ()), reinterpret_cast<uint8_t const *> (i->first.data ()) + key.size (), key.begin ());
+		uint64_t arrival (0);
+		for (auto j (0); j < 8; ++j)
 		{
-			if (*i->second == block_a)
-			{
-				i = unchecked_cache.erase (i);
-			}
-			else
-			{
-				++i;
-			}
+			arrival = (arrival << 8) | key[j];
+		}
+		if (arrival < cutoff_a)
+		{
+			expired.push_back (key);
+		}
+		else
+		{
+			done = true;
 		}
 	}
-	std::vector<uint8_t> vector;
+	for (auto & i : expired)
 	{
-		rai::vectorstream stream (vector);
-		rai::serialize_block (stream, block_a);
+		auto status (mdb_del (transaction_a, unchecked_arrival, rai::mdb_val (i.size (), i.data ()), nullptr));
+		assert (status == 0);
+		rai::block_hash dependency;
+		std::copy (i.begin () + 8, i.begin () + 40, dependency.bytes.begin ());
+		rai::block_hash hash;
+		std::copy (i.begin () + 40, i.end (), hash.bytes.begin ());
+		auto found (false);
+		for (auto j (unchecked_begin (transaction_a, dependency)), n (unchecked_end ()); j != n && !found && rai::block_hash (j->first.uint256 ()) == dependency; j.next_dup ())
+		{
+			auto block (rai::deserialize_block (j->second));
+			if (block != nullptr && block->hash () == hash)
+			{
+				found = true;
+				auto status1 (mdb_cursor_del (j.cursor, 0));
+				assert (status1 == 0);
+				++result;
+			}
+		}
 	}
-	auto status (mdb_del (transaction_a, unchecked, rai::mdb_val (hash_a), rai::mdb_val (vector.size (), vector.data ())));
-	assert (status == 0 || status == MDB_NOTFOUND);
+	return result;
 }
 
 size_t rai::block_store::unchecked_count (MDB_txn * transaction_a)
@@ -1069,7 +1791,7 @@ size_t rai::block_store::unchecked_count (MDB_txn * transaction_a)
 	MDB_stat unchecked_stats;
 	auto status (mdb_stat (transaction_a, unchecked, &unchecked_stats));
 	assert (status == 0);
-	auto result (unchecked_stats.ms_entries);
+	auto result (unchecked_stats.ms_entries + unchecked_cache.size ());
 	return result;
 }
 
@@ -1106,6 +1828,34 @@ rai::store_iterator rai::block_store::unsynced_end ()
 	return rai::store_iterator (nullptr);
 }
 
+void rai::block_store::bootstrap_put (MDB_txn * transaction_a, rai::account const & account_a, rai::mdb_val const & value_a)
+{
+	auto status (mdb_put (transaction_a, bootstrap, rai::mdb_val (account_a), value_a, 0));
+	assert (status == 0);
+}
+
+void rai::block_store::bootstrap_del (MDB_txn * transaction_a, rai::account const & account_a)
+{
+	auto status (mdb_del (transaction_a, bootstrap, rai::mdb_val (account_a), nullptr));
+	assert (status == 0 || status == MDB_NOTFOUND);
+}
+
+rai::store_iterator rai::block_store::bootstrap_begin (MDB_txn * transaction_a)
+{
+	return rai::store_iterator (transaction_a, bootstrap);
+}
+
+rai::store_iterator rai::block_store::bootstrap_end ()
+{
+	return rai::store_iterator (nullptr);
+}
+
+void rai::block_store::bootstrap_clear (MDB_txn * transaction_a)
+{
+	auto status (mdb_drop (transaction_a, bootstrap, 0));
+	assert (status == 0);
+}
+
 void rai::block_store::checksum_put (MDB_txn * transaction_a, uint64_t prefix, uint8_t mask, rai::uint256_union const & hash_a)
 {
 	assert ((prefix & 0xff) == 0);
@@ -1147,30 +1897,24 @@ void rai::block_store::checksum_del (MDB_txn * transaction_a, uint64_t prefix, u
 void rai::block_store::flush (MDB_txn * transaction_a)
 {
 	std::unordered_map<rai::account, std::shared_ptr<rai::vote>> sequence_cache_l;
-	std::unordered_multimap<rai::block_hash, std::shared_ptr<rai::block>> unchecked_cache_l;
 	{
 		std::lock_guard<std::mutex> lock (cache_mutex);
 		sequence_cache_l.swap (vote_cache);
-		unchecked_cache_l.swap (unchecked_cache);
 	}
-	for (auto & i : unchecked_cache_l)
+	// One buffer is reused for every entry, clearing keeps its capacity
+	std::vector<uint8_t> buffer;
+	for (auto & i : unchecked_cache.drain ())
 	{
-		std::vector<uint8_t> vector;
-		{
-			rai::vectorstream stream (vector);
-			rai::serialize_block (stream, *i.second);
-		}
-		auto status (mdb_put (transaction_a, unchecked, rai::mdb_val (i.first), rai::mdb_val (vector.size (), vector.data ()), 0));
-		assert (status == 0);
+		unchecked_write (transaction_a, i, buffer);
 	}
 	for (auto i (sequence_cache_l.begin ()), n (sequence_cache_l.end ()); i != n; ++i)
 	{
-		std::vector<uint8_t> vector;
+		buffer.clear ();
 		{
-			rai::vectorstream stream (vector);
+			rai::vectorstream stream (buffer);
 			i->second->serialize (stream);
 		}
-		auto status1 (mdb_put (transaction_a, vote, rai::mdb_val (i->first), rai::mdb_val (vector.size (), vector.data ()), 0));
+		auto status1 (mdb_put (transaction_a, vote, rai::mdb_val (i->first), rai::mdb_val (buffer.size (), buffer.data ()), 0));
 		assert (status1 == 0);
 	}
 }
@@ -2,6 +2,15 @@
 
 #include <banano/common.hpp>
 
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index_container.hpp>
+
+#include <list>
+#include <shared_mutex>
+
 namespace rai
 {
 /**
@@ -40,26 +49,143 @@ public:
 	rai::store_entry current;
 };
 
+/**
+ * Sharded LRU of deserialized blocks keyed by hash
+ * Entries are dropped when a block is deleted or rewritten with different contents
+ */
+class block_cache
+{
+public:
+	block_cache (size_t);
+	std::shared_ptr<rai::block const> get (rai::block_hash const &);
+	// Inserts are skipped when the reading transaction predates a delete in the same shard
+	void put (rai::block_hash const &, std::shared_ptr<rai::block const> const &, size_t);
+	void erase (rai::block_hash const &, size_t);
+	void clear ();
+	size_t size ();
+	size_t const capacity;
+	std::atomic<uint64_t> hits;
+	std::atomic<uint64_t> misses;
+	static size_t constexpr shard_count = 16;
+
+private:
+	class shard
+	{
+	public:
+		using entry = std::pair<rai::block_hash, std::shared_ptr<rai::block const>>;
+		std::mutex mutex;
+		// Most recently used at the front
+		std::list<entry> entries;
+		std::unordered_map<rai::block_hash, std::list<entry>::iterator> index;
+		// Id of the newest write transaction that deleted a block in this shard
+		size_t last_delete;
+	};
+	shard & shard_for (rai::block_hash const &);
+	size_t const shard_capacity;
+	std::array<shard, shard_count> shards;
+};
+
+/**
+ * In memory copy of the representation table so weight lookups don't touch LMDB
+ * Written by the store alongside the table, many readers can hold the lock at once
+ */
+class rep_weights
+{
+public:
+	rai::uint128_t get (rai::account const &);
+	void put (rai::account const &, rai::uint128_t const &);
+	void clear ();
+	// Copy of every entry ordered by account
+	std::vector<std::pair<rai::account, rai::uint128_t>> list ();
+	size_t size ();
+
+private:
+	std::shared_timed_mutex mutex;
+	std::unordered_map<rai::account, rai::uint128_t> weights;
+};
+
+/**
+ * Number and sum of the pending entries of an account
+ */
+class pending_total
+{
+public:
+	pending_total ();
+	uint64_t count;
+	rai::uint128_t amount;
+};
+
+/**
+ * A gap block waiting for the block it depends on
+ */
+class unchecked_info
+{
+public:
+	rai::block_hash dependency;
+	rai::block_hash hash;
+	std::shared_ptr<rai::block> block;
+	// Seconds since epoch when the block was first stored
+	uint64_t arrival;
+};
+
+/**
+ * Unchecked blocks not yet written to the unchecked table, indexed by the missing dependency and kept in arrival order
+ * The store spills the oldest entries to disk once capacity is exceeded
+ */
+class unchecked_cache
+{
+public:
+	unchecked_cache (size_t);
+	// Returns true if this block was already waiting on the dependency
+	bool put (rai::unchecked_info const &);
+	bool exists (rai::block_hash const &, rai::block_hash const &);
+	std::vector<std::shared_ptr<rai::block>> get (rai::block_hash const &);
+	void erase (rai::block_hash const &, rai::block_hash const &);
+	// Removes and returns every block waiting on the dependency
+	std::vector<std::shared_ptr<rai::block>> release (rai::block_hash const &);
+	// Removes and returns up to count of the oldest entries
+	std::vector<rai::unchecked_info> pop_oldest (size_t);
+	// Removes and returns every entry, oldest first
+	std::vector<rai::unchecked_info> drain ();
+	// Drops entries that arrived before the cutoff, returns the number dropped
+	size_t purge (uint64_t);
+	void clear ();
+	size_t size ();
+	size_t const capacity;
+
+private:
+	std::mutex mutex;
+	boost::multi_index_container<
+	rai::unchecked_info,
+	boost::multi_index::indexed_by<
+	boost::multi_index::ordered_unique<boost::multi_index::composite_key<rai::unchecked_info, boost::multi_index::member<rai::unchecked_info, rai::block_hash, &rai::unchecked_info::dependency>, boost::multi_index::member<rai::unchecked_info, rai::block_hash, &rai::unchecked_info::hash>>>,
+	boost::multi_index::sequenced<>>>
+	entries;
+};
+
 /**
  * Manages block storage and iteration
  */
 class block_store
 {
 public:
-	block_store (bool &, boost::filesystem::path const &, int lmdb_max_dbs = 128);
+	block_store (bool &, boost::filesystem::path const &, int lmdb_max_dbs = 128, size_t block_cache_size = 64 * 1024, size_t unchecked_cache_size = 64 * 1024, unsigned lmdb_flags = 0, size_t lmdb_map_size = 1ULL * 1024 * 1024 * 1024 * 1024, uint64_t block_info_max = 32, uint64_t block_info_dense = 0);
 
-	MDB_dbi block_database (rai::block_type);
-	void block_put_raw (MDB_txn *, MDB_dbi, rai::block_hash const &, MDB_val);
+	// Value is the whole record: type byte, serialized block, successor
+	void block_put_raw (MDB_txn *, rai::block_hash const &, MDB_val);
 	void block_put (MDB_txn *, rai::block_hash const &, rai::block const &, rai::block_hash const & = rai::block_hash (0));
+	// Returns the serialized block and successor with the type byte stripped
 	MDB_val block_get_raw (MDB_txn *, rai::block_hash const &, rai::block_type &);
 	rai::block_hash block_successor (MDB_txn *, rai::block_hash const &);
 	void block_successor_clear (MDB_txn *, rai::block_hash const &);
 	std::unique_ptr<rai::block> block_get (MDB_txn *, rai::block_hash const &);
+	// Shared read only copy served through the block cache
+	std::shared_ptr<rai::block const> block_get_cached (MDB_txn *, rai::block_hash const &);
 	std::unique_ptr<rai::block> block_random (MDB_txn *);
-	std::unique_ptr<rai::block> block_random (MDB_txn *, MDB_dbi);
 	void block_del (MDB_txn *, rai::block_hash const &);
 	bool block_exists (MDB_txn *, rai::block_hash const &);
 	rai::block_counts block_count (MDB_txn *);
+	void block_count_add (MDB_txn *, rai::block_type, int64_t);
 
 	void frontier_put (MDB_txn *, rai::block_hash const &, rai::account const &);
 	rai::account frontier_get (MDB_txn *, rai::block_hash const &);
@@ -81,6 +207,15 @@ public:
 	rai::store_iterator pending_begin (MDB_txn *, rai::pending_key const &);
 	rai::store_iterator pending_begin (MDB_txn *);
 	rai::store_iterator pending_end ();
+	// Maintained by pending_put and pending_del, zero for accounts with nothing pending
+	rai::pending_total pending_total_get (MDB_txn *, rai::account const &);
+	// Amount wraps like representation_add so it can be subtracted
+	void pending_total_add (MDB_txn *, rai::account const &, int64_t, rai::uint128_t const &);
+	rai::store_iterator pending_totals_begin (MDB_txn *);
+	rai::store_iterator pending_totals_end ();
+	// Visits the pending entries of each account through one cursor, seeking the accounts in key order
+	// Returning false from the visitor skips the rest of that account's entries
+	void pending_for_each (MDB_txn *, std::vector<rai::account> const &, std::function<bool(rai::pending_key const &, rai::pending_info const &)> const &);
 
 	void block_info_put (MDB_txn *, rai::block_hash const &, rai::block_info const &);
 	void block_info_del (MDB_txn *, rai::block_hash const &);
@@ -90,23 +225,53 @@ public:
 	rai::store_iterator block_info_begin (MDB_txn *);
 	rai::store_iterator block_info_end ();
 	rai::uint128_t block_balance (MDB_txn *, rai::block_hash const &);
-	static size_t const block_info_max = 32;
+	// Position of a block in its account chain, the open block is at height 1
+	void block_height_put (MDB_txn *, rai::block_hash const &, rai::account const &, uint64_t);
+	void block_height_del (MDB_txn *, rai::block_hash const &);
+	bool block_height_get (MDB_txn *, rai::block_hash const &, rai::account &, uint64_t &);
+	// Zero if the chain is shorter than the height
+	rai::block_hash block_at_height (MDB_txn *, rai::account const &, uint64_t);
+	// Walks the chain upwards from the height, the iterator continues into the next account's chain
+	rai::store_iterator chain_begin (MDB_txn *, rai::account const &, uint64_t);
+	rai::store_iterator chain_end ();
+	// Whether the block at this height in its chain carries a blocks_info record
+	bool block_info_due (uint64_t) const;
+	// Rewrites blocks_info for the current layout
+	void block_info_rebuild (MDB_txn *);
+	// Every block_info_max'th block gets a record, as does every block from height block_info_dense onwards unless it's 0
+	uint64_t const block_info_max;
+	uint64_t const block_info_dense;
 
+	// Served from rep_weights, which is loaded when the store opens
 	rai::uint128_t representation_get (MDB_txn *, rai::account const &);
 	void representation_put (MDB_txn *, rai::account const &, rai::uint128_t const &);
 	void representation_add (MDB_txn *, rai::account const &, rai::uint128_t const &);
 	rai::store_iterator representation_begin (MDB_txn *);
+	void delegator_put (MDB_txn *, rai::account const &, rai::account const &);
+	void delegator_del (MDB_txn *, rai::account const &, rai::account const &);
+	bool delegator_exists (MDB_txn *, rai::account const &, rai::account const &);
+	// Keys are the representative followed by the delegating account, iteration continues past the representative's last delegator
+	rai::store_iterator delegators_begin (MDB_txn *, rai::account const &);
+	rai::store_iterator delegators_begin (MDB_txn *);
+	rai::store_iterator delegators_end ();
 	rai::store_iterator representation_end ();
+	rai::rep_weights rep_weights;
 
 	void unchecked_clear (MDB_txn *);
 	void unchecked_put (MDB_txn *, rai::block_hash const &, std::shared_ptr<rai::block> const &);
 	std::vector<std::shared_ptr<rai::block>> unchecked_get (MDB_txn *, rai::block_hash const &);
 	void unchecked_del (MDB_txn *, rai::block_hash const &, rai::block const &);
+	// Removes and returns every block waiting on the dependency
+	std::vector<std::shared_ptr<rai::block>> unchecked_release (MDB_txn *, rai::block_hash const &);
+	// Deletes up to max entries that arrived before the cutoff in seconds since epoch, returns the number deleted
+	size_t unchecked_purge (MDB_txn *, uint64_t, size_t);
 	rai::store_iterator unchecked_begin (MDB_txn *);
 	rai::store_iterator unchecked_begin (MDB_txn *, rai::block_hash const &);
 	rai::store_iterator unchecked_end ();
 	size_t unchecked_count (MDB_txn *);
-	std::unordered_multimap<rai::block_hash, std::shared_ptr<rai::block>> unchecked_cache;
+	// Buffer is scratch space for serialization, reused across calls
+	void unchecked_write (MDB_txn *, rai::unchecked_info const &, std::vector<uint8_t> &);
+	rai::unchecked_cache unchecked_cache;
 
 	void unsynced_put (MDB_txn *, rai::block_hash const &);
 	void unsynced_del (MDB_txn *, rai::block_hash const &);
@@ -115,6 +280,13 @@ public:
 	rai::store_iterator unsynced_begin (MDB_txn *);
 	rai::store_iterator unsynced_end ();
 
+	// Bootstrap progress saved across restarts, the zero account holds the frontier cursor
+	void bootstrap_put (MDB_txn *, rai::account const &, rai::mdb_val const &);
+	void bootstrap_del (MDB_txn *, rai::account const &);
+	rai::store_iterator bootstrap_begin (MDB_txn *);
+	rai::store_iterator bootstrap_end ();
+	void bootstrap_clear (MDB_txn *);
+
 	void checksum_put (MDB_txn *, uint64_t, uint8_t, rai::checksum const &);
 	bool checksum_get (MDB_txn *, uint64_t, uint8_t, rai::checksum &);
 	void checksum_del (MDB_txn *, uint64_t, uint8_t);
@@ -133,6 +305,7 @@ public:
 	rai::store_iterator vote_end ();
 	std::mutex cache_mutex;
 	std::unordered_map<rai::account, std::shared_ptr<rai::vote>> vote_cache;
+	rai::block_cache block_cache;
 
 	void version_put (MDB_txn *, int);
 	int version_get (MDB_txn *);
@@ -146,37 +319,52 @@ public:
 	void upgrade_v7_to_v8 (MDB_txn *);
 	void upgrade_v8_to_v9 (MDB_txn *);
 	void upgrade_v9_to_v10 (MDB_txn *);
+	void upgrade_v10_to_v11 (MDB_txn *);
+	void upgrade_v11_to_v12 (MDB_txn *);
+	void upgrade_v12_to_v13 (MDB_txn *);
+	void upgrade_v13_to_v14 (MDB_txn *);
+	void upgrade_v14_to_v15 (MDB_txn *);
+	void upgrade_v15_to_v16 (MDB_txn *);
+	void block_info_upgrade (MDB_txn *);
+	void merge_block_tables (MDB_txn *);
 
 	void clear (MDB_dbi);
+	void clear (MDB_txn *, MDB_dbi);
 
 	rai::mdb_env environment;
 	// block_hash -> account                                        // Maps head blocks to owning account
 	MDB_dbi frontiers;
 	// account -> block_hash, representative, balance, timestamp    // Account to head block, representative, balance, last_change
 	MDB_dbi accounts;
-	// block_hash -> send_block
-	MDB_dbi send_blocks;
-	// block_hash -> receive_block
-	MDB_dbi receive_blocks;
-	// block_hash -> open_block
-	MDB_dbi open_blocks;
-	// block_hash -> change_block
-	MDB_dbi change_blocks;
+	// block_hash -> block_type, block, successor                   // All blocks, tagged with their type
+	MDB_dbi blocks;
 	// block_hash -> sender, amount, destination                    // Pending blocks to sender account, amount, destination account
 	MDB_dbi pending;
-	// block_hash -> account, balance                               // Blocks info
+	// account -> uint64_t, uint128_t                               // Count and sum of each account's pending entries
+	MDB_dbi pending_totals;
+	// block_hash -> account, balance, height                       // Blocks info, sparse at the layout recorded in meta
 	MDB_dbi blocks_info;
+	// block_hash -> account, uint64_t                              // Height of each block in its account chain
+	MDB_dbi block_heights;
+	// account, uint64_t -> block_hash                              // Account chains by big endian height
+	MDB_dbi chain_heights;
+	// account, account ->                                          // Representative followed by each account delegating to it
+	MDB_dbi delegators;
 	// account -> weight                                            // Representation
 	MDB_dbi representation;
-	// block_hash -> block                                          // Unchecked bootstrap blocks
+	// block_hash -> block, arrival                                 // Unchecked bootstrap blocks keyed by the missing dependency
 	MDB_dbi unchecked;
+	// arrival, block_hash, block_hash ->                           // Unchecked entries by arrival then dependency and block hash, used for expiry
+	MDB_dbi unchecked_arrival;
 	// block_hash ->                                                // Blocks that haven't been broadcast
 	MDB_dbi unsynced;
+	// account -> head, end, attempts                               // Outstanding bootstrap pulls, account zero holds the frontier cursor and whether frontiers completed
+	MDB_dbi bootstrap;
 	// (uint56_t, uint8_t) -> block_hash                            // Mapping of region to checksum
 	MDB_dbi checksum;
 	// account -> uint64_t											// Highest vote observed for account
 	MDB_dbi vote;
-	// uint256_union -> ?											// Meta information about block store
+	// uint256_union -> ?											// Meta information about block store, 1 holds the version, 2 the block counts by type and 3 the blocks_info layout
 	MDB_dbi meta;
 };
 }
@@ -107,12 +107,15 @@ rai::block_hash const & rai::not_an_account (globals.not_an_account);
 rai::account const & rai::burn_account (globals.burn_account);
 
 rai::votes::votes (std::shared_ptr<rai::block> block_a) :
-id (block_a->root ())
+id (block_a->root ()),
+leader_hash (block_a->hash ())
 {
 	rep_votes.insert (std::make_pair (rai::not_an_account, block_a));
+	counted.insert (std::make_pair (rai::not_an_account, 0));
+	total_add (block_a, 0);
 }
 
-rai::tally_result rai::votes::vote (std::shared_ptr<rai::vote> vote_a)
+rai::tally_result rai::votes::vote (std::shared_ptr<rai::vote> vote_a, rai::uint128_t const & weight_a)
 {
 	rai::tally_result result;
 	auto existing (rep_votes.find (vote_a->account));
@@ -121,9 +124,13 @@ rai::tally_result rai::votes::vote (std::shared_ptr<rai::vote> vote_a)
 		// Vote on this block hasn't been seen from rep before
 		result = rai::tally_result::vote;
 		rep_votes.insert (std::make_pair (vote_a->account, vote_a->block));
+		total_add (vote_a->block, weight_a);
 	}
 	else
 	{
+		// Take back what this rep contributed last time, its weight may have changed since
+		auto & counted_l (counted[vote_a->account]);
+		total_subtract (existing->second, counted_l);
 		if (!(*existing->second == *vote_a->block))
 		{
 			// Rep changed their vote
@@ -135,10 +142,54 @@ rai::tally_result rai::votes::vote (std::shared_ptr<rai::vote> vote_a)
 			// Rep vote remained the same
 			result = rai::tally_result::confirm;
 		}
+		total_add (existing->second, weight_a);
 	}
+	counted[vote_a->account] = weight_a;
 	return result;
 }
 
+std::pair<rai::uint128_t, std::shared_ptr<rai::block>> rai::votes::leader () const
+{
+	auto existing (totals.find (leader_hash));
+	assert (existing != totals.end ());
+	return existing->second;
+}
+
+void rai::votes::total_add (std::shared_ptr<rai::block> const & block_a, rai::uint128_t const & weight_a)
+{
+	auto hash (block_a->hash ());
+	auto & total (totals[hash]);
+	if (total.second == nullptr)
+	{
+		total.second = block_a;
+	}
+	total.first += weight_a;
+	if (total.first > totals[leader_hash].first)
+	{
+		leader_hash = hash;
+	}
+}
+
+void rai::votes::total_subtract (std::shared_ptr<rai::block> const & block_a, rai::uint128_t const & weight_a)
+{
+	auto hash (block_a->hash ());
+	auto existing (totals.find (hash));
+	assert (existing != totals.end ());
+	assert (existing->second.first >= weight_a);
+	existing->second.first -= weight_a;
+	if (hash == leader_hash)
+	{
+		// Only the leader losing weight can change who leads, candidates are few so rescan them
+		for (auto & i : totals)
+		{
+			if (i.second.first > totals[leader_hash].first)
+			{
+				leader_hash = i.first;
+			}
+		}
+	}
+}
+
 // Create a new random keypair
 rai::keypair::keypair ()
 {
@@ -344,20 +395,22 @@ rai::mdb_val rai::pending_key::val () const
 
 rai::block_info::block_info () :
 account (0),
-balance (0)
+balance (0),
+height (0)
 {
 }
 
 rai::block_info::block_info (MDB_val const & val_a)
 {
 	assert (val_a.mv_size == sizeof (*this));
-	static_assert (sizeof (account) + sizeof (balance) == sizeof (*this), "Packed class");
+	static_assert (sizeof (account) + sizeof (balance) + sizeof (height) == sizeof (*this), "Packed class");
 	std::copy (reinterpret_cast<uint8_t const *> (val_a.mv_data), reinterpret_cast<uint8_t const *> (val_a.mv_data) + sizeof (*this), reinterpret_cast<uint8_t *> (this));
 }
 
-rai::block_info::block_info (rai::account const & account_a, rai::amount const & balance_a) :
+rai::block_info::block_info (rai::account const & account_a, rai::amount const & balance_a, uint64_t height_a) :
 account (account_a),
-balance (balance_a)
+balance (balance_a),
+height (height_a)
 {
 }
 
@@ -365,6 +418,7 @@ void rai::block_info::serialize (rai::stream & stream_a) const
 {
 	rai::write (stream_a, account.bytes);
 	rai::write (stream_a, balance.bytes);
+	rai::write (stream_a, height);
 }
 
 bool rai::block_info::deserialize (rai::stream & stream_a)
@@ -373,13 +427,17 @@ bool rai::block_info::deserialize (rai::stream & stream_a)
 	if (!error)
 	{
 		error = rai::read (stream_a, balance.bytes);
+		if (!error)
+		{
+			error = rai::read (stream_a, height);
+		}
 	}
 	return error;
 }
 
 bool rai::block_info::operator== (rai::block_info const & other_a) const
 {
-	return account == other_a.account && balance == other_a.balance;
+	return account == other_a.account && balance == other_a.balance && height == other_a.height;
 }
 
 rai::mdb_val rai::block_info::val () const
@@ -530,7 +588,7 @@ void rai::balance_visitor::compute (rai::block_hash const & block_hash)
 	current = block_hash;
 	while (!current.is_zero ())
 	{
-		auto block (store.block_get (transaction, current));
+		auto block (store.block_get_cached (transaction, current));
 		assert (block != nullptr);
 		block->visit (*this);
 	}
@@ -548,7 +606,7 @@ void rai::representative_visitor::compute (rai::block_hash const & hash_a)
 	current = hash_a;
 	while (result.is_zero ())
 	{
-		auto block (store.block_get (transaction, current));
+		auto block (store.block_get_cached (transaction, current));
 		assert (block != nullptr);
 		block->visit (*this);
 	}
@@ -616,7 +674,7 @@ rai::vote::vote (bool & error_a, rai::stream & stream_a, rai::block_type type_a)
 				error_a = rai::read (stream_a, sequence);
 				if (!error_a)
 				{
-					block = rai::deserialize_block (stream_a, type_a);
+					block = rai::deserialize_block_pooled (stream_a, type_a);
 					error_a = block == nullptr;
 				}
 			}
@@ -694,6 +752,8 @@ void rai::genesis::initialize (MDB_txn * transaction_a, rai::block_store & store
 	assert (store_a.latest_begin (transaction_a) == store_a.latest_end ());
 	store_a.block_put (transaction_a, hash_l, *open);
 	store_a.account_put (transaction_a, genesis_account, { hash_l, open->hash (), open->hash (), std::numeric_limits<rai::uint128_t>::max (), rai::seconds_since_epoch (), 1 });
+	store_a.block_height_put (transaction_a, hash_l, genesis_account, 1);
+	store_a.delegator_put (transaction_a, genesis_account, genesis_account);
 	store_a.representation_put (transaction_a, genesis_account, std::numeric_limits<rai::uint128_t>::max ());
 	store_a.checksum_put (transaction_a, 0, 0, hash_l);
 	store_a.frontier_put (transaction_a, hash_l, genesis_account);
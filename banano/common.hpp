@@ -153,13 +153,15 @@ class block_info
 public:
 	block_info ();
 	block_info (MDB_val const &);
-	block_info (rai::account const &, rai::amount const &);
+	block_info (rai::account const &, rai::amount const &, uint64_t);
 	void serialize (rai::stream &) const;
 	bool deserialize (rai::stream &);
 	bool operator== (rai::block_info const &) const;
 	rai::mdb_val val () const;
 	rai::account account;
 	rai::amount balance;
+	// Position in the account chain, the open block is 1
+	uint64_t height;
 };
 class block_counts
 {
@@ -239,11 +241,23 @@ class votes
 {
 public:
 	votes (std::shared_ptr<rai::block>);
-	rai::tally_result vote (std::shared_ptr<rai::vote>);
+	// Record a vote carrying the rep's current weight, running totals are adjusted in place
+	rai::tally_result vote (std::shared_ptr<rai::vote>, rai::uint128_t const &);
+	// Candidate with the highest running total
+	std::pair<rai::uint128_t, std::shared_ptr<rai::block>> leader () const;
 	// Root block of fork
 	rai::block_hash id;
 	// All votes received by account
 	std::unordered_map<rai::account, std::shared_ptr<rai::block>> rep_votes;
+	// Weight counted for each rep's current vote
+	std::unordered_map<rai::account, rai::uint128_t> counted;
+	// Running weight and block for each candidate
+	std::unordered_map<rai::block_hash, std::pair<rai::uint128_t, std::shared_ptr<rai::block>>> totals;
+
+private:
+	void total_add (std::shared_ptr<rai::block> const &, rai::uint128_t const &);
+	void total_subtract (std::shared_ptr<rai::block> const &, rai::uint128_t const &);
+	rai::block_hash leader_hash;
 };
 extern rai::keypair const & zero_key;
 extern rai::keypair const & test_genesis_key;
@@ -69,6 +69,22 @@ TEST (block, send_serialize_json)
 	ASSERT_EQ (block1, block2);
 }
 
+TEST (block, deserialize_pooled)
+{
+	rai::send_block block1 (0, 1, 2, rai::keypair ().prv, 4, 5);
+	std::vector<uint8_t> bytes;
+	{
+		rai::vectorstream stream1 (bytes);
+		block1.serialize (stream1);
+	}
+	rai::bufferstream stream2 (bytes.data (), bytes.size ());
+	auto block2 (rai::deserialize_block_pooled (stream2, rai::block_type::send));
+	ASSERT_NE (nullptr, block2);
+	ASSERT_EQ (block1, *block2);
+	rai::bufferstream stream3 (bytes.data (), bytes.size () - 1);
+	ASSERT_EQ (nullptr, rai::deserialize_block_pooled (stream3, rai::block_type::send));
+}
+
 TEST (block, receive_serialize)
 {
 	rai::receive_block block1 (0, 1, rai::keypair ().prv, 3, 4);
@@ -36,6 +36,82 @@ TEST (block_store, add_item)
 	ASSERT_EQ (nullptr, latest3);
 }
 
+TEST (block_store, block_get_cached)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_TRUE (!init);
+	rai::open_block block (0, 1, 0, rai::keypair ().prv, 0, 0);
+	auto hash1 (block.hash ());
+	rai::transaction transaction (store.environment, nullptr, true);
+	ASSERT_EQ (nullptr, store.block_get_cached (transaction, hash1));
+	store.block_put (transaction, hash1, block);
+	auto latest1 (store.block_get_cached (transaction, hash1));
+	ASSERT_NE (nullptr, latest1);
+	ASSERT_EQ (block, *latest1);
+	auto misses (store.block_cache.misses.load ());
+	auto latest2 (store.block_get_cached (transaction, hash1));
+	ASSERT_EQ (latest1, latest2);
+	ASSERT_EQ (misses, store.block_cache.misses);
+	ASSERT_EQ (1, store.block_cache.hits);
+	ASSERT_EQ (1, store.block_cache.size ());
+	store.block_del (transaction, hash1);
+	ASSERT_EQ (0, store.block_cache.size ());
+	ASSERT_EQ (nullptr, store.block_get_cached (transaction, hash1));
+}
+
+TEST (block_store, block_cache_rewrite)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_TRUE (!init);
+	rai::open_block block1 (0, 1, 0, rai::keypair ().prv, 0, 1);
+	auto hash1 (block1.hash ());
+	rai::transaction transaction (store.environment, nullptr, true);
+	store.block_put (transaction, hash1, block1);
+	ASSERT_EQ (block1, *store.block_get_cached (transaction, hash1));
+	// Same hash with higher work, as the ledger stores when it sees a better copy of a block it already has
+	rai::open_block block2 (block1);
+	block2.block_work_set (2);
+	ASSERT_EQ (hash1, block2.hash ());
+	store.block_put (transaction, hash1, block2);
+	auto cached (store.block_get_cached (transaction, hash1));
+	ASSERT_NE (nullptr, cached);
+	ASSERT_EQ (2, cached->block_work ());
+	ASSERT_EQ (block2, *cached);
+}
+
+TEST (block_cache, eviction)
+{
+	rai::block_cache cache (rai::block_cache::shard_count);
+	auto block (std::make_shared<rai::open_block> (0, 1, 0, rai::keypair ().prv, 0, 0));
+	// Both hashes land in the same single entry shard
+	rai::block_hash hash1 (1);
+	rai::block_hash hash2 (hash1);
+	hash2.bytes[31] = 2;
+	cache.put (hash1, block, 0);
+	ASSERT_EQ (block, cache.get (hash1));
+	cache.put (hash2, block, 0);
+	ASSERT_EQ (nullptr, cache.get (hash1));
+	ASSERT_EQ (block, cache.get (hash2));
+	ASSERT_EQ (1, cache.size ());
+}
+
+TEST (block_cache, stale_insert)
+{
+	rai::block_cache cache (1024);
+	auto block (std::make_shared<rai::open_block> (0, 1, 0, rai::keypair ().prv, 0, 0));
+	rai::block_hash hash1 (1);
+	cache.erase (hash1, 10);
+	// A reader whose snapshot predates the delete must not put the block back
+	cache.put (hash1, block, 9);
+	ASSERT_EQ (nullptr, cache.get (hash1));
+	cache.put (hash1, block, 10);
+	ASSERT_EQ (block, cache.get (hash1));
+	cache.clear ();
+	ASSERT_EQ (0, cache.size ());
+}
+
 TEST (block_store, add_nonempty_block)
 {
 	bool init (false);
@@ -176,6 +252,36 @@ TEST (representation, changes)
 	ASSERT_EQ (2, store.representation_get (transaction, key1.pub));
 }
 
+TEST (representation, loaded_on_open)
+{
+	auto path (rai::unique_path ());
+	rai::account account1 (1);
+	rai::account account2 (2);
+	{
+		bool init (false);
+		rai::block_store store (init, path);
+		ASSERT_FALSE (init);
+		rai::transaction transaction (store.environment, nullptr, true);
+		store.representation_put (transaction, account2, 20);
+		store.representation_put (transaction, account1, 10);
+	}
+	bool init (false);
+	rai::block_store store (init, path);
+	ASSERT_FALSE (init);
+	ASSERT_EQ (2, store.rep_weights.size ());
+	{
+		rai::transaction transaction (store.environment, nullptr, false);
+		ASSERT_EQ (10, store.representation_get (transaction, account1));
+		ASSERT_EQ (20, store.representation_get (transaction, account2));
+	}
+	auto weights (store.rep_weights.list ());
+	ASSERT_EQ (2, weights.size ());
+	ASSERT_EQ (account1, weights[0].first);
+	ASSERT_EQ (20, weights[1].second);
+	store.clear (store.representation);
+	ASSERT_EQ (0, store.rep_weights.get (account1));
+}
+
 TEST (bootstrap, simple)
 {
 	bool init (false);
@@ -266,6 +372,83 @@ TEST (block_store, one_block)
 	ASSERT_TRUE (store.block_exists (transaction, block1.hash ()));
 }
 
+TEST (unchecked, spill)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path (), 128, 64 * 1024, 4);
+	ASSERT_TRUE (!init);
+	rai::transaction transaction (store.environment, nullptr, true);
+	rai::keypair key;
+	std::vector<std::shared_ptr<rai::send_block>> blocks;
+	for (auto i (0); i < 5; ++i)
+	{
+		blocks.push_back (std::make_shared<rai::send_block> (i, 1, 2, key.prv, key.pub, 3));
+		store.unchecked_put (transaction, blocks.back ()->previous (), blocks.back ());
+	}
+	// Going over capacity spills the oldest entries down to three quarters of it
+	ASSERT_EQ (3, store.unchecked_cache.size ());
+	ASSERT_EQ (5, store.unchecked_count (transaction));
+	for (auto & i : blocks)
+	{
+		auto cached (store.unchecked_get (transaction, i->previous ()));
+		ASSERT_EQ (1, cached.size ());
+		ASSERT_EQ (*i, *cached[0]);
+	}
+	// Putting a block that was already spilled doesn't duplicate it
+	store.unchecked_put (transaction, blocks[0]->previous (), blocks[0]);
+	ASSERT_EQ (5, store.unchecked_count (transaction));
+	store.unchecked_del (transaction, blocks[0]->previous (), *blocks[0]);
+	ASSERT_TRUE (store.unchecked_get (transaction, blocks[0]->previous ()).empty ());
+	ASSERT_EQ (4, store.unchecked_count (transaction));
+}
+
+TEST (unchecked, release)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_TRUE (!init);
+	rai::transaction transaction (store.environment, nullptr, true);
+	rai::keypair key;
+	auto block1 (std::make_shared<rai::send_block> (4, 1, 2, key.prv, key.pub, 3));
+	auto block2 (std::make_shared<rai::send_block> (4, 5, 6, key.prv, key.pub, 7));
+	auto block3 (std::make_shared<rai::send_block> (8, 1, 2, key.prv, key.pub, 3));
+	store.unchecked_put (transaction, block1->previous (), block1);
+	store.flush (transaction);
+	store.unchecked_put (transaction, block2->previous (), block2);
+	store.unchecked_put (transaction, block3->previous (), block3);
+	// Dependents are gathered from memory and disk
+	auto released (store.unchecked_release (transaction, block1->previous ()));
+	ASSERT_EQ (2, released.size ());
+	ASSERT_TRUE (store.unchecked_get (transaction, block1->previous ()).empty ());
+	ASSERT_EQ (1, store.unchecked_count (transaction));
+	ASSERT_TRUE (store.unchecked_release (transaction, block1->previous ()).empty ());
+}
+
+TEST (unchecked, purge)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_TRUE (!init);
+	rai::transaction transaction (store.environment, nullptr, true);
+	rai::keypair key;
+	auto block1 (std::make_shared<rai::send_block> (4, 1, 2, key.prv, key.pub, 3));
+	auto block2 (std::make_shared<rai::send_block> (5, 1, 2, key.prv, key.pub, 3));
+	auto block3 (std::make_shared<rai::send_block> (6, 1, 2, key.prv, key.pub, 3));
+	store.unchecked_put (transaction, block1->previous (), block1);
+	store.unchecked_put (transaction, block2->previous (), block2);
+	store.flush (transaction);
+	store.unchecked_put (transaction, block3->previous (), block3);
+	auto now (rai::seconds_since_epoch ());
+	ASSERT_EQ (0, store.unchecked_purge (transaction, now - 60, 16));
+	ASSERT_EQ (3, store.unchecked_count (transaction));
+	// Expiry is limited per call on disk, memory entries always go
+	ASSERT_EQ (2, store.unchecked_purge (transaction, now + 1, 1));
+	ASSERT_EQ (1, store.unchecked_count (transaction));
+	ASSERT_EQ (1, store.unchecked_purge (transaction, now + 1, 16));
+	ASSERT_EQ (0, store.unchecked_count (transaction));
+	ASSERT_EQ (store.unchecked_end (), store.unchecked_begin (transaction));
+}
+
 TEST (block_store, empty_bootstrap)
 {
 	bool init (false);
@@ -986,3 +1169,173 @@ TEST (block_store, upgrade_v9_v10)
 	ASSERT_EQ (block_info.account, rai::test_genesis_key.pub);
 	ASSERT_EQ (block_info.balance.number (), rai::genesis_amount - rai::kBAN_ratio * 31);
 }
+
+TEST (block_store, upgrade_v10_v11)
+{
+	auto path (rai::unique_path ());
+	rai::send_block send (0, 1, 2, rai::keypair ().prv, 4, 5);
+	rai::change_block change (send.hash (), 1, rai::keypair ().prv, 3, 4);
+	{
+		bool init (false);
+		rai::block_store store (init, path);
+		ASSERT_FALSE (init);
+		rai::transaction transaction (store.environment, nullptr, true);
+		// Recreate the per type tables used before version 11
+		std::vector<std::pair<rai::block const *, char const *>> legacy ({ { &send, "send" }, { &change, "change" } });
+		for (auto & i : legacy)
+		{
+			MDB_dbi table;
+			ASSERT_EQ (0, mdb_dbi_open (transaction, i.second, MDB_CREATE, &table));
+			std::vector<uint8_t> vector;
+			{
+				rai::vectorstream stream (vector);
+				i.first->serialize (stream);
+				rai::write (stream, rai::block_hash (0).bytes);
+			}
+			ASSERT_EQ (0, mdb_put (transaction, table, rai::mdb_val (i.first->hash ()), rai::mdb_val (vector.size (), vector.data ()), 0));
+		}
+		store.version_put (transaction, 10);
+	}
+	bool init (false);
+	rai::block_store store (init, path);
+	ASSERT_FALSE (init);
+	rai::transaction transaction (store.environment, nullptr, false);
+	ASSERT_LT (10, store.version_get (transaction));
+	auto send1 (store.block_get (transaction, send.hash ()));
+	ASSERT_NE (nullptr, send1);
+	ASSERT_EQ (send, *send1);
+	auto change1 (store.block_get (transaction, change.hash ()));
+	ASSERT_NE (nullptr, change1);
+	ASSERT_EQ (change, *change1);
+	auto counts (store.block_count (transaction));
+	ASSERT_EQ (1, counts.send);
+	ASSERT_EQ (0, counts.receive);
+	ASSERT_EQ (0, counts.open);
+	ASSERT_EQ (1, counts.change);
+	MDB_dbi table;
+	ASSERT_EQ (MDB_NOTFOUND, mdb_dbi_open (transaction, "send", 0, &table));
+}
+
+TEST (block_store, block_count_by_type)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_FALSE (init);
+	rai::transaction transaction (store.environment, nullptr, true);
+	rai::open_block open (0, 1, 0, rai::keypair ().prv, 0, 0);
+	rai::receive_block receive (open.hash (), 1, rai::keypair ().prv, 3, 4);
+	store.block_put (transaction, open.hash (), open);
+	store.block_put (transaction, receive.hash (), receive);
+	// Rewriting an existing block only changes its successor
+	store.block_successor_clear (transaction, open.hash ());
+	auto counts1 (store.block_count (transaction));
+	ASSERT_EQ (1, counts1.open);
+	ASSERT_EQ (1, counts1.receive);
+	ASSERT_EQ (2, counts1.sum ());
+	ASSERT_FALSE (store.block_exists (transaction, open.hash ().number () + 1));
+	store.block_del (transaction, receive.hash ());
+	auto counts2 (store.block_count (transaction));
+	ASSERT_EQ (0, counts2.receive);
+	ASSERT_EQ (1, counts2.sum ());
+}
+
+TEST (block_store, map_growth)
+{
+	auto path (rai::unique_path ());
+	{
+		bool init (false);
+		rai::block_store store (init, path);
+		ASSERT_FALSE (init);
+	}
+	// Reopening with a map smaller than twice the data grows it to the next whole gigabyte
+	bool init (false);
+	rai::block_store store (init, path, 128, 64 * 1024, 64 * 1024, MDB_NORDAHEAD, 4096);
+	ASSERT_FALSE (init);
+	MDB_envinfo info;
+	ASSERT_EQ (0, mdb_env_info (store.environment, &info));
+	ASSERT_EQ (1024 * 1024 * 1024, info.me_mapsize);
+	rai::transaction transaction (store.environment, nullptr, true);
+	store.unsynced_put (transaction, rai::block_hash (1));
+	ASSERT_TRUE (store.unsynced_exists (transaction, rai::block_hash (1)));
+}
+
+TEST (block_store, block_info_layout)
+{
+	auto path (rai::unique_path ());
+	std::vector<rai::block_hash> hashes;
+	{
+		bool init (false);
+		rai::block_store store (init, path, 128, 64 * 1024, 64 * 1024, 0, 1ULL * 1024 * 1024 * 1024 * 1024, 4);
+		ASSERT_FALSE (init);
+		rai::transaction transaction (store.environment, nullptr, true);
+		rai::genesis genesis;
+		genesis.initialize (transaction, store);
+		rai::ledger ledger (store);
+		rai::keypair key0;
+		hashes.push_back (genesis.hash ());
+		for (auto i (1); i < 10; ++i)
+		{
+			rai::send_block block (hashes.back (), key0.pub, rai::genesis_amount - i, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+			ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, block).code);
+			hashes.push_back (block.hash ());
+		}
+		ASSERT_TRUE (store.block_info_exists (transaction, hashes[3]));
+		ASSERT_TRUE (store.block_info_exists (transaction, hashes[7]));
+		ASSERT_FALSE (store.block_info_exists (transaction, hashes[8]));
+	}
+	bool init (false);
+	rai::block_store store (init, path, 128, 64 * 1024, 64 * 1024, 0, 1ULL * 1024 * 1024 * 1024 * 1024, 3, 9);
+	ASSERT_FALSE (init);
+	rai::transaction transaction (store.environment, nullptr, false);
+	for (size_t i (0); i < hashes.size (); ++i)
+	{
+		auto height (i + 1);
+		ASSERT_EQ (height % 3 == 0 || height >= 9, store.block_info_exists (transaction, hashes[i]));
+	}
+	rai::block_info info;
+	ASSERT_FALSE (store.block_info_get (transaction, hashes[9], info));
+	ASSERT_EQ (rai::test_genesis_key.pub, info.account);
+	ASSERT_EQ (rai::genesis_amount - 9, info.balance.number ());
+	ASSERT_EQ (10, info.height);
+}
+
+TEST (block_store, pending_totals)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_FALSE (init);
+	rai::transaction transaction (store.environment, nullptr, true);
+	rai::account account1 (1);
+	rai::account account2 (2);
+	rai::account account3 (3);
+	store.pending_put (transaction, rai::pending_key (account1, 10), { 0, 100 });
+	store.pending_put (transaction, rai::pending_key (account1, 11), { 0, 50 });
+	store.pending_put (transaction, rai::pending_key (account3, 12), { 0, 7 });
+	auto total1 (store.pending_total_get (transaction, account1));
+	ASSERT_EQ (2, total1.count);
+	ASSERT_EQ (150, total1.amount);
+	ASSERT_EQ (0, store.pending_total_get (transaction, account2).count);
+	store.pending_put (transaction, rai::pending_key (account1, 11), { 0, 60 });
+	ASSERT_EQ (2, store.pending_total_get (transaction, account1).count);
+	ASSERT_EQ (160, store.pending_total_get (transaction, account1).amount);
+	std::vector<rai::pending_key> visited;
+	store.pending_for_each (transaction, { account3, account2, account1 }, [&visited](rai::pending_key const & key_a, rai::pending_info const &) {
+		visited.push_back (key_a);
+		return true;
+	});
+	ASSERT_EQ (3, visited.size ());
+	ASSERT_EQ (rai::pending_key (account1, 10), visited[0]);
+	ASSERT_EQ (rai::pending_key (account1, 11), visited[1]);
+	ASSERT_EQ (rai::pending_key (account3, 12), visited[2]);
+	visited.clear ();
+	store.pending_for_each (transaction, { account1, account3 }, [&visited](rai::pending_key const & key_a, rai::pending_info const &) {
+		visited.push_back (key_a);
+		return false;
+	});
+	ASSERT_EQ (2, visited.size ());
+	ASSERT_EQ (rai::pending_key (account3, 12), visited[1]);
+	store.pending_del (transaction, rai::pending_key (account1, 10));
+	store.pending_del (transaction, rai::pending_key (account1, 11));
+	ASSERT_EQ (0, store.pending_total_get (transaction, account1).count);
+	ASSERT_EQ (0, store.pending_total_get (transaction, account1).amount);
+}
@@ -270,6 +270,33 @@ TEST (ledger, rollback_receiver)
 	ASSERT_TRUE (ledger.store.pending_get (transaction, rai::pending_key (key2.pub, info2.head), pending1));
 }
 
+TEST (ledger, rollback_block_info)
+{
+	bool init (false);
+	// Every height gets a blocks_info record
+	rai::block_store store (init, rai::unique_path (), 128, 64 * 1024, 64 * 1024, 0, 1ULL * 1024 * 1024 * 1024 * 1024, 1);
+	ASSERT_TRUE (!init);
+	rai::ledger ledger (store);
+	rai::transaction transaction (store.environment, nullptr, true);
+	rai::genesis genesis;
+	genesis.initialize (transaction, store);
+	rai::keypair key1;
+	rai::send_block send1 (genesis.hash (), key1.pub, rai::genesis_amount - 100, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, send1).code);
+	rai::open_block open (send1.hash (), key1.pub, key1.pub, key1.prv, key1.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, open).code);
+	rai::change_block change (open.hash (), key1.pub, key1.prv, key1.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, change).code);
+	ASSERT_TRUE (store.block_info_exists (transaction, open.hash ()));
+	ASSERT_TRUE (store.block_info_exists (transaction, change.hash ()));
+	ledger.rollback (transaction, open.hash ());
+	ASSERT_FALSE (store.block_info_exists (transaction, change.hash ()));
+	ASSERT_FALSE (store.block_info_exists (transaction, open.hash ()));
+	ASSERT_TRUE (store.block_info_exists (transaction, send1.hash ()));
+	ledger.rollback (transaction, send1.hash ());
+	ASSERT_FALSE (store.block_info_exists (transaction, send1.hash ()));
+}
+
 TEST (ledger, rollback_representation)
 {
 	bool init (false);
@@ -747,6 +774,31 @@ TEST (votes, add_one)
 	ASSERT_EQ (rai::genesis_amount - 100, winner.first);
 }
 
+TEST (votes, running_tally)
+{
+	rai::keypair rep1;
+	rai::keypair rep2;
+	auto send1 (std::make_shared<rai::send_block> (0, rep1.pub, 1, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0));
+	auto send2 (std::make_shared<rai::send_block> (0, rep2.pub, 1, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0));
+	rai::votes votes (send1);
+	ASSERT_EQ (0, votes.leader ().first);
+	ASSERT_EQ (*send1, *votes.leader ().second);
+	ASSERT_EQ (rai::tally_result::vote, votes.vote (std::make_shared<rai::vote> (rep1.pub, rep1.prv, 1, send2), 10));
+	ASSERT_EQ (10, votes.leader ().first);
+	ASSERT_EQ (*send2, *votes.leader ().second);
+	ASSERT_EQ (rai::tally_result::vote, votes.vote (std::make_shared<rai::vote> (rep2.pub, rep2.prv, 1, send1), 15));
+	ASSERT_EQ (15, votes.leader ().first);
+	ASSERT_EQ (*send1, *votes.leader ().second);
+	// A rep whose weight dropped since its last vote only counts its current weight
+	ASSERT_EQ (rai::tally_result::confirm, votes.vote (std::make_shared<rai::vote> (rep2.pub, rep2.prv, 2, send1), 5));
+	ASSERT_EQ (10, votes.leader ().first);
+	ASSERT_EQ (*send2, *votes.leader ().second);
+	ASSERT_EQ (rai::tally_result::changed, votes.vote (std::make_shared<rai::vote> (rep1.pub, rep1.prv, 2, send1), 10));
+	ASSERT_EQ (15, votes.leader ().first);
+	ASSERT_EQ (*send1, *votes.leader ().second);
+	ASSERT_EQ (0, votes.totals[send2->hash ()].first);
+}
+
 TEST (votes, add_two)
 {
 	rai::system system (24000, 1);
@@ -832,10 +884,12 @@ TEST (votes, add_old)
 	auto votes1 (node1.active.roots.find (send1->root ())->election);
 	auto vote1 (std::make_shared<rai::vote> (rai::test_genesis_key.pub, rai::test_genesis_key.prv, 2, send1));
 	node1.vote_processor.vote (vote1, rai::endpoint ());
+	node1.vote_processor.flush ();
 	rai::keypair key2;
 	auto send2 (std::make_shared<rai::send_block> (genesis.hash (), key2.pub, 0, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0));
 	auto vote2 (std::make_shared<rai::vote> (rai::test_genesis_key.pub, rai::test_genesis_key.prv, 1, send2));
 	node1.vote_processor.vote (vote2, rai::endpoint ());
+	node1.vote_processor.flush ();
 	ASSERT_EQ (2, votes1->votes.rep_votes.size ());
 	ASSERT_NE (votes1->votes.rep_votes.end (), votes1->votes.rep_votes.find (rai::test_genesis_key.pub));
 	ASSERT_EQ (*send1, *votes1->votes.rep_votes[rai::test_genesis_key.pub]);
@@ -1454,3 +1508,117 @@ TEST (ledger, bootstrap_rep_weight)
 		ASSERT_EQ (0, ledger.weight (transaction, key2.pub));
 	}
 }
+
+TEST (ledger_validator, rebuild)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_TRUE (!init);
+	rai::ledger ledger (store);
+	rai::work_pool pool (std::numeric_limits<unsigned>::max (), nullptr);
+	rai::genesis genesis;
+	rai::keypair key1;
+	{
+		rai::transaction transaction (store.environment, nullptr, true);
+		genesis.initialize (transaction, store);
+		rai::send_block send1 (genesis.hash (), key1.pub, rai::genesis_amount - 100, rai::test_genesis_key.prv, rai::test_genesis_key.pub, pool.generate (genesis.hash ()));
+		ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, send1).code);
+		rai::open_block open (send1.hash (), key1.pub, key1.pub, key1.prv, key1.pub, pool.generate (key1.pub));
+		ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, open).code);
+		rai::send_block send2 (send1.hash (), key1.pub, rai::genesis_amount - 150, rai::test_genesis_key.prv, rai::test_genesis_key.pub, pool.generate (send1.hash ()));
+		ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, send2).code);
+		rai::receive_block receive (open.hash (), send2.hash (), key1.prv, key1.pub, pool.generate (open.hash ()));
+		ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, receive).code);
+	}
+	rai::ledger_validator validator (ledger, 3);
+	ASSERT_TRUE (validator.validate ().empty ());
+	ASSERT_EQ (2, validator.accounts);
+	ASSERT_EQ (5, validator.blocks);
+	{
+		rai::transaction transaction (store.environment, nullptr, true);
+		store.representation_put (transaction, key1.pub, 1);
+		rai::account_info info;
+		ASSERT_FALSE (store.account_get (transaction, key1.pub, info));
+		info.block_count = 7;
+		store.account_put (transaction, key1.pub, info);
+	}
+	ASSERT_EQ (2, validator.validate ().size ());
+	ASSERT_TRUE (validator.rebuild ().empty ());
+	ASSERT_TRUE (validator.validate ().empty ());
+	rai::transaction transaction (store.environment, nullptr, false);
+	ASSERT_EQ (150, ledger.weight (transaction, key1.pub));
+	rai::account_info info;
+	ASSERT_FALSE (store.account_get (transaction, key1.pub, info));
+	ASSERT_EQ (2, info.block_count);
+}
+
+TEST (ledger, block_heights)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_TRUE (!init);
+	rai::ledger ledger (store);
+	rai::transaction transaction (store.environment, nullptr, true);
+	rai::genesis genesis;
+	genesis.initialize (transaction, store);
+	rai::keypair key1;
+	rai::send_block send1 (genesis.hash (), key1.pub, rai::genesis_amount - 100, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, send1).code);
+	rai::send_block send2 (send1.hash (), key1.pub, rai::genesis_amount - 200, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, send2).code);
+	rai::open_block open (send1.hash (), key1.pub, key1.pub, key1.prv, key1.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, open).code);
+	rai::account account;
+	uint64_t height;
+	ASSERT_FALSE (store.block_height_get (transaction, send2.hash (), account, height));
+	ASSERT_EQ (rai::test_genesis_key.pub, account);
+	ASSERT_EQ (3, height);
+	ASSERT_FALSE (store.block_height_get (transaction, open.hash (), account, height));
+	ASSERT_EQ (key1.pub, account);
+	ASSERT_EQ (1, height);
+	ASSERT_EQ (genesis.hash (), store.block_at_height (transaction, rai::test_genesis_key.pub, 1));
+	ASSERT_EQ (send1.hash (), store.block_at_height (transaction, rai::test_genesis_key.pub, 2));
+	ASSERT_TRUE (store.block_at_height (transaction, rai::test_genesis_key.pub, 4).is_zero ());
+	auto i (store.chain_begin (transaction, rai::test_genesis_key.pub, 2));
+	ASSERT_NE (store.chain_end (), i);
+	ASSERT_EQ (send1.hash (), rai::block_hash (i->second.uint256 ()));
+	++i;
+	ASSERT_EQ (send2.hash (), rai::block_hash (i->second.uint256 ()));
+	ledger.rollback (transaction, send2.hash ());
+	ASSERT_TRUE (store.block_height_get (transaction, send2.hash (), account, height));
+	ASSERT_TRUE (store.block_at_height (transaction, rai::test_genesis_key.pub, 3).is_zero ());
+	ASSERT_EQ (send1.hash (), store.block_at_height (transaction, rai::test_genesis_key.pub, 2));
+	ASSERT_EQ (rai::test_genesis_key.pub, ledger.account (transaction, send1.hash ()));
+}
+
+TEST (ledger, delegators)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_TRUE (!init);
+	rai::ledger ledger (store);
+	rai::transaction transaction (store.environment, nullptr, true);
+	rai::genesis genesis;
+	genesis.initialize (transaction, store);
+	ASSERT_TRUE (store.delegator_exists (transaction, rai::test_genesis_key.pub, rai::test_genesis_key.pub));
+	rai::keypair key1;
+	rai::keypair key2;
+	rai::send_block send (genesis.hash (), key1.pub, rai::genesis_amount - 100, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, send).code);
+	rai::open_block open (send.hash (), key1.pub, key1.pub, key1.prv, key1.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, open).code);
+	ASSERT_TRUE (store.delegator_exists (transaction, key1.pub, key1.pub));
+	rai::change_block change2 (send.hash (), key2.pub, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, change2).code);
+	ASSERT_FALSE (store.delegator_exists (transaction, rai::test_genesis_key.pub, rai::test_genesis_key.pub));
+	ASSERT_TRUE (store.delegator_exists (transaction, key2.pub, rai::test_genesis_key.pub));
+	auto i (store.delegators_begin (transaction, key2.pub));
+	ASSERT_NE (store.delegators_end (), i);
+	ASSERT_EQ (0, std::memcmp (key2.pub.bytes.data (), i->first.data (), 32));
+	ASSERT_EQ (0, std::memcmp (rai::test_genesis_key.pub.bytes.data (), reinterpret_cast<uint8_t const *> (i->first.data ()) + 32, 32));
+	ledger.rollback (transaction, change2.hash ());
+	ASSERT_FALSE (store.delegator_exists (transaction, key2.pub, rai::test_genesis_key.pub));
+	ASSERT_TRUE (store.delegator_exists (transaction, rai::test_genesis_key.pub, rai::test_genesis_key.pub));
+	ledger.rollback (transaction, open.hash ());
+	ASSERT_FALSE (store.delegator_exists (transaction, key1.pub, key1.pub));
+}
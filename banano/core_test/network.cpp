@@ -46,15 +46,41 @@ TEST (network, construction)
 {
 	rai::system system (24000, 1);
 	ASSERT_EQ (1, system.nodes.size ());
-	ASSERT_EQ (24000, system.nodes[0]->network.socket.local_endpoint ().port ());
+	ASSERT_EQ (24000, system.nodes[0]->network.sockets[0]->socket.local_endpoint ().port ());
+}
+
+TEST (network, multiple_sockets)
+{
+	rai::system system (24000, 1);
+	rai::node_init init1;
+	rai::node_config config1 (24001, system.logging);
+	config1.udp_sockets = 4;
+	auto node1 (std::make_shared<rai::node> (init1, system.service, rai::unique_path (), system.alarm, config1, system.work));
+	ASSERT_FALSE (init1.error ());
+	node1->start ();
+	ASSERT_FALSE (node1->network.sockets.empty ());
+	for (auto & i : node1->network.sockets)
+	{
+		ASSERT_EQ (24001, i->socket.local_endpoint ().port ());
+	}
+	// Every peer sticks to one socket so the counters add up across all of them
+	system.nodes[0]->network.send_keepalive (node1->network.endpoint ());
+	auto iterations (0);
+	while (node1->network.incoming_count (rai::message_type::keepalive) == 0)
+	{
+		system.poll ();
+		++iterations;
+		ASSERT_LT (iterations, 200);
+	}
+	node1->stop ();
 }
 
 TEST (network, self_discard)
 {
 	rai::system system (24000, 1);
-	system.nodes[0]->network.remote = system.nodes[0]->network.endpoint ();
+	system.nodes[0]->network.sockets[0]->remote = system.nodes[0]->network.endpoint ();
 	ASSERT_EQ (0, system.nodes[0]->network.bad_sender_count);
-	system.nodes[0]->network.receive_action (boost::system::error_code{}, 0);
+	system.nodes[0]->network.sockets[0]->receive_action (boost::system::error_code{}, 0);
 	ASSERT_EQ (1, system.nodes[0]->network.bad_sender_count);
 }
 
@@ -67,11 +93,11 @@ TEST (network, send_keepalive)
 	auto node1 (std::make_shared<rai::node> (init1, system.service, 24001, rai::unique_path (), system.alarm, system.logging, system.work));
 	node1->start ();
 	system.nodes[0]->network.send_keepalive (node1->network.endpoint ());
-	auto initial (system.nodes[0]->network.incoming.keepalive.load ());
+	auto initial (system.nodes[0]->network.incoming_count (rai::message_type::keepalive));
 	ASSERT_EQ (0, system.nodes[0]->peers.list ().size ());
 	ASSERT_EQ (0, node1->peers.list ().size ());
 	auto iterations (0);
-	while (system.nodes[0]->network.incoming.keepalive == initial)
+	while (system.nodes[0]->network.incoming_count (rai::message_type::keepalive) == initial)
 	{
 		system.poll ();
 		++iterations;
@@ -95,9 +121,9 @@ TEST (network, keepalive_ipv4)
 	auto node1 (std::make_shared<rai::node> (init1, system.service, 24001, rai::unique_path (), system.alarm, system.logging, system.work));
 	node1->start ();
 	node1->send_keepalive (rai::endpoint (boost::asio::ip::address_v4::loopback (), 24000));
-	auto initial (system.nodes[0]->network.incoming.keepalive.load ());
+	auto initial (system.nodes[0]->network.incoming_count (rai::message_type::keepalive));
 	auto iterations (0);
-	while (system.nodes[0]->network.incoming.keepalive == initial)
+	while (system.nodes[0]->network.incoming_count (rai::message_type::keepalive) == initial)
 	{
 		system.poll ();
 		++iterations;
@@ -154,7 +180,7 @@ TEST (network, send_discarded_publish)
 		ASSERT_EQ (genesis.hash (), system.nodes[1]->latest (rai::test_genesis_key.pub));
 	}
 	auto iterations (0);
-	while (system.nodes[1]->network.incoming.publish == 0)
+	while (system.nodes[1]->network.incoming_count (rai::message_type::publish) == 0)
 	{
 		system.poll ();
 		++iterations;
@@ -177,7 +203,7 @@ TEST (network, send_invalid_publish)
 		ASSERT_EQ (genesis.hash (), system.nodes[1]->latest (rai::test_genesis_key.pub));
 	}
 	auto iterations (0);
-	while (system.nodes[1]->network.incoming.publish == 0)
+	while (system.nodes[1]->network.incoming_count (rai::message_type::publish) == 0)
 	{
 		system.poll ();
 		++iterations;
@@ -222,7 +248,7 @@ TEST (network, send_valid_publish)
 	rai::block_hash latest2 (system.nodes[1]->latest (rai::test_genesis_key.pub));
 	system.nodes[1]->process_active (std::unique_ptr<rai::block> (new rai::send_block (block2)));
 	auto iterations (0);
-	while (system.nodes[0]->network.incoming.publish == 0)
+	while (system.nodes[0]->network.incoming_count (rai::message_type::publish) == 0)
 	{
 		system.poll ();
 		++iterations;
@@ -484,6 +510,117 @@ TEST (bulk_pull, get_next_on_open)
 	ASSERT_EQ (request->current, request->request->end);
 }
 
+TEST (bulk_pull, fill)
+{
+	rai::system system (24000, 1);
+	system.wallet (0)->insert_adhoc (rai::test_genesis_key.prv);
+	rai::keypair key2;
+	ASSERT_NE (nullptr, system.wallet (0)->send_action (rai::test_genesis_key.pub, key2.pub, 100));
+	auto connection (std::make_shared<rai::bootstrap_server> (nullptr, system.nodes[0]));
+	std::unique_ptr<rai::bulk_pull> req (new rai::bulk_pull{});
+	req->start = rai::test_genesis_key.pub;
+	req->end.clear ();
+	connection->requests.push (std::unique_ptr<rai::message>{});
+	auto request (std::make_shared<rai::bulk_pull_server> (connection, std::move (req)));
+	request->fill ();
+	ASSERT_TRUE (request->finished);
+	ASSERT_EQ (1, request->chunks.size ());
+	auto & chunk (request->chunks.front ());
+	rai::bufferstream stream (chunk.data (), chunk.size ());
+	auto block1 (rai::deserialize_block (stream));
+	ASSERT_NE (nullptr, block1);
+	ASSERT_EQ (system.nodes[0]->latest (rai::test_genesis_key.pub), block1->hash ());
+	auto block2 (rai::deserialize_block (stream));
+	ASSERT_NE (nullptr, block2);
+	ASSERT_EQ (rai::genesis ().hash (), block2->hash ());
+	rai::block_type type;
+	ASSERT_FALSE (rai::read (stream, type));
+	ASSERT_EQ (rai::block_type::not_a_block, type);
+	uint8_t junk;
+	ASSERT_TRUE (rai::read (stream, junk));
+}
+
+TEST (bootstrap_client, score)
+{
+	rai::system system (24000, 1);
+	auto attempt (std::make_shared<rai::bootstrap_attempt> (system.nodes[0]));
+	auto client (std::make_shared<rai::bootstrap_client> (system.nodes[0], attempt, rai::tcp_endpoint (boost::asio::ip::address_v6::loopback (), 24000)));
+	ASSERT_EQ (0.0, client->score ());
+	client->block_count = 100;
+	// Idle time only moves the baseline
+	client->sample (client->sampled_time + std::chrono::seconds (1), false);
+	ASSERT_EQ (0.0, client->rate);
+	client->block_count = 200;
+	client->sample (client->sampled_time + std::chrono::seconds (1), true);
+	ASSERT_GT (client->rate, 0.0);
+	auto score (client->score ());
+	ASSERT_EQ (client->rate, score);
+	++client->pulls_completed;
+	++client->pulls_failed;
+	ASSERT_EQ (0.5, client->error_rate ());
+	ASSERT_LT (client->score (), score);
+	client->rtt_sample (std::chrono::seconds (1));
+	ASSERT_EQ (1000000, client->rtt_microseconds);
+	ASSERT_LT (client->score (), score / 2);
+}
+
+TEST (bootstrap_attempt, resume_progress)
+{
+	rai::system system (24000, 1);
+	auto attempt1 (std::make_shared<rai::bootstrap_attempt> (system.nodes[0]));
+	rai::pull_info pull1 (rai::account (7), rai::block_hash (8), rai::block_hash (0));
+	pull1.attempts = 2;
+	attempt1->add_pull (pull1);
+	attempt1->add_pull (rai::pull_info (rai::account (9), rai::block_hash (10), rai::block_hash (0)));
+	{
+		std::lock_guard<std::mutex> lock (attempt1->mutex);
+		attempt1->frontier_cursor = rai::account (5);
+		attempt1->progress_dirty = true;
+		attempt1->record_pull_done (rai::account (9));
+	}
+	attempt1->flush_progress (true);
+	ASSERT_TRUE (attempt1->progress_puts.empty ());
+	auto attempt2 (std::make_shared<rai::bootstrap_attempt> (system.nodes[0]));
+	attempt2->restore ();
+	ASSERT_EQ (rai::account (5), attempt2->frontier_cursor);
+	ASSERT_FALSE (attempt2->frontiers_complete);
+	ASSERT_EQ (1, attempt2->pulls.size ());
+	ASSERT_EQ (pull1.account, attempt2->pulls[0].account);
+	ASSERT_EQ (pull1.head, attempt2->pulls[0].head);
+	ASSERT_EQ (pull1.end, attempt2->pulls[0].end);
+	ASSERT_EQ (2, attempt2->pulls[0].attempts);
+	// Frontiers re-read from the cursor don't schedule a restored account twice
+	attempt2->add_pull (rai::pull_info (pull1.account, rai::block_hash (11), rai::block_hash (0)));
+	ASSERT_EQ (1, attempt2->pulls.size ());
+	ASSERT_EQ (pull1.head, attempt2->pulls[0].head);
+	rai::transaction transaction (system.nodes[0]->store.environment, nullptr, true);
+	system.nodes[0]->store.bootstrap_clear (transaction);
+	ASSERT_EQ (system.nodes[0]->store.bootstrap_end (), system.nodes[0]->store.bootstrap_begin (transaction));
+}
+
+TEST (bootstrap_attempt, pull_done_pending)
+{
+	rai::system system (24000, 1);
+	auto attempt (std::make_shared<rai::bootstrap_attempt> (system.nodes[0]));
+	attempt->add_pull (rai::pull_info (rai::account (7), rai::block_hash (8), rai::block_hash (0)));
+	std::promise<void> processed;
+	{
+		std::lock_guard<std::mutex> lock (attempt->mutex);
+		attempt->record_pull_done (rai::account (7), processed.get_future ().share ());
+	}
+	attempt->flush_progress (true);
+	// Blocks still queued in the processor, the pull stays recorded
+	auto attempt2 (std::make_shared<rai::bootstrap_attempt> (system.nodes[0]));
+	attempt2->restore ();
+	ASSERT_EQ (1, attempt2->pulls.size ());
+	processed.set_value ();
+	attempt->flush_progress (true);
+	ASSERT_TRUE (attempt->progress_pending.empty ());
+	auto attempt3 (std::make_shared<rai::bootstrap_attempt> (system.nodes[0]));
+	attempt3->restore ();
+	ASSERT_TRUE (attempt3->pulls.empty ());
+}
+
 TEST (bootstrap_processor, DISABLED_process_none)
 {
 	rai::system system (24000, 1);
@@ -867,6 +1004,106 @@ TEST (network, ipv6_bind_send_ipv4)
 	});
 }
 
+TEST (network, receive_datagrams)
+{
+	boost::asio::io_service service;
+	rai::endpoint endpoint1 (boost::asio::ip::address_v6::any (), 24000);
+	boost::asio::ip::udp::socket socket1 (service, endpoint1);
+	boost::asio::ip::udp::socket socket2 (service, rai::endpoint (boost::asio::ip::address_v6::any (), 24001));
+	rai::endpoint endpoint2 (boost::asio::ip::address_v6::loopback (), 24000);
+	for (uint8_t i (0); i < 3; ++i)
+	{
+		std::array<uint8_t, 16> bytes;
+		bytes.fill (i);
+		socket2.send_to (boost::asio::buffer (bytes.data (), i + 1), endpoint2);
+	}
+	std::vector<rai::udp_datagram> datagrams (4);
+	boost::system::error_code error;
+	size_t count (0);
+	auto iterations (0);
+	while (count == 0 && !error)
+	{
+		count = rai::receive_datagrams (socket1, datagrams, error);
+		++iterations;
+		ASSERT_LT (iterations, 200);
+	}
+	if (error == boost::asio::error::operation_not_supported)
+	{
+		ASSERT_EQ (0, count);
+	}
+	else
+	{
+		ASSERT_FALSE (error);
+		ASSERT_EQ (3, count);
+		ASSERT_EQ (1, datagrams[0].size);
+		ASSERT_EQ (3, datagrams[2].size);
+		ASSERT_EQ (2, datagrams[2].buffer[0]);
+		ASSERT_EQ (24001, datagrams[0].endpoint.port ());
+		ASSERT_TRUE (datagrams[0].endpoint.address ().is_loopback ());
+	}
+}
+
+TEST (network, send_datagrams)
+{
+	boost::asio::io_service service;
+	boost::asio::ip::udp::socket socket1 (service, rai::endpoint (boost::asio::ip::address_v6::any (), 24000));
+	boost::asio::ip::udp::socket socket2 (service, rai::endpoint (boost::asio::ip::address_v6::any (), 24001));
+	boost::asio::ip::udp::socket socket3 (service, rai::endpoint (boost::asio::ip::address_v6::any (), 24002));
+	std::vector<rai::endpoint> targets;
+	targets.push_back (rai::endpoint (boost::asio::ip::address_v6::loopback (), 24001));
+	targets.push_back (rai::endpoint (boost::asio::ip::address_v6::loopback (), 24002));
+	std::array<uint8_t, 16> bytes;
+	bytes.fill (7);
+	boost::system::error_code error;
+	auto sent (rai::send_datagrams (socket1, bytes.data (), bytes.size (), targets.data (), targets.size (), error));
+	if (error == boost::asio::error::operation_not_supported)
+	{
+		ASSERT_EQ (0, sent);
+	}
+	else
+	{
+		ASSERT_FALSE (error);
+		ASSERT_EQ (2, sent);
+		std::array<uint8_t, 16> received;
+		rai::endpoint sender;
+		ASSERT_EQ (16, socket2.receive_from (boost::asio::buffer (received.data (), received.size ()), sender));
+		ASSERT_EQ (bytes, received);
+		ASSERT_EQ (16, socket3.receive_from (boost::asio::buffer (received.data (), received.size ()), sender));
+		ASSERT_EQ (24000, sender.port ());
+	}
+}
+
+TEST (network, broadcast)
+{
+	rai::system system (24000, 3);
+	rai::keepalive message;
+	auto bytes (std::make_shared<std::vector<uint8_t>> ());
+	{
+		rai::vectorstream stream (*bytes);
+		message.serialize (stream);
+	}
+	auto initial1 (system.nodes[1]->network.incoming_count (rai::message_type::keepalive));
+	auto initial2 (system.nodes[2]->network.incoming_count (rai::message_type::keepalive));
+	auto outgoing (system.nodes[0]->network.outgoing_count (rai::message_type::keepalive));
+	std::vector<rai::endpoint> targets ({ system.nodes[1]->network.endpoint (), system.nodes[2]->network.endpoint () });
+	system.nodes[0]->network.broadcast (bytes, targets, rai::message_type::keepalive);
+	ASSERT_EQ (outgoing + 2, system.nodes[0]->network.outgoing_count (rai::message_type::keepalive));
+	auto iterations (0);
+	while (system.nodes[1]->network.incoming_count (rai::message_type::keepalive) == initial1 || system.nodes[2]->network.incoming_count (rai::message_type::keepalive) == initial2)
+	{
+		system.poll ();
+		++iterations;
+		ASSERT_LT (iterations, 200);
+	}
+	while (system.nodes[0]->network.sockets[0]->batches == 0)
+	{
+		system.poll ();
+		++iterations;
+		ASSERT_LT (iterations, 200);
+	}
+	ASSERT_EQ (0, system.nodes[0]->network.sockets[0]->batch_errors);
+}
+
 TEST (network, endpoint_bad_fd)
 {
 	rai::system system (24000, 1);
@@ -381,7 +381,7 @@ TEST (node, connect_after_junk)
 	rai::node_init init1;
 	auto node1 (std::make_shared<rai::node> (init1, system.service, 24001, rai::unique_path (), system.alarm, system.logging, system.work));
 	uint64_t junk (0);
-	node1->network.socket.async_send_to (boost::asio::buffer (&junk, sizeof (junk)), system.nodes[0]->network.endpoint (), [](boost::system::error_code const &, size_t) {});
+	node1->network.sockets[0]->socket.async_send_to (boost::asio::buffer (&junk, sizeof (junk)), system.nodes[0]->network.endpoint (), [](boost::system::error_code const &, size_t) {});
 	auto iterations1 (0);
 	while (system.nodes[0]->network.error_count == 0)
 	{
@@ -495,6 +495,23 @@ TEST (node_config, serialization)
 	config1.callback_port = 10;
 	config1.callback_target = "test";
 	config1.lmdb_max_dbs = 256;
+	config1.signature_checker_threads = 3;
+	config1.block_processor_capacity = 1024;
+	config1.block_processor_high_water = 512;
+	config1.udp_receive_batch = 8;
+	config1.udp_sockets = 4;
+	config1.block_cache_size = 16;
+	config1.unchecked_cache_size = 32;
+	config1.unchecked_ttl = 60;
+	config1.write_batch_size = 8;
+	config1.write_batch_interval = 5;
+	config1.lmdb_nosync = true;
+	config1.lmdb_writemap = true;
+	config1.lmdb_map_size = 1ULL << 32;
+	config1.lmdb_sync_interval = 7;
+	config1.bootstrap_fast_mode = true;
+	config1.block_info_stride = 8;
+	config1.block_info_dense_threshold = 1000;
 	boost::property_tree::ptree tree;
 	config1.serialize_json (tree);
 	rai::logging logging2;
@@ -510,6 +527,24 @@ TEST (node_config, serialization)
 	ASSERT_NE (config2.callback_address, config1.callback_address);
 	ASSERT_NE (config2.callback_port, config1.callback_port);
 	ASSERT_NE (config2.callback_target, config1.callback_target);
+	ASSERT_NE (config2.signature_checker_threads, config1.signature_checker_threads);
+	ASSERT_NE (config2.block_processor_capacity, config1.block_processor_capacity);
+	ASSERT_NE (config2.block_processor_high_water, config1.block_processor_high_water);
+	ASSERT_NE (config2.udp_receive_batch, config1.udp_receive_batch);
+	ASSERT_NE (config2.udp_sockets, config1.udp_sockets);
+	ASSERT_NE (config2.block_cache_size, config1.block_cache_size);
+	ASSERT_NE (config2.unchecked_cache_size, config1.unchecked_cache_size);
+	ASSERT_NE (config2.unchecked_ttl, config1.unchecked_ttl);
+	ASSERT_NE (config2.write_batch_size, config1.write_batch_size);
+	ASSERT_NE (config2.write_batch_interval, config1.write_batch_interval);
+	ASSERT_NE (config2.lmdb_nosync, config1.lmdb_nosync);
+	ASSERT_NE (config2.lmdb_writemap, config1.lmdb_writemap);
+	ASSERT_NE (config2.lmdb_map_size, config1.lmdb_map_size);
+	ASSERT_NE (config2.lmdb_sync_interval, config1.lmdb_sync_interval);
+	ASSERT_NE (config2.bootstrap_fast_mode, config1.bootstrap_fast_mode);
+	ASSERT_NE (config2.block_info_stride, config1.block_info_stride);
+	ASSERT_NE (config2.block_info_dense_threshold, config1.block_info_dense_threshold);
+	ASSERT_NE (config2.lmdb_flags (), config1.lmdb_flags ());
 
 	bool upgraded (false);
 	config2.deserialize_json (upgraded, tree);
@@ -524,6 +559,26 @@ TEST (node_config, serialization)
 	ASSERT_EQ (config2.callback_port, config1.callback_port);
 	ASSERT_EQ (config2.callback_target, config1.callback_target);
 	ASSERT_EQ (config2.lmdb_max_dbs, config1.lmdb_max_dbs);
+	ASSERT_EQ (config2.signature_checker_threads, config1.signature_checker_threads);
+	ASSERT_EQ (config2.block_processor_capacity, config1.block_processor_capacity);
+	ASSERT_EQ (config2.block_processor_high_water, config1.block_processor_high_water);
+	ASSERT_EQ (config2.udp_receive_batch, config1.udp_receive_batch);
+	ASSERT_EQ (config2.udp_sockets, config1.udp_sockets);
+	ASSERT_EQ (config2.block_cache_size, config1.block_cache_size);
+	ASSERT_EQ (config2.unchecked_cache_size, config1.unchecked_cache_size);
+	ASSERT_EQ (config2.unchecked_ttl, config1.unchecked_ttl);
+	ASSERT_EQ (config2.write_batch_size, config1.write_batch_size);
+	ASSERT_EQ (config2.write_batch_interval, config1.write_batch_interval);
+	ASSERT_EQ (config2.lmdb_nosync, config1.lmdb_nosync);
+	ASSERT_EQ (config2.lmdb_nometasync, config1.lmdb_nometasync);
+	ASSERT_EQ (config2.lmdb_writemap, config1.lmdb_writemap);
+	ASSERT_EQ (config2.lmdb_nordahead, config1.lmdb_nordahead);
+	ASSERT_EQ (config2.lmdb_map_size, config1.lmdb_map_size);
+	ASSERT_EQ (config2.lmdb_sync_interval, config1.lmdb_sync_interval);
+	ASSERT_EQ (config2.bootstrap_fast_mode, config1.bootstrap_fast_mode);
+	ASSERT_EQ (config2.block_info_stride, config1.block_info_stride);
+	ASSERT_EQ (config2.block_info_dense_threshold, config1.block_info_dense_threshold);
+	ASSERT_EQ (config2.lmdb_flags (), config1.lmdb_flags ());
 }
 
 TEST (node_config, v1_v2_upgrade)
@@ -1080,7 +1135,7 @@ TEST (node, fork_no_vote_quorum)
 		confirm.serialize (stream);
 	}
 	node2.network.confirm_send (confirm, bytes, node3.network.endpoint ());
-	while (node3.network.incoming.confirm_ack < 3)
+	while (node3.network.incoming_count (rai::message_type::confirm_ack) < 3)
 	{
 		system.poll ();
 	}
@@ -1353,7 +1408,7 @@ TEST (node, no_voting)
 		++iterations;
 		ASSERT_GT (200, iterations);
 	}
-	ASSERT_EQ (0, node1.network.incoming.confirm_ack);
+	ASSERT_EQ (0, node1.network.incoming_count (rai::message_type::confirm_ack));
 }
 
 TEST (node, start_observer)
@@ -1480,3 +1535,358 @@ TEST (node, bootstrap_connection_scaling)
 	ASSERT_EQ (1, attempt->target_connections (0));
 	ASSERT_EQ (1, attempt->target_connections (50000));
 }
+
+TEST (block_processor, verify_signatures)
+{
+	rai::system system (24000, 1);
+	auto & node1 (*system.nodes[0]);
+	rai::keypair key;
+	rai::genesis genesis;
+	auto send1 (std::make_shared<rai::send_block> (genesis.hash (), key.pub, rai::genesis_amount - 1, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0));
+	auto send2 (std::make_shared<rai::send_block> (send1->hash (), key.pub, rai::genesis_amount - 2, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0));
+	auto send3 (std::make_shared<rai::send_block> (send2->hash (), key.pub, rai::genesis_amount - 3, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0));
+	send3->signature.bytes[32] ^= 0x1;
+	auto open (std::make_shared<rai::open_block> (send1->hash (), key.pub, key.pub, key.prv, key.pub, 0));
+	// Previous block unknown to both the ledger and the batch
+	auto gap (std::make_shared<rai::send_block> (key.pub, key.pub, 0, key.prv, key.pub, 0));
+	std::deque<rai::block_processor_item> blocks;
+	blocks.push_back (rai::block_processor_item (send1));
+	blocks.push_back (rai::block_processor_item (send2));
+	blocks.push_back (rai::block_processor_item (send3));
+	blocks.push_back (rai::block_processor_item (open));
+	blocks.push_back (rai::block_processor_item (gap));
+	node1.block_processor.verify_signatures (blocks);
+	ASSERT_EQ (rai::test_genesis_key.pub, blocks[0].verified);
+	ASSERT_EQ (rai::test_genesis_key.pub, blocks[1].verified);
+	ASSERT_TRUE (blocks[2].verified.is_zero ());
+	ASSERT_EQ (key.pub, blocks[3].verified);
+	ASSERT_TRUE (blocks[4].verified.is_zero ());
+	node1.block_processor.process_receive_many (blocks);
+	rai::transaction transaction (node1.store.environment, nullptr, false);
+	ASSERT_TRUE (node1.store.block_exists (transaction, send2->hash ()));
+	ASSERT_FALSE (node1.store.block_exists (transaction, send3->hash ()));
+	ASSERT_TRUE (node1.store.block_exists (transaction, open->hash ()));
+}
+
+TEST (vote_processor, batch)
+{
+	rai::system system (24000, 1);
+	auto & node1 (*system.nodes[0]);
+	rai::genesis genesis;
+	rai::keypair key1;
+	auto send1 (std::make_shared<rai::send_block> (genesis.hash (), key1.pub, 0, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0));
+	{
+		rai::transaction transaction (node1.store.environment, nullptr, true);
+		ASSERT_EQ (rai::process_result::progress, node1.ledger.process (transaction, *send1).code);
+		node1.active.start (transaction, send1);
+	}
+	auto election (node1.active.roots.find (send1->root ())->election);
+	std::atomic<unsigned> observed (0);
+	node1.observers.vote.add ([&observed](std::shared_ptr<rai::vote>, rai::endpoint const &) {
+		++observed;
+	});
+	rai::keypair key2;
+	auto vote1 (std::make_shared<rai::vote> (rai::test_genesis_key.pub, rai::test_genesis_key.prv, 2, send1));
+	auto vote2 (std::make_shared<rai::vote> (key2.pub, key2.prv, 1, send1));
+	vote2->signature.bytes[32] ^= 0x1;
+	// Replay of an older sequence number
+	auto vote3 (std::make_shared<rai::vote> (rai::test_genesis_key.pub, rai::test_genesis_key.prv, 1, send1));
+	ASSERT_FALSE (node1.vote_processor.vote (vote1, rai::endpoint ()));
+	ASSERT_FALSE (node1.vote_processor.vote (vote2, rai::endpoint ()));
+	ASSERT_FALSE (node1.vote_processor.vote (vote3, rai::endpoint ()));
+	node1.vote_processor.flush ();
+	ASSERT_EQ (1, observed);
+	ASSERT_EQ (2, election->votes.rep_votes.size ());
+	ASSERT_EQ (election->votes.rep_votes.end (), election->votes.rep_votes.find (key2.pub));
+	rai::transaction transaction (node1.store.environment, nullptr, false);
+	std::lock_guard<std::mutex> lock (node1.store.cache_mutex);
+	ASSERT_EQ (2, node1.store.vote_current (transaction, rai::test_genesis_key.pub)->sequence);
+}
+
+TEST (chunk_pool, recycle)
+{
+	rai::chunk_pool pool (64, 2);
+	auto chunk1 (pool.allocate ());
+	auto chunk2 (pool.allocate ());
+	auto chunk3 (pool.allocate ());
+	ASSERT_EQ (3, pool.allocated);
+	ASSERT_EQ (0, pool.recycled);
+	pool.deallocate (chunk1);
+	pool.deallocate (chunk2);
+	// Free list is full, this one goes back to the heap
+	pool.deallocate (chunk3);
+	auto chunk4 (pool.allocate ());
+	ASSERT_EQ (chunk1, chunk4);
+	ASSERT_EQ (1, pool.recycled);
+	pool.deallocate (chunk4);
+}
+
+TEST (chunk_pool, size_classes)
+{
+	ASSERT_EQ (nullptr, rai::chunk_pool_for (0));
+	ASSERT_EQ (64, rai::chunk_pool_for (1)->chunk_size);
+	ASSERT_EQ (64, rai::chunk_pool_for (64)->chunk_size);
+	ASSERT_EQ (128, rai::chunk_pool_for (65)->chunk_size);
+	ASSERT_EQ (512, rai::chunk_pool_for (512)->chunk_size);
+	ASSERT_EQ (nullptr, rai::chunk_pool_for (513));
+	auto recycled ([]() {
+		uint64_t result (0);
+		for (size_t i (64); i <= 512; i += 64)
+		{
+			result += rai::chunk_pool_for (i)->recycled;
+		}
+		return result;
+	});
+	auto block1 (std::allocate_shared<rai::send_block> (rai::pool_allocator<rai::send_block> (), 0, 1, 2, rai::keypair ().prv, 4, 5));
+	block1.reset ();
+	auto recycled1 (recycled ());
+	auto block2 (std::allocate_shared<rai::send_block> (rai::pool_allocator<rai::send_block> (), 0, 1, 2, rai::keypair ().prv, 4, 5));
+	ASSERT_EQ (recycled1 + 1, recycled ());
+}
+
+TEST (mpmc_queue, bounded)
+{
+	rai::mpmc_queue<std::shared_ptr<int>> queue (3);
+	ASSERT_EQ (4, queue.capacity ());
+	ASSERT_TRUE (queue.empty ());
+	for (auto i (0); i < 4; ++i)
+	{
+		ASSERT_FALSE (queue.push (std::make_shared<int> (i)));
+	}
+	ASSERT_TRUE (queue.push (std::make_shared<int> (4)));
+	ASSERT_EQ (4, queue.size ());
+	std::shared_ptr<int> value;
+	ASSERT_FALSE (queue.pop (value));
+	ASSERT_EQ (0, *value);
+	ASSERT_FALSE (queue.push (std::make_shared<int> (4)));
+	for (auto i (1); i < 5; ++i)
+	{
+		ASSERT_FALSE (queue.pop (value));
+		ASSERT_EQ (i, *value);
+	}
+	ASSERT_TRUE (queue.pop (value));
+	ASSERT_TRUE (queue.empty ());
+}
+
+TEST (mpmc_queue, producers_consumers)
+{
+	rai::mpmc_queue<uint64_t> queue (64);
+	std::atomic<uint64_t> sum (0);
+	std::atomic<unsigned> received (0);
+	std::vector<std::thread> threads;
+	for (auto i (0); i < 4; ++i)
+	{
+		threads.push_back (std::thread ([&queue]() {
+			for (uint64_t j (1); j <= 1000; ++j)
+			{
+				while (queue.push (j))
+				{
+					std::this_thread::yield ();
+				}
+			}
+		}));
+		threads.push_back (std::thread ([&queue, &sum, &received]() {
+			uint64_t value;
+			while (received < 4000)
+			{
+				if (!queue.pop (value))
+				{
+					sum += value;
+					++received;
+				}
+			}
+		}));
+	}
+	for (auto & i : threads)
+	{
+		i.join ();
+	}
+	ASSERT_EQ (4 * 500500, sum);
+	ASSERT_TRUE (queue.empty ());
+}
+
+TEST (block_processor, saturated)
+{
+	rai::node_init init;
+	auto service (boost::make_shared<boost::asio::io_service> ());
+	rai::alarm alarm (*service);
+	auto path (rai::unique_path ());
+	rai::node_config config;
+	config.logging.init (path);
+	rai::work_pool work (std::numeric_limits<unsigned>::max (), nullptr);
+	config.block_processor_capacity = 4;
+	config.block_processor_high_water = 2;
+	auto node (std::make_shared<rai::node> (init, *service, path, alarm, config, work));
+	rai::keypair key1;
+	// Blocks with a missing previous only go to unchecked, the queue still has to cycle through all of them
+	for (auto i (0); i < 16; ++i)
+	{
+		auto send (std::make_shared<rai::send_block> (key1.pub, key1.pub, i, key1.prv, key1.pub, 0));
+		ASSERT_FALSE (node->block_processor.add (rai::block_processor_item (send), rai::block_origin::bootstrap));
+	}
+	node->block_processor.flush ();
+	ASSERT_EQ (0, node->block_processor.size ());
+	ASSERT_FALSE (node->block_processor.saturated ());
+	ASSERT_EQ (16, node->block_processor.enqueued);
+	node->stop ();
+}
+
+TEST (block_processor, forced_live)
+{
+	rai::node_init init;
+	auto service (boost::make_shared<boost::asio::io_service> ());
+	rai::alarm alarm (*service);
+	auto path (rai::unique_path ());
+	rai::node_config config;
+	config.logging.init (path);
+	rai::work_pool work (std::numeric_limits<unsigned>::max (), nullptr);
+	config.block_processor_capacity = 4;
+	auto node (std::make_shared<rai::node> (init, *service, path, alarm, config, work));
+	rai::keypair key1;
+	rai::genesis genesis;
+	rai::send_block send0 (genesis.hash (), key1.pub, rai::genesis_amount - 100, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, node->process (send0).code);
+	// Forced fork winners wait for room on a full live lane instead of being dropped
+	std::shared_ptr<rai::block> send;
+	for (auto i (0); i < 16; ++i)
+	{
+		send = std::make_shared<rai::send_block> (genesis.hash (), key1.pub, rai::genesis_amount - i - 1, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+		ASSERT_FALSE (node->block_processor.add (rai::block_processor_item (send, true)));
+	}
+	node->block_processor.flush ();
+	ASSERT_EQ (16, node->block_processor.enqueued);
+	ASSERT_EQ (0, node->block_processor.dropped);
+	{
+		rai::transaction transaction (node->store.environment, nullptr, false);
+		ASSERT_EQ (send->hash (), node->ledger.latest (transaction, rai::test_genesis_key.pub));
+	}
+	node->stop ();
+}
+
+TEST (block_processor, add_batch)
+{
+	rai::system system (24000, 1);
+	auto & node1 (*system.nodes[0]);
+	rai::keypair key;
+	rai::genesis genesis;
+	auto send1 (std::make_shared<rai::send_block> (genesis.hash (), key.pub, rai::genesis_amount - 1, rai::test_genesis_key.prv, rai::test_genesis_key.pub, system.work.generate (genesis.hash ())));
+	auto send2 (std::make_shared<rai::send_block> (send1->hash (), key.pub, rai::genesis_amount - 2, rai::test_genesis_key.prv, rai::test_genesis_key.pub, system.work.generate (send1->hash ())));
+	auto open (std::make_shared<rai::open_block> (send1->hash (), key.pub, key.pub, key.prv, key.pub, system.work.generate (key.pub)));
+	std::vector<rai::block_processor_item> blocks;
+	blocks.push_back (rai::block_processor_item (send1));
+	blocks.push_back (rai::block_processor_item (send2));
+	blocks.push_back (rai::block_processor_item (open));
+	auto enqueued (node1.block_processor.enqueued.load ());
+	ASSERT_EQ (3, node1.block_processor.add (blocks, rai::block_origin::bootstrap));
+	ASSERT_EQ (enqueued + 3, node1.block_processor.enqueued);
+	node1.block_processor.flush ();
+	rai::transaction transaction (node1.store.environment, nullptr, false);
+	ASSERT_TRUE (node1.store.block_exists (transaction, send2->hash ()));
+	ASSERT_TRUE (node1.store.block_exists (transaction, open->hash ()));
+}
+
+TEST (block_processor, lanes)
+{
+	rai::system system (24000, 1);
+	auto & node1 (*system.nodes[0]);
+	rai::keypair key1;
+	rai::genesis genesis;
+	// Fill the bootstrap lane well past a single scheduling round, then queue one live block
+	for (auto i (0); i < 64; ++i)
+	{
+		auto send (std::make_shared<rai::send_block> (key1.pub, key1.pub, i, key1.prv, key1.pub, 0));
+		node1.block_processor.add (rai::block_processor_item (send), rai::block_origin::bootstrap);
+	}
+	auto send1 (std::make_shared<rai::send_block> (genesis.hash (), key1.pub, rai::genesis_amount - 100, rai::test_genesis_key.prv, rai::test_genesis_key.pub, system.work.generate (genesis.hash ())));
+	node1.block_processor.add (rai::block_processor_item (send1));
+	node1.block_processor.flush ();
+	ASSERT_EQ (1, node1.block_processor.lane (rai::block_origin::live).processed);
+	ASSERT_EQ (64, node1.block_processor.lane (rai::block_origin::bootstrap).processed);
+	rai::transaction transaction (node1.store.environment, nullptr, false);
+	ASSERT_TRUE (node1.store.block_exists (transaction, send1->hash ()));
+}
+
+TEST (block_processor, next_batch)
+{
+	rai::system system (24000, 1);
+	auto & node1 (*system.nodes[0]);
+	// Keep the processing thread from draining the lanes
+	node1.block_processor.stop ();
+	node1.block_processor_thread.join ();
+	rai::keypair key1;
+	for (auto i (0); i < 32; ++i)
+	{
+		auto send (std::make_shared<rai::send_block> (key1.pub, key1.pub, i, key1.prv, key1.pub, 0));
+		node1.block_processor.add (rai::block_processor_item (send), rai::block_origin::bootstrap);
+	}
+	auto send1 (std::make_shared<rai::send_block> (key1.pub, key1.pub, 100, key1.prv, key1.pub, 0));
+	node1.block_processor.add (rai::block_processor_item (send1));
+	std::deque<rai::block_processor_item> batch;
+	node1.block_processor.next_batch (batch);
+	ASSERT_EQ (33, batch.size ());
+	// Live blocks are scheduled first in each round
+	ASSERT_EQ (send1, batch.front ().block);
+	ASSERT_EQ (rai::block_origin::live, batch.front ().origin);
+	ASSERT_EQ (rai::block_origin::bootstrap, batch.back ().origin);
+}
+
+TEST (write_scheduler, coalesce)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_FALSE (init);
+	boost::log::sources::logger_mt log;
+	rai::write_scheduler scheduler (store, log, 8, std::chrono::seconds (10));
+	for (auto i (0); i < 12; ++i)
+	{
+		scheduler.submit ([&store, i](MDB_txn * transaction_a) {
+			store.unsynced_put (transaction_a, rai::block_hash (i));
+		});
+	}
+	// Queued writes are still committed after stopping, at most batch size per transaction
+	scheduler.stop ();
+	std::thread thread ([&scheduler]() { scheduler.run (); });
+	thread.join ();
+	ASSERT_EQ (2, scheduler.transactions);
+	ASSERT_EQ (12, scheduler.writes);
+	// Once stopped writes run on the caller's thread
+	scheduler.submit_wait ([&store](MDB_txn * transaction_a) {
+		store.unsynced_put (transaction_a, rai::block_hash (12));
+	});
+	rai::transaction transaction (store.environment, nullptr, false);
+	for (auto i (0); i < 13; ++i)
+	{
+		ASSERT_TRUE (store.unsynced_exists (transaction, rai::block_hash (i)));
+	}
+}
+
+TEST (write_scheduler, zero_interval)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_FALSE (init);
+	boost::log::sources::logger_mt log;
+	rai::write_scheduler scheduler (store, log, 8, std::chrono::milliseconds (0));
+	std::thread thread ([&scheduler]() { scheduler.run (); });
+	// Each transaction still takes one write when the deadline has already passed
+	scheduler.submit_wait ([&store](MDB_txn * transaction_a) {
+		store.unsynced_put (transaction_a, rai::block_hash (1));
+	});
+	// A throwing write is reported to its waiter
+	ASSERT_THROW (scheduler.submit_wait ([](MDB_txn *) {
+		throw std::runtime_error ("write failed");
+	}),
+	std::runtime_error);
+	// Fire and forget writes that throw are logged, later writes still go through
+	scheduler.submit ([](MDB_txn *) {
+		throw std::runtime_error ("write failed");
+	});
+	scheduler.submit_wait ([&store](MDB_txn * transaction_a) {
+		store.unsynced_put (transaction_a, rai::block_hash (2));
+	});
+	scheduler.stop ();
+	thread.join ();
+	rai::transaction transaction (store.environment, nullptr, false);
+	ASSERT_TRUE (store.unsynced_exists (transaction, rai::block_hash (1)));
+	ASSERT_TRUE (store.unsynced_exists (transaction, rai::block_hash (2)));
+}
@@ -45,6 +45,66 @@ TEST (processor_service, bad_receive_signature)
 	ASSERT_EQ (rai::process_result::bad_signature, ledger.process (transaction, receive).code);
 }
 
+TEST (processor_service, verified_other_account)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_FALSE (init);
+	rai::ledger ledger (store);
+	rai::genesis genesis;
+	rai::transaction transaction (store.environment, nullptr, true);
+	genesis.initialize (transaction, store);
+	rai::account_info info1;
+	ASSERT_FALSE (store.account_get (transaction, rai::test_genesis_key.pub, info1));
+	rai::keypair key2;
+	rai::send_block send (info1.head, rai::test_genesis_key.pub, 50, key2.prv, key2.pub, 0);
+	// A signature verified against a different account must not be trusted
+	ASSERT_EQ (rai::process_result::bad_signature, ledger.process (transaction, send, key2.pub).code);
+}
+
+TEST (processor_service, verified_send)
+{
+	bool init (false);
+	rai::block_store store (init, rai::unique_path ());
+	ASSERT_FALSE (init);
+	rai::ledger ledger (store);
+	rai::genesis genesis;
+	rai::transaction transaction (store.environment, nullptr, true);
+	genesis.initialize (transaction, store);
+	rai::account_info info1;
+	ASSERT_FALSE (store.account_get (transaction, rai::test_genesis_key.pub, info1));
+	rai::send_block send (info1.head, rai::test_genesis_key.pub, 50, rai::test_genesis_key.prv, rai::test_genesis_key.pub, 0);
+	ASSERT_EQ (rai::process_result::progress, ledger.process (transaction, send, rai::test_genesis_key.pub).code);
+}
+
+TEST (signature_checker, batch)
+{
+	rai::signature_checker checker (2);
+	std::vector<rai::keypair> keys (1000);
+	std::vector<rai::uint256_union> hashes (keys.size ());
+	std::vector<rai::signature> signatures (keys.size ());
+	std::vector<unsigned char const *> messages;
+	std::vector<size_t> lengths;
+	std::vector<unsigned char const *> pub_keys;
+	std::vector<unsigned char const *> signature_pointers;
+	for (size_t i (0); i < keys.size (); ++i)
+	{
+		hashes[i] = rai::uint256_union (i);
+		signatures[i] = rai::sign_message (keys[i].prv, keys[i].pub, hashes[i]);
+		messages.push_back (hashes[i].bytes.data ());
+		lengths.push_back (sizeof (hashes[i].bytes));
+		pub_keys.push_back (keys[i].pub.bytes.data ());
+		signature_pointers.push_back (signatures[i].bytes.data ());
+	}
+	signatures[500].bytes[32] ^= 0x1;
+	std::vector<int> valid (keys.size (), 0);
+	checker.verify (keys.size (), messages.data (), lengths.data (), pub_keys.data (), signature_pointers.data (), valid.data ());
+	for (size_t i (0); i < keys.size (); ++i)
+	{
+		ASSERT_EQ (i == 500 ? 0 : 1, valid[i]);
+	}
+}
+
 TEST (alarm, one)
 {
 	boost::asio::io_service service;
@@ -2878,6 +2878,79 @@ TEST (rpc, block_count_type)
 	ASSERT_EQ ("0", change_count);
 }
 
+TEST (rpc, block_cache)
+{
+	rai::system system (24000, 1);
+	rai::genesis genesis;
+	rai::rpc rpc (system.service, *system.nodes[0], rai::rpc_config (true));
+	rpc.start ();
+	boost::property_tree::ptree request;
+	request.put ("action", "history");
+	request.put ("hash", genesis.hash ().to_string ());
+	request.put ("count", 1);
+	for (auto i (0); i < 2; ++i)
+	{
+		test_response response (request, rpc, system.service);
+		while (response.status == 0)
+		{
+			system.poll ();
+		}
+		ASSERT_EQ (200, response.status);
+	}
+	boost::property_tree::ptree request1;
+	request1.put ("action", "block_cache");
+	test_response response1 (request1, rpc, system.service);
+	while (response1.status == 0)
+	{
+		system.poll ();
+	}
+	ASSERT_EQ (200, response1.status);
+	ASSERT_NE ("0", response1.json.get<std::string> ("hits"));
+	ASSERT_NE ("0", response1.json.get<std::string> ("size"));
+	ASSERT_EQ (std::to_string (system.nodes[0]->config.block_cache_size), response1.json.get<std::string> ("capacity"));
+}
+
+TEST (rpc, block_processor)
+{
+	rai::system system (24000, 1);
+	system.wallet (0)->insert_adhoc (rai::test_genesis_key.prv);
+	rai::keypair key;
+	auto send (system.wallet (0)->send_action (rai::test_genesis_key.pub, key.pub, system.nodes[0]->config.receive_minimum.number ()));
+	ASSERT_NE (nullptr, send);
+	rai::rpc rpc (system.service, *system.nodes[0], rai::rpc_config (true));
+	rpc.start ();
+	boost::property_tree::ptree request;
+	request.put ("action", "block_processor");
+	test_response response (request, rpc, system.service);
+	while (response.status == 0)
+	{
+		system.poll ();
+	}
+	ASSERT_EQ (200, response.status);
+	auto & lanes (response.json.get_child ("lanes"));
+	ASSERT_EQ ("1", lanes.get<std::string> ("wallet.processed"));
+	ASSERT_EQ ("0", lanes.get<std::string> ("wallet.depth"));
+	ASSERT_EQ ("0", lanes.get<std::string> ("bootstrap.processed"));
+	ASSERT_EQ ("16", lanes.get<std::string> ("live.weight"));
+}
+
+TEST (rpc, bootstrap_status)
+{
+	rai::system system (24000, 1);
+	rai::rpc rpc (system.service, *system.nodes[0], rai::rpc_config (true));
+	rpc.start ();
+	boost::property_tree::ptree request;
+	request.put ("action", "bootstrap_status");
+	test_response response (request, rpc, system.service);
+	while (response.status == 0)
+	{
+		system.poll ();
+	}
+	ASSERT_EQ (200, response.status);
+	ASSERT_EQ ("0", response.json.get<std::string> ("in_progress"));
+	ASSERT_EQ (0, response.json.count ("peers"));
+}
+
 TEST (rpc, ledger)
 {
 	rai::system system (24000, 1);
@@ -1,5 +1,6 @@
 #include <banano/blockstore.hpp>
 #include <banano/ledger.hpp>
+#include <banano/lib/work.hpp>
 #include <banano/node/common.hpp>
 
 namespace
@@ -32,10 +33,11 @@ public:
 		ledger.store.representation_add (transaction, ledger.representative (transaction, hash), pending.amount.number ());
 		ledger.change_latest (transaction, pending.source, block_a.hashables.previous, info.rep_block, ledger.balance (transaction, block_a.hashables.previous), info.block_count - 1);
 		ledger.store.block_del (transaction, hash);
+		ledger.store.block_height_del (transaction, hash);
 		ledger.store.frontier_del (transaction, hash);
 		ledger.store.frontier_put (transaction, block_a.hashables.previous, pending.source);
 		ledger.store.block_successor_clear (transaction, block_a.hashables.previous);
-		if (!(info.block_count % ledger.store.block_info_max))
+		if (ledger.store.block_info_due (info.block_count))
 		{
 			ledger.store.block_info_del (transaction, hash);
 		}
@@ -52,11 +54,12 @@ public:
 		ledger.store.representation_add (transaction, ledger.representative (transaction, hash), 0 - amount);
 		ledger.change_latest (transaction, destination_account, block_a.hashables.previous, representative, ledger.balance (transaction, block_a.hashables.previous), info.block_count - 1);
 		ledger.store.block_del (transaction, hash);
+		ledger.store.block_height_del (transaction, hash);
 		ledger.store.pending_put (transaction, rai::pending_key (destination_account, block_a.hashables.source), { ledger.account (transaction, block_a.hashables.source), amount });
 		ledger.store.frontier_del (transaction, hash);
 		ledger.store.frontier_put (transaction, block_a.hashables.previous, destination_account);
 		ledger.store.block_successor_clear (transaction, block_a.hashables.previous);
-		if (!(info.block_count % ledger.store.block_info_max))
+		if (ledger.store.block_info_due (info.block_count))
 		{
 			ledger.store.block_info_del (transaction, hash);
 		}
@@ -69,8 +72,13 @@ public:
 		ledger.store.representation_add (transaction, ledger.representative (transaction, hash), 0 - amount);
 		ledger.change_latest (transaction, destination_account, 0, 0, 0, 0);
 		ledger.store.block_del (transaction, hash);
+		ledger.store.block_height_del (transaction, hash);
 		ledger.store.pending_put (transaction, rai::pending_key (destination_account, block_a.hashables.source), { ledger.account (transaction, block_a.hashables.source), amount });
 		ledger.store.frontier_del (transaction, hash);
+		if (ledger.store.block_info_due (1))
+		{
+			ledger.store.block_info_del (transaction, hash);
+		}
 	}
 	void change_block (rai::change_block const & block_a) override
 	{
@@ -83,12 +91,14 @@ public:
 		auto balance (ledger.balance (transaction, block_a.hashables.previous));
 		ledger.store.representation_add (transaction, representative, balance);
 		ledger.store.representation_add (transaction, hash, 0 - balance);
-		ledger.store.block_del (transaction, hash);
+		// The delegator index looks up the rep block being rolled back so it's deleted afterwards
 		ledger.change_latest (transaction, account, block_a.hashables.previous, representative, info.balance, info.block_count - 1);
+		ledger.store.block_del (transaction, hash);
+		ledger.store.block_height_del (transaction, hash);
 		ledger.store.frontier_del (transaction, hash);
 		ledger.store.frontier_put (transaction, block_a.hashables.previous, account);
 		ledger.store.block_successor_clear (transaction, block_a.hashables.previous);
-		if (!(info.block_count % ledger.store.block_info_max))
+		if (ledger.store.block_info_due (info.block_count))
 		{
 			ledger.store.block_info_del (transaction, hash);
 		}
@@ -100,17 +110,26 @@ public:
 class ledger_processor : public rai::block_visitor
 {
 public:
-	ledger_processor (rai::ledger &, MDB_txn *);
+	ledger_processor (rai::ledger &, MDB_txn *, rai::account const &);
 	virtual ~ledger_processor () = default;
 	void send_block (rai::send_block const &) override;
 	void receive_block (rai::receive_block const &) override;
 	void open_block (rai::open_block const &) override;
 	void change_block (rai::change_block const &) override;
+	bool validate_signature (rai::account const &, rai::block_hash const &, rai::signature const &);
 	rai::ledger & ledger;
 	MDB_txn * transaction;
+	rai::account verified;
 	rai::process_return result;
 };
 
+// A batch verified signature is only trusted if it was checked against the account the ledger resolved
+bool ledger_processor::validate_signature (rai::account const & account_a, rai::block_hash const & hash_a, rai::signature const & signature_a)
+{
+	auto result (verified.is_zero () || verified != account_a ? rai::validate_message (account_a, hash_a, signature_a) : false);
+	return result;
+}
+
 void ledger_processor::change_block (rai::change_block const & block_a)
 {
 	auto hash (block_a.hash ());
@@ -130,7 +149,7 @@ void ledger_processor::change_block (rai::change_block const & block_a)
 				auto latest_error (ledger.store.account_get (transaction, account, info));
 				assert (!latest_error);
 				assert (info.head == block_a.hashables.previous);
-				result.code = validate_message (account, hash, block_a.signature) ? rai::process_result::bad_signature : rai::process_result::progress; // Is this block signed correctly (Malformed)
+				result.code = validate_signature (account, hash, block_a.signature) ? rai::process_result::bad_signature : rai::process_result::progress; // Is this block signed correctly (Malformed)
 				if (result.code == rai::process_result::progress)
 				{
 					ledger.store.block_put (transaction, hash, block_a);
@@ -163,7 +182,7 @@ void ledger_processor::send_block (rai::send_block const & block_a)
 			result.code = account.is_zero () ? rai::process_result::fork : rai::process_result::progress;
 			if (result.code == rai::process_result::progress)
 			{
-				result.code = validate_message (account, hash, block_a.signature) ? rai::process_result::bad_signature : rai::process_result::progress; // Is this block signed correctly (Malformed)
+				result.code = validate_signature (account, hash, block_a.signature) ? rai::process_result::bad_signature : rai::process_result::progress; // Is this block signed correctly (Malformed)
 				if (result.code == rai::process_result::progress)
 				{
 					rai::account_info info;
@@ -204,7 +223,7 @@ void ledger_processor::receive_block (rai::receive_block const & block_a)
 			result.code = account.is_zero () ? rai::process_result::gap_previous : rai::process_result::progress; //Have we seen the previous block? No entries for account at all (Harmless)
 			if (result.code == rai::process_result::progress)
 			{
-				result.code = rai::validate_message (account, hash, block_a.signature) ? rai::process_result::bad_signature : rai::process_result::progress; // Is the signature valid (Malformed)
+				result.code = validate_signature (account, hash, block_a.signature) ? rai::process_result::bad_signature : rai::process_result::progress; // Is the signature valid (Malformed)
 				if (result.code == rai::process_result::progress)
 				{
 					rai::account_info info;
@@ -252,7 +271,7 @@ void ledger_processor::open_block (rai::open_block const & block_a)
 		result.code = source_missing ? rai::process_result::gap_source : rai::process_result::progress; // Have we seen the source block? (Harmless)
 		if (result.code == rai::process_result::progress)
 		{
-			result.code = rai::validate_message (block_a.hashables.account, hash, block_a.signature) ? rai::process_result::bad_signature : rai::process_result::progress; // Is the signature valid (Malformed)
+			result.code = validate_signature (block_a.hashables.account, hash, block_a.signature) ? rai::process_result::bad_signature : rai::process_result::progress; // Is the signature valid (Malformed)
 			if (result.code == rai::process_result::progress)
 			{
 				rai::account_info info;
@@ -285,9 +304,10 @@ void ledger_processor::open_block (rai::open_block const & block_a)
 	}
 }
 
-ledger_processor::ledger_processor (rai::ledger & ledger_a, MDB_txn * transaction_a) :
+ledger_processor::ledger_processor (rai::ledger & ledger_a, MDB_txn * transaction_a, rai::account const & verified_a) :
 ledger (ledger_a),
-transaction (transaction_a)
+transaction (transaction_a),
+verified (verified_a)
 {
 }
 } // namespace
@@ -367,19 +387,12 @@ rai::uint128_t rai::ledger::account_balance (MDB_txn * transaction_a, rai::accou
 
 rai::uint128_t rai::ledger::account_pending (MDB_txn * transaction_a, rai::account const & account_a)
 {
-	rai::uint128_t result (0);
-	rai::account end (account_a.number () + 1);
-	for (auto i (store.pending_begin (transaction_a, rai::pending_key (account_a, 0))), n (store.pending_begin (transaction_a, rai::pending_key (end, 0))); i != n; ++i)
-	{
-		rai::pending_info info (i->second);
-		result += info.amount.number ();
-	}
-	return result;
+	return store.pending_total_get (transaction_a, account_a).amount;
 }
 
-rai::process_return rai::ledger::process (MDB_txn * transaction_a, rai::block const & block_a)
+rai::process_return rai::ledger::process (MDB_txn * transaction_a, rai::block const & block_a, rai::account const & verified_a)
 {
-	ledger_processor processor (*this, transaction_a);
+	ledger_processor processor (*this, transaction_a, verified_a);
 	block_a.visit (processor);
 	return processor.result;
 }
@@ -474,25 +487,30 @@ void rai::ledger::rollback (MDB_txn * transaction_a, rai::block_hash const & blo
 rai::account rai::ledger::account (MDB_txn * transaction_a, rai::block_hash const & hash_a)
 {
 	assert (store.block_exists (transaction_a, hash_a));
-	auto hash (hash_a);
-	rai::block_hash successor (1);
-	rai::block_info block_info;
-	while (!successor.is_zero () && store.block_info_get (transaction_a, successor, block_info))
+	rai::account result;
+	uint64_t height;
+	if (store.block_height_get (transaction_a, hash_a, result, height))
 	{
-		successor = store.block_successor (transaction_a, hash);
-		if (!successor.is_zero ())
+		// Not indexed, walk forward to a blocks_info record or the head
+		auto hash (hash_a);
+		rai::block_hash successor (1);
+		rai::block_info block_info;
+		while (!successor.is_zero () && store.block_info_get (transaction_a, successor, block_info))
 		{
-			hash = successor;
+			successor = store.block_successor (transaction_a, hash);
+			if (!successor.is_zero ())
+			{
+				hash = successor;
+			}
+		}
+		if (successor.is_zero ())
+		{
+			result = store.frontier_get (transaction_a, hash);
+		}
+		else
+		{
+			result = block_info.account;
 		}
-	}
-	rai::account result;
-	if (successor.is_zero ())
-	{
-		result = store.frontier_get (transaction_a, hash);
-	}
-	else
-	{
-		result = block_info.account;
 	}
 	assert (!result.is_zero ());
 	return result;
@@ -574,6 +592,18 @@ void rai::ledger::change_latest (MDB_txn * transaction_a, rai::account const & a
 		assert (dynamic_cast<rai::open_block *> (store.block_get (transaction_a, hash_a).get ()) != nullptr);
 		info.open_block = hash_a;
 	}
+	if (exists && info.rep_block != rep_block_a)
+	{
+		auto block (store.block_get (transaction_a, info.rep_block));
+		assert (block != nullptr);
+		store.delegator_del (transaction_a, block->representative (), account_a);
+	}
+	if (!hash_a.is_zero () && (!exists || info.rep_block != rep_block_a))
+	{
+		auto block (store.block_get (transaction_a, rep_block_a));
+		assert (block != nullptr);
+		store.delegator_put (transaction_a, block->representative (), account_a);
+	}
 	if (!hash_a.is_zero ())
 	{
 		info.head = hash_a;
@@ -582,11 +612,13 @@ void rai::ledger::change_latest (MDB_txn * transaction_a, rai::account const & a
 		info.modified = rai::seconds_since_epoch ();
 		info.block_count = block_count_a;
 		store.account_put (transaction_a, account_a, info);
-		if (!(block_count_a % store.block_info_max))
+		store.block_height_put (transaction_a, hash_a, account_a, block_count_a);
+		if (store.block_info_due (block_count_a))
 		{
 			rai::block_info block_info;
 			block_info.account = account_a;
 			block_info.balance = balance_a;
+			block_info.height = block_count_a;
 			store.block_info_put (transaction_a, hash_a, block_info);
 		}
 		checksum_update (transaction_a, hash_a);
@@ -597,7 +629,7 @@ void rai::ledger::change_latest (MDB_txn * transaction_a, rai::account const & a
 	}
 }
 
-std::unique_ptr<rai::block> rai::ledger::successor (MDB_txn * transaction_a, rai::block_hash const & block_a)
+std::shared_ptr<rai::block const> rai::ledger::successor (MDB_txn * transaction_a, rai::block_hash const & block_a)
 {
 	assert (store.account_exists (transaction_a, block_a) || store.block_exists (transaction_a, block_a));
 	assert (store.account_exists (transaction_a, block_a) || latest (transaction_a, account (transaction_a, block_a)) != block_a);
@@ -614,7 +646,7 @@ std::unique_ptr<rai::block> rai::ledger::successor (MDB_txn * transaction_a, rai
 		successor = store.block_successor (transaction_a, block_a);
 	}
 	assert (!successor.is_zero ());
-	auto result (store.block_get (transaction_a, successor));
+	auto result (store.block_get_cached (transaction_a, successor));
 	assert (result != nullptr);
 	return result;
 }
@@ -635,3 +667,412 @@ std::unique_ptr<rai::block> rai::ledger::forked_block (MDB_txn * transaction_a,
 	}
 	return result;
 }
+
+rai::ledger_validator::ledger_validator (rai::ledger & ledger_a, unsigned threads_a) :
+accounts (0),
+blocks (0),
+ledger (ledger_a),
+threads (std::max<unsigned> (1, threads_a))
+{
+}
+
+std::vector<std::string> rai::ledger_validator::validate ()
+{
+	auto ranges (walk (false));
+	std::vector<std::string> result;
+	std::unordered_map<rai::account, rai::uint128_t> weights;
+	rai::checksum checksum (0);
+	uint64_t accounts_l (0);
+	for (auto & i : ranges)
+	{
+		result.insert (result.end (), i.errors.begin (), i.errors.end ());
+		result.insert (result.end (), i.mismatches.begin (), i.mismatches.end ());
+		// Each broken chain reports exactly one error
+		accounts_l += i.accounts.size () + i.errors.size ();
+		for (auto & j : i.weights)
+		{
+			weights[j.first] += j.second;
+		}
+		checksum ^= i.checksum;
+	}
+	rai::transaction transaction (ledger.store.environment, nullptr, false);
+	for (auto i (ledger.store.representation_begin (transaction)), n (ledger.store.representation_end ()); i != n; ++i)
+	{
+		rai::account representative (i->first.uint256 ());
+		auto stored (ledger.store.representation_get (transaction, representative));
+		auto existing (weights.find (representative));
+		auto computed (existing != weights.end () ? existing->second : rai::uint128_t (0));
+		if (stored != computed)
+		{
+			result.push_back (boost::str (boost::format ("Representative %1% has weight %2% but its delegators hold %3%") % representative.to_account () % stored.convert_to<std::string> () % computed.convert_to<std::string> ()));
+		}
+		weights.erase (representative);
+	}
+	for (auto & i : weights)
+	{
+		if (!i.second.is_zero ())
+		{
+			result.push_back (boost::str (boost::format ("Representative %1% is missing weight %2%") % i.first.to_account () % i.second.convert_to<std::string> ()));
+		}
+	}
+	uint64_t delegators (0);
+	for (auto i (ledger.store.delegators_begin (transaction)), n (ledger.store.delegators_end ()); i != n; ++i)
+	{
+		++delegators;
+	}
+	if (delegators != accounts_l)
+	{
+		result.push_back (boost::str (boost::format ("Delegator index has %1% entries for %2% accounts") % delegators % accounts_l));
+	}
+	rai::checksum stored_checksum;
+	if (ledger.store.checksum_get (transaction, 0, 0, stored_checksum) || stored_checksum != checksum)
+	{
+		result.push_back ("Checksum doesn't match account heads");
+	}
+	std::unordered_map<rai::account, rai::pending_total> totals;
+	for (auto i (ledger.store.pending_begin (transaction)), n (ledger.store.pending_end ()); i != n; ++i)
+	{
+		rai::pending_key key (i->first);
+		rai::pending_info info (i->second);
+		auto & total (totals[key.account]);
+		++total.count;
+		total.amount += info.amount.number ();
+		auto block (ledger.store.block_get (transaction, key.hash));
+		rai::uint128_t amount;
+		if (block == nullptr || block->type () != rai::block_type::send || static_cast<rai::send_block const &> (*block).hashables.destination != key.account)
+		{
+			result.push_back (boost::str (boost::format ("Pending entry for %1% refers to %2% which isn't a send to it") % key.account.to_account () % key.hash.to_string ()));
+		}
+		else if (send_amount (transaction, key.hash, amount) || amount != info.amount.number ())
+		{
+			result.push_back (boost::str (boost::format ("Pending amount of %1% doesn't match the send") % key.hash.to_string ()));
+		}
+	}
+	for (auto i (ledger.store.pending_totals_begin (transaction)), n (ledger.store.pending_totals_end ()); i != n; ++i)
+	{
+		rai::account account (i->first.uint256 ());
+		auto stored (ledger.store.pending_total_get (transaction, account));
+		auto existing (totals.find (account));
+		if (existing == totals.end () || existing->second.count != stored.count || existing->second.amount != stored.amount)
+		{
+			result.push_back (boost::str (boost::format ("Pending total of %1% doesn't match its entries") % account.to_account ()));
+		}
+		totals.erase (account);
+	}
+	for (auto & i : totals)
+	{
+		result.push_back (boost::str (boost::format ("Pending total of %1% is missing") % i.first.to_account ()));
+	}
+	return result;
+}
+
+std::vector<std::string> rai::ledger_validator::rebuild ()
+{
+	auto ranges (walk (true));
+	std::vector<std::string> result;
+	for (auto & i : ranges)
+	{
+		result.insert (result.end (), i.errors.begin (), i.errors.end ());
+	}
+	if (result.empty ())
+	{
+		rai::transaction transaction (ledger.store.environment, nullptr, true);
+		std::unordered_map<rai::account, rai::pending_total> totals;
+		for (auto i (ledger.store.pending_begin (transaction)), n (ledger.store.pending_end ()); i != n; ++i)
+		{
+			rai::pending_key key (i->first);
+			rai::pending_info info (i->second);
+			auto & total (totals[key.account]);
+			++total.count;
+			total.amount += info.amount.number ();
+		}
+		ledger.store.clear (transaction, ledger.store.representation);
+		ledger.store.clear (transaction, ledger.store.blocks_info);
+		ledger.store.clear (transaction, ledger.store.block_heights);
+		ledger.store.clear (transaction, ledger.store.chain_heights);
+		ledger.store.clear (transaction, ledger.store.delegators);
+		ledger.store.clear (transaction, ledger.store.pending_totals);
+		std::unordered_map<rai::account, rai::uint128_t> weights;
+		rai::checksum checksum (0);
+		for (auto & i : ranges)
+		{
+			for (auto & j : i.blocks_info)
+			{
+				ledger.store.block_info_put (transaction, j.first, j.second);
+			}
+			// Heights come from the chains recorded by the walk rather than following successors again under the write lock
+			auto chain (i.chains.begin ());
+			for (auto & j : i.accounts)
+			{
+				ledger.store.account_put (transaction, j.first, j.second);
+				auto representative (ledger.store.block_get (transaction, j.second.rep_block));
+				assert (representative != nullptr);
+				ledger.store.delegator_put (transaction, representative->representative (), j.first);
+				for (uint64_t height (1); height <= j.second.block_count; ++height, ++chain)
+				{
+					assert (chain != i.chains.end ());
+					ledger.store.block_height_put (transaction, *chain, j.first, height);
+				}
+			}
+			assert (chain == i.chains.end ());
+			for (auto & j : i.weights)
+			{
+				weights[j.first] += j.second;
+			}
+			checksum ^= i.checksum;
+		}
+		for (auto & i : weights)
+		{
+			ledger.store.representation_put (transaction, i.first, i.second);
+		}
+		for (auto & i : totals)
+		{
+			ledger.store.pending_total_add (transaction, i.first, i.second.count, i.second.amount);
+		}
+		ledger.store.checksum_put (transaction, 0, 0, checksum);
+	}
+	return result;
+}
+
+std::vector<rai::ledger_validator::range> rai::ledger_validator::walk (bool chains_a)
+{
+	std::vector<range> result (threads);
+	for (auto & i : result)
+	{
+		i.record_chains = chains_a;
+	}
+	std::vector<std::thread> workers;
+	rai::uint256_t step (std::numeric_limits<rai::uint256_t>::max () / threads);
+	for (unsigned i (0); i < threads; ++i)
+	{
+		rai::account begin (step * i);
+		rai::account end (step * (i + 1));
+		auto last (i + 1 == threads);
+		workers.push_back (std::thread ([this, begin, end, last, &result, i]() {
+			walk_range (begin, end, last, result[i]);
+		}));
+	}
+	for (auto & i : workers)
+	{
+		i.join ();
+	}
+	return result;
+}
+
+void rai::ledger_validator::walk_range (rai::account const & begin_a, rai::account const & end_a, bool last_a, range & range_a)
+{
+	range_a.checksum = 0;
+	rai::transaction transaction (ledger.store.environment, nullptr, false);
+	for (auto i (ledger.store.latest_begin (transaction, begin_a)), n (ledger.store.latest_end ()); i != n && (last_a || rai::account (i->first.uint256 ()) < end_a); ++i)
+	{
+		walk_account (transaction, i->first.uint256 (), rai::account_info (i->second), range_a);
+		++accounts;
+	}
+}
+
+void rai::ledger_validator::walk_account (MDB_txn * transaction_a, rai::account const & account_a, rai::account_info const & info_a, range & range_a)
+{
+	auto & store (ledger.store);
+	auto hash (info_a.open_block);
+	rai::block_hash previous (0);
+	rai::uint128_t balance (0);
+	rai::account representative (0);
+	rai::block_hash rep_block (0);
+	uint64_t count (0);
+	std::string error;
+	auto chain_begin (range_a.chains.size ());
+	while (!hash.is_zero () && error.empty ())
+	{
+		auto block (store.block_get (transaction_a, hash));
+		if (block == nullptr)
+		{
+			error = boost::str (boost::format ("Block %1% is missing") % hash.to_string ());
+		}
+		else if (block->previous () != previous)
+		{
+			error = boost::str (boost::format ("Block %1% doesn't follow %2%") % hash.to_string () % previous.to_string ());
+		}
+		else if (rai::validate_message (account_a, hash, block->block_signature ()))
+		{
+			error = boost::str (boost::format ("Block %1% has a bad signature") % hash.to_string ());
+		}
+		else if (rai::work_validate (*block))
+		{
+			error = boost::str (boost::format ("Block %1% has insufficient work") % hash.to_string ());
+		}
+		else
+		{
+			rai::uint128_t amount (0);
+			switch (block->type ())
+			{
+				case rai::block_type::send:
+				{
+					auto const & send (static_cast<rai::send_block const &> (*block));
+					if (send.hashables.balance.number () > balance)
+					{
+						error = boost::str (boost::format ("Send %1% increases the balance") % hash.to_string ());
+					}
+					balance = send.hashables.balance.number ();
+					break;
+				}
+				case rai::block_type::receive:
+				{
+					if (send_amount (transaction_a, static_cast<rai::receive_block const &> (*block).hashables.source, amount))
+					{
+						error = boost::str (boost::format ("Receive %1% has no valid source") % hash.to_string ());
+					}
+					balance += amount;
+					break;
+				}
+				case rai::block_type::open:
+				{
+					auto const & open (static_cast<rai::open_block const &> (*block));
+					if (open.hashables.account != account_a)
+					{
+						error = boost::str (boost::format ("Open %1% belongs to another account") % hash.to_string ());
+					}
+					else if (open.hashables.source == rai::genesis_account)
+					{
+						amount = rai::genesis_amount;
+					}
+					else if (send_amount (transaction_a, open.hashables.source, amount))
+					{
+						error = boost::str (boost::format ("Open %1% has no valid source") % hash.to_string ());
+					}
+					balance = amount;
+					representative = open.hashables.representative;
+					rep_block = hash;
+					break;
+				}
+				case rai::block_type::change:
+				{
+					representative = static_cast<rai::change_block const &> (*block).hashables.representative;
+					rep_block = hash;
+					break;
+				}
+				default:
+					error = boost::str (boost::format ("Block %1% has an unknown type") % hash.to_string ());
+					break;
+			}
+			++count;
+			++blocks;
+			if (store.block_info_due (count))
+			{
+				rai::block_info expected (account_a, balance, count);
+				rai::block_info stored;
+				if (store.block_info_get (transaction_a, hash, stored) || !(stored == expected))
+				{
+					range_a.mismatches.push_back (boost::str (boost::format ("Block info of %1% is missing or wrong") % hash.to_string ()));
+				}
+				range_a.blocks_info.push_back (std::make_pair (hash, expected));
+			}
+			rai::account height_account;
+			uint64_t height;
+			if (store.block_height_get (transaction_a, hash, height_account, height) || height_account != account_a || height != count || store.block_at_height (transaction_a, account_a, count) != hash)
+			{
+				range_a.mismatches.push_back (boost::str (boost::format ("Height of %1% is missing or wrong") % hash.to_string ()));
+			}
+			if (range_a.record_chains)
+			{
+				range_a.chains.push_back (hash);
+			}
+			previous = hash;
+			hash = store.block_successor (transaction_a, hash);
+		}
+	}
+	if (error.empty () && previous != info_a.head)
+	{
+		error = boost::str (boost::format ("Chain ends at %1% instead of the head %2%") % previous.to_string () % info_a.head.to_string ());
+	}
+	if (error.empty ())
+	{
+		if (info_a.block_count != count || info_a.balance.number () != balance || info_a.rep_block != rep_block)
+		{
+			range_a.mismatches.push_back (boost::str (boost::format ("Account info of %1% doesn't match its chain") % account_a.to_account ()));
+		}
+		if (store.frontier_get (transaction_a, info_a.head) != account_a)
+		{
+			range_a.mismatches.push_back (boost::str (boost::format ("Frontier of %1% is missing") % account_a.to_account ()));
+		}
+		if (!store.delegator_exists (transaction_a, representative, account_a))
+		{
+			range_a.mismatches.push_back (boost::str (boost::format ("Delegation of %1% to %2% isn't indexed") % account_a.to_account () % representative.to_account ()));
+		}
+		range_a.accounts.push_back (std::make_pair (account_a, rai::account_info (info_a.head, rep_block, info_a.open_block, balance, info_a.modified, count)));
+		range_a.weights[representative] += balance;
+		range_a.checksum ^= info_a.head;
+	}
+	else
+	{
+		range_a.errors.push_back (boost::str (boost::format ("Account %1%: %2%") % account_a.to_account () % error));
+		range_a.chains.resize (chain_begin);
+	}
+}
+
+bool rai::ledger_validator::chain_balance (MDB_txn * transaction_a, rai::block_hash const & hash_a, rai::uint128_t & balance_a)
+{
+	auto error (false);
+	auto done (false);
+	auto current (hash_a);
+	balance_a = 0;
+	while (!done && !error)
+	{
+		auto block (ledger.store.block_get (transaction_a, current));
+		rai::uint128_t amount (0);
+		if (block == nullptr)
+		{
+			error = true;
+		}
+		else
+		{
+			switch (block->type ())
+			{
+				case rai::block_type::send:
+					balance_a += static_cast<rai::send_block const &> (*block).hashables.balance.number ();
+					done = true;
+					break;
+				case rai::block_type::receive:
+					error = send_amount (transaction_a, static_cast<rai::receive_block const &> (*block).hashables.source, amount);
+					balance_a += amount;
+					current = block->previous ();
+					break;
+				case rai::block_type::open:
+				{
+					auto const & open (static_cast<rai::open_block const &> (*block));
+					if (open.hashables.source == rai::genesis_account)
+					{
+						amount = rai::genesis_amount;
+					}
+					else
+					{
+						error = send_amount (transaction_a, open.hashables.source, amount);
+					}
+					balance_a += amount;
+					done = true;
+					break;
+				}
+				case rai::block_type::change:
+					current = block->previous ();
+					break;
+				default:
+					error = true;
+					break;
+			}
+		}
+	}
+	return error;
+}
+
+bool rai::ledger_validator::send_amount (MDB_txn * transaction_a, rai::block_hash const & hash_a, rai::uint128_t & amount_a)
+{
+	auto error (true);
+	auto block (ledger.store.block_get (transaction_a, hash_a));
+	if (block != nullptr && block->type () == rai::block_type::send)
+	{
+		auto const & send (static_cast<rai::send_block const &> (*block));
+		rai::uint128_t previous;
+		error = chain_balance (transaction_a, send.hashables.previous, previous) || previous < send.hashables.balance.number ();
+		amount_a = error ? 0 : previous - send.hashables.balance.number ();
+	}
+	return error;
+}
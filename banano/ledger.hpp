@@ -26,7 +26,7 @@ public:
 	rai::uint128_t account_balance (MDB_txn *, rai::account const &);
 	rai::uint128_t account_pending (MDB_txn *, rai::account const &);
 	rai::uint128_t weight (MDB_txn *, rai::account const &);
-	std::unique_ptr<rai::block> successor (MDB_txn *, rai::block_hash const &);
+	std::shared_ptr<rai::block const> successor (MDB_txn *, rai::block_hash const &);
 	std::unique_ptr<rai::block> forked_block (MDB_txn *, rai::block const &);
 	rai::block_hash latest (MDB_txn *, rai::account const &);
 	rai::block_hash latest_root (MDB_txn *, rai::account const &);
@@ -36,7 +36,8 @@ public:
 	std::string block_text (char const *);
 	std::string block_text (rai::block_hash const &);
 	rai::uint128_t supply (MDB_txn *);
-	rai::process_return process (MDB_txn *, rai::block const &);
+	// Signature checks are skipped when the block was already verified against the signing account, zero if not verified
+	rai::process_return process (MDB_txn *, rai::block const &, rai::account const & = rai::account (0));
 	void rollback (MDB_txn *, rai::block_hash const &);
 	void change_latest (MDB_txn *, rai::account const &, rai::block_hash const &, rai::account const &, rai::uint128_union const &, uint64_t);
 	void checksum_update (MDB_txn *, rai::block_hash const &);
@@ -49,4 +50,48 @@ public:
 	uint64_t bootstrap_weight_max_blocks;
 	std::atomic<bool> check_bootstrap_weights;
 };
+
+/**
+ * Offline check of the ledger against its block chains, which can also rebuild the tables derived from them
+ * The account table is split into ranges walked in parallel, each thread reading through its own transaction
+ */
+class ledger_validator
+{
+public:
+	ledger_validator (rai::ledger &, unsigned);
+	// Describes every inconsistency found, empty when the ledger is sound
+	std::vector<std::string> validate ();
+	// Rewrites representation, blocks_info, block heights, the delegator index, pending totals, the checksum and each account's block count, balance and rep block from the chains
+	// Nothing is written if a chain itself is broken, those problems are returned instead
+	// Tables are cleared and rewritten in a single transaction so an interrupted rebuild leaves them untouched
+	std::vector<std::string> rebuild ();
+	std::atomic<uint64_t> accounts;
+	std::atomic<uint64_t> blocks;
+
+private:
+	class range
+	{
+	public:
+		// Problems with the chains themselves
+		std::vector<std::string> errors;
+		// Derived data that disagrees with the chains
+		std::vector<std::string> mismatches;
+		std::unordered_map<rai::account, rai::uint128_t> weights;
+		std::vector<std::pair<rai::block_hash, rai::block_info>> blocks_info;
+		std::vector<std::pair<rai::account, rai::account_info>> accounts;
+		// Whether chains is filled, only a rebuild needs it
+		bool record_chains;
+		// Every block of each sound account in walk order, an account's run is its block_count long
+		std::vector<rai::block_hash> chains;
+		rai::checksum checksum;
+	};
+	std::vector<range> walk (bool);
+	void walk_range (rai::account const &, rai::account const &, bool, range &);
+	void walk_account (MDB_txn *, rai::account const &, rai::account_info const &, range &);
+	// Balance and send amount computed from the blocks alone, returning true on a missing or malformed block
+	bool chain_balance (MDB_txn *, rai::block_hash const &, rai::uint128_t &);
+	bool send_amount (MDB_txn *, rai::block_hash const &, rai::uint128_t &);
+	rai::ledger & ledger;
+	unsigned const threads;
+};
 };
@@ -903,6 +903,35 @@ std::unique_ptr<rai::block> rai::deserialize_block (rai::stream & stream_a, rai:
 	return result;
 }
 
+std::shared_ptr<rai::block> rai::deserialize_block_pooled (rai::stream & stream_a, rai::block_type type_a)
+{
+	std::shared_ptr<rai::block> result;
+	bool error (false);
+	switch (type_a)
+	{
+		case rai::block_type::receive:
+			result = std::allocate_shared<rai::receive_block> (rai::pool_allocator<rai::receive_block> (), error, stream_a);
+			break;
+		case rai::block_type::send:
+			result = std::allocate_shared<rai::send_block> (rai::pool_allocator<rai::send_block> (), error, stream_a);
+			break;
+		case rai::block_type::open:
+			result = std::allocate_shared<rai::open_block> (rai::pool_allocator<rai::open_block> (), error, stream_a);
+			break;
+		case rai::block_type::change:
+			result = std::allocate_shared<rai::change_block> (rai::pool_allocator<rai::change_block> (), error, stream_a);
+			break;
+		default:
+			assert (false);
+			break;
+	}
+	if (error)
+	{
+		result.reset ();
+	}
+	return result;
+}
+
 void rai::receive_block::visit (rai::block_visitor & visitor_a) const
 {
 	visitor_a.receive_block (*this);
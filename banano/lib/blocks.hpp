@@ -1,6 +1,7 @@
 #pragma once
 
 #include <banano/lib/numbers.hpp>
+#include <banano/lib/utility.hpp>
 
 #include <assert.h>
 #include <blake2/blake2.h>
@@ -237,6 +238,8 @@ public:
 };
 std::unique_ptr<rai::block> deserialize_block (rai::stream &);
 std::unique_ptr<rai::block> deserialize_block (rai::stream &, rai::block_type);
+// Block and its reference count are placed in one recycled chunk from the shared pools
+std::shared_ptr<rai::block> deserialize_block_pooled (rai::stream &, rai::block_type);
 std::unique_ptr<rai::block> deserialize_block_json (boost::property_tree::ptree const &);
 void serialize_block (rai::stream &, rai::block const &);
 }
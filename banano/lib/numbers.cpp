@@ -459,6 +459,11 @@ bool rai::validate_message (rai::public_key const & public_key, rai::uint256_uni
 	return result;
 }
 
+void rai::validate_message_batch (unsigned char const ** messages_a, size_t * lengths_a, unsigned char const ** public_keys_a, unsigned char const ** signatures_a, size_t size_a, int * valid_a)
+{
+	ed25519_sign_open_batch (messages_a, lengths_a, public_keys_a, signatures_a, size_a, valid_a);
+}
+
 rai::uint128_union::uint128_union (std::string const & string_a)
 {
 	decode_hex (string_a);
@@ -0,0 +1,65 @@
+#include <banano/lib/utility.hpp>
+
+#include <array>
+
+rai::chunk_pool::chunk_pool (size_t chunk_size_a, size_t capacity_a) :
+chunk_size (chunk_size_a),
+recycled (0),
+allocated (0),
+free (capacity_a)
+{
+}
+
+rai::chunk_pool::~chunk_pool ()
+{
+	void * chunk;
+	while (!free.pop (chunk))
+	{
+		::operator delete (chunk);
+	}
+}
+
+void * rai::chunk_pool::allocate ()
+{
+	void * result;
+	if (!free.pop (result))
+	{
+		++recycled;
+	}
+	else
+	{
+		++allocated;
+		result = ::operator new (chunk_size);
+	}
+	return result;
+}
+
+void rai::chunk_pool::deallocate (void * chunk_a)
+{
+	if (free.push (chunk_a))
+	{
+		::operator delete (chunk_a);
+	}
+}
+
+namespace
+{
+size_t constexpr chunk_class_size = 64;
+size_t constexpr chunk_class_count = 8;
+size_t constexpr chunk_class_capacity = 8 * 1024;
+}
+
+// The pools are heap allocated, extended alignment wouldn't be honoured by new under C++14
+static_assert (alignof (rai::chunk_pool) <= alignof (std::max_align_t), "chunk_pool must not need extended alignment");
+
+rai::chunk_pool * rai::chunk_pool_for (size_t size_a)
+{
+	// Never destroyed so objects released during static destruction still have somewhere to go
+	static auto pools (new std::array<rai::chunk_pool, chunk_class_count>{ { { 1 * chunk_class_size, chunk_class_capacity }, { 2 * chunk_class_size, chunk_class_capacity }, { 3 * chunk_class_size, chunk_class_capacity }, { 4 * chunk_class_size, chunk_class_capacity }, { 5 * chunk_class_size, chunk_class_capacity }, { 6 * chunk_class_size, chunk_class_capacity }, { 7 * chunk_class_size, chunk_class_capacity }, { 8 * chunk_class_size, chunk_class_capacity } } });
+	rai::chunk_pool * result (nullptr);
+	if (size_a > 0 && size_a <= chunk_class_size * chunk_class_count)
+	{
+		result = &(*pools)[(size_a - 1) / chunk_class_size];
+	}
+	return result;
+}
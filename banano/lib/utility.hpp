@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace rai
@@ -29,4 +34,210 @@ public:
 	std::mutex mutex;
 	std::vector<std::function<void(T...)>> observers;
 };
+// Bounded multi-producer multi-consumer queue, capacity is rounded up to a power of two
+// Each slot carries a sequence number so producers and consumers only contend on the slot they claim
+template <typename T>
+class mpmc_queue
+{
+public:
+	mpmc_queue (size_t capacity_a) :
+	mask (round_up (capacity_a) - 1),
+	slots (new slot[mask + 1]),
+	head (0),
+	tail (0)
+	{
+		for (size_t i (0); i <= mask; ++i)
+		{
+			slots[i].sequence.store (i, std::memory_order_relaxed);
+		}
+	}
+	~mpmc_queue ()
+	{
+		for (auto i (head.load ()), n (tail.load ()); i != n; ++i)
+		{
+			reinterpret_cast<T *> (&slots[i & mask].storage)->~T ();
+		}
+	}
+	// Returns true if the queue is full
+	bool push (T const & item_a)
+	{
+		auto result (true);
+		auto position (tail.load (std::memory_order_relaxed));
+		slot * slot_l (nullptr);
+		while (slot_l == nullptr)
+		{
+			auto & candidate (slots[position & mask]);
+			auto sequence (candidate.sequence.load (std::memory_order_acquire));
+			auto difference (static_cast<intptr_t> (sequence) - static_cast<intptr_t> (position));
+			if (difference == 0)
+			{
+				if (tail.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+				{
+					slot_l = &candidate;
+				}
+			}
+			else if (difference < 0)
+			{
+				break;
+			}
+			else
+			{
+				position = tail.load (std::memory_order_relaxed);
+			}
+		}
+		if (slot_l != nullptr)
+		{
+			new (&slot_l->storage) T (item_a);
+			slot_l->sequence.store (position + 1, std::memory_order_release);
+			result = false;
+		}
+		return result;
+	}
+	// Returns true if the queue is empty
+	bool pop (T & item_a)
+	{
+		auto result (true);
+		auto position (head.load (std::memory_order_relaxed));
+		slot * slot_l (nullptr);
+		while (slot_l == nullptr)
+		{
+			auto & candidate (slots[position & mask]);
+			auto sequence (candidate.sequence.load (std::memory_order_acquire));
+			auto difference (static_cast<intptr_t> (sequence) - static_cast<intptr_t> (position + 1));
+			if (difference == 0)
+			{
+				if (head.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+				{
+					slot_l = &candidate;
+				}
+			}
+			else if (difference < 0)
+			{
+				break;
+			}
+			else
+			{
+				position = head.load (std::memory_order_relaxed);
+			}
+		}
+		if (slot_l != nullptr)
+		{
+			auto value (reinterpret_cast<T *> (&slot_l->storage));
+			item_a = std::move (*value);
+			value->~T ();
+			slot_l->sequence.store (position + mask + 1, std::memory_order_release);
+			result = false;
+		}
+		return result;
+	}
+	// Approximate while producers or consumers are active
+	size_t size () const
+	{
+		auto tail_l (tail.load (std::memory_order_acquire));
+		auto head_l (head.load (std::memory_order_acquire));
+		return tail_l > head_l ? tail_l - head_l : 0;
+	}
+	bool empty () const
+	{
+		return size () == 0;
+	}
+	size_t capacity () const
+	{
+		return mask + 1;
+	}
+
+private:
+	static size_t round_up (size_t capacity_a)
+	{
+		size_t result (2);
+		while (result < capacity_a)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+	class slot
+	{
+	public:
+		std::atomic<size_t> sequence;
+		typename std::aligned_storage<sizeof (T), alignof (T)>::type storage;
+	};
+	size_t const mask;
+	std::unique_ptr<slot[]> slots;
+	// Producer and consumer positions are kept on separate cache lines
+	// Padded rather than over-aligned, C++14 new doesn't honour extended alignment for heap allocated queues
+	static size_t constexpr cache_line = 64;
+	uint8_t head_padding[cache_line];
+	std::atomic<size_t> head;
+	uint8_t tail_padding[cache_line - sizeof (std::atomic<size_t>)];
+	std::atomic<size_t> tail;
+	uint8_t end_padding[cache_line - sizeof (std::atomic<size_t>)];
+};
+// Fixed size chunks of memory recycled through a lock free free list
+// Allocation falls back to the global heap when the list is empty and release does the same when it is full
+class chunk_pool
+{
+public:
+	chunk_pool (size_t, size_t);
+	~chunk_pool ();
+	void * allocate ();
+	void deallocate (void *);
+	size_t const chunk_size;
+	std::atomic<uint64_t> recycled;
+	std::atomic<uint64_t> allocated;
+
+private:
+	rai::mpmc_queue<void *> free;
+};
+// Shared pool for the size class holding size_a bytes, nullptr if size_a is too large to pool
+rai::chunk_pool * chunk_pool_for (size_t);
+// Allocator drawing from the shared chunk pools, used with std::allocate_shared so an object and its control block share one recycled chunk
+template <typename T>
+class pool_allocator
+{
+public:
+	using value_type = T;
+	pool_allocator () = default;
+	template <typename U>
+	pool_allocator (rai::pool_allocator<U> const &)
+	{
+	}
+	T * allocate (size_t count_a)
+	{
+		static_assert (alignof (T) <= alignof (std::max_align_t), "Pooled objects must not be over aligned");
+		void * result;
+		auto pool (rai::chunk_pool_for (count_a * sizeof (T)));
+		if (pool != nullptr)
+		{
+			result = pool->allocate ();
+		}
+		else
+		{
+			result = ::operator new (count_a * sizeof (T));
+		}
+		return static_cast<T *> (result);
+	}
+	void deallocate (T * pointer_a, size_t count_a)
+	{
+		auto pool (rai::chunk_pool_for (count_a * sizeof (T)));
+		if (pool != nullptr)
+		{
+			pool->deallocate (pointer_a);
+		}
+		else
+		{
+			::operator delete (pointer_a);
+		}
+	}
+	template <typename U>
+	bool operator== (rai::pool_allocator<U> const &) const
+	{
+		return true;
+	}
+	template <typename U>
+	bool operator!= (rai::pool_allocator<U> const &) const
+	{
+		return false;
+	}
+};
 }
@@ -12,6 +12,11 @@ constexpr double bootstrap_minimum_frontier_blocks_per_sec = 1000.0;
 constexpr unsigned bootstrap_frontier_retry_limit = 16;
 constexpr double bootstrap_minimum_termination_time_sec = 30.0;
 constexpr unsigned bootstrap_max_new_connections = 10;
+constexpr double bootstrap_rate_smoothing = 0.3;
+constexpr double bootstrap_drop_score_fraction = 0.25;
+constexpr double bootstrap_drop_error_rate = 0.5;
+constexpr uint64_t bootstrap_error_rate_min_pulls = 4;
+constexpr std::chrono::seconds bootstrap_progress_flush_interval (10);
 
 rai::block_synchronization::block_synchronization (boost::log::sources::logger_mt & log_a) :
 log (log_a)
@@ -163,7 +168,13 @@ timeout (node_a->service),
 block_count (0),
 pending_stop (false),
 hard_stop (false),
-start_time (std::chrono::steady_clock::now ())
+start_time (std::chrono::steady_clock::now ()),
+rate (0.0),
+sampled_blocks (0),
+sampled_time (start_time),
+rtt_microseconds (0),
+pulls_completed (0),
+pulls_failed (0)
 {
 	++attempt->connections;
 }
@@ -184,6 +195,40 @@ double rai::bootstrap_client::elapsed_seconds () const
 	return std::chrono::duration_cast<std::chrono::duration<double>> (std::chrono::steady_clock::now () - start_time).count ();
 }
 
+void rai::bootstrap_client::sample (std::chrono::steady_clock::time_point now_a, bool active_a)
+{
+	auto blocks (block_count.load ());
+	auto elapsed (std::chrono::duration_cast<std::chrono::duration<double>> (now_a - sampled_time).count ());
+	if (active_a && elapsed > 0.0)
+	{
+		auto current ((blocks - sampled_blocks) / elapsed);
+		rate = rate * (1.0 - bootstrap_rate_smoothing) + current * bootstrap_rate_smoothing;
+	}
+	sampled_blocks = blocks;
+	sampled_time = now_a;
+}
+
+void rai::bootstrap_client::rtt_sample (std::chrono::steady_clock::duration rtt_a)
+{
+	uint64_t sample (std::chrono::duration_cast<std::chrono::microseconds> (rtt_a).count ());
+	auto previous (rtt_microseconds.load ());
+	rtt_microseconds = previous == 0 ? sample : (previous * 7 + sample) / 8;
+}
+
+double rai::bootstrap_client::error_rate () const
+{
+	auto completed (pulls_completed.load ());
+	auto failed (pulls_failed.load ());
+	return completed + failed > 0 ? (double)failed / (completed + failed) : 0.0;
+}
+
+double rai::bootstrap_client::score () const
+{
+	// Every pull costs at least one round trip so high latency peers finish fewer pulls at the same rate
+	auto rtt_sec (rtt_microseconds.load () / 1000000.0);
+	return rate * (1.0 - error_rate ()) / (1.0 + rtt_sec);
+}
+
 void rai::bootstrap_client::stop (bool force)
 {
 	pending_stop = true;
@@ -223,10 +268,12 @@ void rai::bootstrap_client::run ()
 {
 	auto this_l (shared_from_this ());
 	start_timeout ();
-	socket.async_connect (endpoint, [this_l](boost::system::error_code const & ec) {
+	auto connecting (std::chrono::steady_clock::now ());
+	socket.async_connect (endpoint, [this_l, connecting](boost::system::error_code const & ec) {
 		this_l->stop_timeout ();
 		if (!ec)
 		{
+			this_l->rtt_sample (std::chrono::steady_clock::now () - connecting);
 			BOOST_LOG (this_l->node->log) << boost::str (boost::format ("Connection established to %1%") % this_l->endpoint);
 			this_l->attempt->pool_connection (this_l->shared_from_this ());
 		}
@@ -252,7 +299,8 @@ void rai::bootstrap_client::run ()
 void rai::frontier_req_client::run ()
 {
 	std::unique_ptr<rai::frontier_req> request (new rai::frontier_req);
-	request->start.clear ();
+	// Resume after the last frontier an earlier request resolved
+	request->start = resume.is_zero () ? rai::account (0) : rai::account (resume.number () + 1);
 	request->age = std::numeric_limits<decltype (request->age)>::max ();
 	request->count = std::numeric_limits<decltype (request->age)>::max ();
 	auto send_buffer (std::make_shared<std::vector<uint8_t>> ());
@@ -285,10 +333,16 @@ std::shared_ptr<rai::bootstrap_client> rai::bootstrap_client::shared ()
 
 rai::frontier_req_client::frontier_req_client (std::shared_ptr<rai::bootstrap_client> connection_a) :
 connection (connection_a),
+resume (0),
 current (0),
 count (0),
-next_report (std::chrono::steady_clock::now () + std::chrono::seconds (15))
+next_report (std::chrono::steady_clock::now () + std::chrono::seconds (15)),
+buffer (frontier_batch * (sizeof (rai::uint256_union) + sizeof (rai::uint256_union))),
+buffered (0)
 {
+	// Constructed with the attempt mutex held
+	resume = connection->attempt->frontier_cursor;
+	current = resume;
 	rai::transaction transaction (connection->node->store.environment, nullptr, false);
 	next (transaction);
 }
@@ -301,19 +355,19 @@ void rai::frontier_req_client::receive_frontier ()
 {
 	auto this_l (shared_from_this ());
 	connection->start_timeout ();
-	size_t size_l (sizeof (rai::uint256_union) + sizeof (rai::uint256_union));
-	boost::asio::async_read (connection->socket, boost::asio::buffer (connection->receive_buffer.data (), size_l), [this_l, size_l](boost::system::error_code const & ec, size_t size_a) {
+	// Read whatever has arrived, up to a full batch, and carry partial frontiers over to the next read
+	connection->socket.async_read_some (boost::asio::buffer (buffer.data () + buffered, buffer.size () - buffered), [this_l](boost::system::error_code const & ec, size_t size_a) {
 		this_l->connection->stop_timeout ();
 
 		// An issue with asio is that sometimes, instead of reporting a bad file descriptor during disconnect,
 		// we simply get a size of 0.
-		if (size_a == size_l)
+		if (size_a != 0 || ec)
 		{
 			this_l->received_frontier (ec, size_a);
 		}
 		else
 		{
-			BOOST_LOG (this_l->connection->node->log) << boost::str (boost::format ("Invalid size: expected %1%, got %2%") % size_l % size_a);
+			BOOST_LOG (this_l->connection->node->log) << boost::str (boost::format ("Invalid size: expected at least 1, got %1%") % size_a);
 		}
 	});
 }
@@ -333,20 +387,39 @@ void rai::frontier_req_client::received_frontier (boost::system::error_code cons
 {
 	if (!ec)
 	{
-		assert (size_a == sizeof (rai::uint256_union) + sizeof (rai::uint256_union));
-		rai::account account;
-		rai::bufferstream account_stream (connection->receive_buffer.data (), sizeof (rai::uint256_union));
-		auto error1 (rai::read (account_stream, account));
-		assert (!error1);
-		rai::block_hash latest;
-		rai::bufferstream latest_stream (connection->receive_buffer.data () + sizeof (rai::uint256_union), sizeof (rai::uint256_union));
-		auto error2 (rai::read (latest_stream, latest));
-		assert (!error2);
+		buffered += size_a;
+		assert (buffered <= buffer.size ());
+		size_t const frontier_size (sizeof (rai::uint256_union) + sizeof (rai::uint256_union));
+		std::vector<std::pair<rai::account, rai::block_hash>> frontiers;
+		frontiers.reserve (buffered / frontier_size);
+		auto finished (false);
+		size_t offset (0);
+		for (; !finished && buffered - offset >= frontier_size; offset += frontier_size)
+		{
+			rai::account account;
+			rai::bufferstream account_stream (buffer.data () + offset, sizeof (rai::uint256_union));
+			auto error1 (rai::read (account_stream, account));
+			assert (!error1);
+			rai::block_hash latest;
+			rai::bufferstream latest_stream (buffer.data () + offset + sizeof (rai::uint256_union), sizeof (rai::uint256_union));
+			auto error2 (rai::read (latest_stream, latest));
+			assert (!error2);
+			if (!account.is_zero ())
+			{
+				frontiers.push_back (std::make_pair (account, latest));
+			}
+			else
+			{
+				finished = true;
+			}
+		}
+		std::copy (buffer.begin () + offset, buffer.begin () + buffered, buffer.begin ());
+		buffered -= offset;
 		if (count == 0)
 		{
 			start_time = std::chrono::steady_clock::now ();
 		}
-		++count;
+		count += frontiers.size ();
 		std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>> (std::chrono::steady_clock::now () - start_time);
 		double elapsed_sec = time_span.count ();
 		double blocks_per_sec = (double)count / elapsed_sec;
@@ -362,87 +435,106 @@ void rai::frontier_req_client::received_frontier (boost::system::error_code cons
 			next_report = now + std::chrono::seconds (15);
 			BOOST_LOG (connection->node->log) << boost::str (boost::format ("Received %1% frontiers from %2%") % std::to_string (count) % connection->socket.remote_endpoint ());
 		}
-		if (!account.is_zero ())
+		process_frontiers (frontiers, finished);
+		if (!finished)
+		{
+			receive_frontier ();
+		}
+		else
+		{
+			try
+			{
+				promise.set_value (false);
+			}
+			catch (std::future_error &)
+			{
+			}
+			connection->attempt->pool_connection (connection);
+		}
+	}
+	else
+	{
+		if (connection->node->config.logging.network_logging ())
 		{
+			BOOST_LOG (connection->node->log) << boost::str (boost::format ("Error while receiving frontier %1%") % ec.message ());
+		}
+	}
+}
+
+void rai::frontier_req_client::process_frontiers (std::vector<std::pair<rai::account, rai::block_hash>> const & frontiers_a, bool finished_a)
+{
+	// Frontiers arrive in account order so the whole batch is merged against our accounts with one read transaction,
+	// wallet chains that need marking are collected and written afterwards only if there are any.
+	std::vector<std::pair<rai::block_hash, rai::block_hash>> unsynced_l;
+	{
+		rai::transaction transaction (connection->node->store.environment, nullptr, false);
+		for (auto & i : frontiers_a)
+		{
+			auto & account (i.first);
+			auto & latest (i.second);
 			while (!current.is_zero () && current < account)
 			{
 				// We know about an account they don't.
-				rai::transaction transaction (connection->node->store.environment, nullptr, true);
 				if (connection->node->wallets.exists (transaction, current))
 				{
-					unsynced (transaction, info.head, 0);
+					unsynced_l.push_back (std::make_pair (info.head, rai::block_hash (0)));
 				}
 				next (transaction);
 			}
-			if (!current.is_zero ())
+			if (!current.is_zero () && account == current)
 			{
-				if (account == current)
+				if (latest == info.head)
 				{
-					rai::transaction transaction (connection->node->store.environment, nullptr, true);
-					if (latest == info.head)
+					// In sync
+				}
+				else
+				{
+					if (connection->node->store.block_exists (transaction, latest))
 					{
-						// In sync
+						// We know about a block they don't.
+						if (connection->node->wallets.exists (transaction, current))
+						{
+							unsynced_l.push_back (std::make_pair (info.head, latest));
+						}
 					}
 					else
 					{
-						if (connection->node->store.block_exists (transaction, latest))
-						{
-							// We know about a block they don't.
-							if (connection->node->wallets.exists (transaction, current))
-							{
-								unsynced (transaction, info.head, latest);
-							}
-						}
-						else
-						{
-							connection->attempt->add_pull (rai::pull_info (account, latest, info.head));
-						}
+						connection->attempt->add_pull (rai::pull_info (account, latest, info.head));
 					}
-					next (transaction);
-				}
-				else
-				{
-					assert (account < current);
-					connection->attempt->add_pull (rai::pull_info (account, latest, rai::block_hash (0)));
 				}
+				next (transaction);
 			}
 			else
 			{
+				assert (current.is_zero () || account < current);
 				connection->attempt->add_pull (rai::pull_info (account, latest, rai::block_hash (0)));
 			}
-			receive_frontier ();
 		}
-		else
+		if (!frontiers_a.empty ())
 		{
+			std::lock_guard<std::mutex> lock (connection->attempt->mutex);
+			connection->attempt->frontier_cursor = frontiers_a.back ().first;
+			connection->attempt->progress_dirty = true;
+		}
+		if (finished_a)
+		{
+			while (!current.is_zero ())
 			{
-				rai::transaction transaction (connection->node->store.environment, nullptr, true);
-				while (!current.is_zero ())
-				{
-					// We know about an account they don't.
-					if (connection->node->wallets.exists (transaction, current))
-					{
-						unsynced (transaction, info.head, 0);
-					}
-					next (transaction);
-				}
-			}
-			{
-				try
-				{
-					promise.set_value (false);
-				}
-				catch (std::future_error &)
+				// We know about an account they don't.
+				if (connection->node->wallets.exists (transaction, current))
 				{
+					unsynced_l.push_back (std::make_pair (info.head, rai::block_hash (0)));
 				}
-				connection->attempt->pool_connection (connection);
+				next (transaction);
 			}
 		}
 	}
-	else
+	if (!unsynced_l.empty ())
 	{
-		if (connection->node->config.logging.network_logging ())
+		rai::transaction transaction (connection->node->store.environment, nullptr, true);
+		for (auto & i : unsynced_l)
 		{
-			BOOST_LOG (connection->node->log) << boost::str (boost::format ("Error while receiving frontier %1%") % ec.message ());
+			unsynced (transaction, i.first, i.second);
 		}
 	}
 }
@@ -462,7 +554,9 @@ void rai::frontier_req_client::next (MDB_txn * transaction_a)
 }
 
 rai::bulk_pull_client::bulk_pull_client (std::shared_ptr<rai::bootstrap_client> connection_a) :
-connection (connection_a)
+connection (connection_a),
+buffer (chunk_size),
+buffered (0)
 {
 	assert (!connection->attempt->mutex.try_lock ());
 	++connection->attempt->pulling;
@@ -475,10 +569,15 @@ rai::bulk_pull_client::~bulk_pull_client ()
 		std::lock_guard<std::mutex> mutex (connection->attempt->mutex);
 		--connection->attempt->pulling;
 		connection->attempt->condition.notify_all ();
+		if (expected == pull.end)
+		{
+			connection->attempt->record_pull_done (pull.account, processed);
+		}
 	}
 	// If received end block is not expected end block
 	if (expected != pull.end)
 	{
+		++connection->pulls_failed;
 		pull.head = expected;
 		connection->attempt->requeue_pull (pull);
 		if (connection->node->config.logging.bulk_pull_logging ())
@@ -486,6 +585,10 @@ rai::bulk_pull_client::~bulk_pull_client ()
 			BOOST_LOG (connection->node->log) << boost::str (boost::format ("Bulk pull end block is not expected %1% for account %2%") % pull.end.to_string () % pull.account.to_account ());
 		}
 	}
+	else
+	{
+		++connection->pulls_completed;
+	}
 }
 
 void rai::bulk_pull_client::request (rai::pull_info const & pull_a)
@@ -510,6 +613,7 @@ void rai::bulk_pull_client::request (rai::pull_info const & pull_a)
 	}
 	auto this_l (shared_from_this ());
 	connection->start_timeout ();
+	requested = std::chrono::steady_clock::now ();
 	boost::asio::async_write (connection->socket, boost::asio::buffer (buffer->data (), buffer->size ()), [this_l, buffer](boost::system::error_code const & ec, size_t size_a) {
 		this_l->connection->stop_timeout ();
 		if (!ec)
@@ -526,113 +630,189 @@ void rai::bulk_pull_client::request (rai::pull_info const & pull_a)
 void rai::bulk_pull_client::receive_block ()
 {
 	auto this_l (shared_from_this ());
-	connection->start_timeout ();
-	boost::asio::async_read (connection->socket, boost::asio::buffer (connection->receive_buffer.data (), 1), [this_l](boost::system::error_code const & ec, size_t size_a) {
-		this_l->connection->stop_timeout ();
-		if (!ec)
+	if (!connection->node->block_processor.saturated ())
+	{
+		connection->start_timeout ();
+		// Read whatever has arrived, a partially received block stays at the front of the buffer
+		connection->socket.async_read_some (boost::asio::buffer (buffer.data () + buffered, buffer.size () - buffered), [this_l](boost::system::error_code const & ec, size_t size_a) {
+			this_l->connection->stop_timeout ();
+			this_l->received_block (ec, size_a);
+		});
+	}
+	else
+	{
+		// Leave blocks in the socket until the block processor drains below its high-water mark
+		connection->node->alarm.add (std::chrono::steady_clock::now () + std::chrono::milliseconds (50), [this_l]() {
+			if (!this_l->connection->hard_stop.load ())
+			{
+				this_l->receive_block ();
+			}
+		});
+	}
+}
+
+void rai::bulk_pull_client::queue_blocks (bool finished_a, bool error_a)
+{
+	std::vector<rai::block_processor_item> items;
+	items.reserve (backlog.size ());
+	for (auto & block : backlog)
+	{
+		items.push_back (rai::block_processor_item (block));
+	}
+	std::shared_future<void> processed_l;
+	if (!items.empty ())
+	{
+		// Blocks in a lane are processed in order so the last one tells us when the whole pull has been
+		items.back ().processed = std::make_shared<std::promise<void>> ();
+		processed_l = items.back ().processed->get_future ().share ();
+	}
+	auto queued (connection->node->block_processor.add (items, rai::block_origin::bootstrap));
+	if (queued != 0 && queued == items.size ())
+	{
+		processed = processed_l;
+	}
+	// Only blocks that made it into the processor count towards the pull
+	for (auto i (backlog.begin ()), n (backlog.begin () + queued); i != n; ++i)
+	{
+		auto & block (*i);
+		auto hash (block->hash ());
+		if (connection->node->config.logging.bulk_pull_logging ())
 		{
-			this_l->received_type ();
+			std::string block_l;
+			block->serialize_json (block_l);
+			BOOST_LOG (connection->node->log) << boost::str (boost::format ("Pulled block %1% %2%") % hash.to_string () % block_l);
 		}
-		else
+		if (hash == expected)
 		{
-			BOOST_LOG (this_l->connection->node->log) << boost::str (boost::format ("Error receiving block type %1%") % ec.message ());
+			expected = block->previous ();
 		}
-	});
+		if (connection->block_count++ == 0)
+		{
+			connection->start_time = std::chrono::steady_clock::now ();
+		}
+	}
+	connection->attempt->total_blocks += queued;
+	backlog.erase (backlog.begin (), backlog.begin () + queued);
+	if (!backlog.empty ())
+	{
+		// The bootstrap lane is full, try again shortly rather than holding the io thread until there's room
+		auto this_l (shared_from_this ());
+		connection->node->alarm.add (std::chrono::steady_clock::now () + std::chrono::milliseconds (50), [this_l, finished_a, error_a]() {
+			if (!this_l->connection->hard_stop.load ())
+			{
+				this_l->queue_blocks (finished_a, error_a);
+			}
+		});
+	}
+	else if (finished_a)
+	{
+		// Avoid re-using slow peers, or peers that sent the wrong blocks.
+		if (!connection->pending_stop && expected == pull.end)
+		{
+			connection->attempt->pool_connection (connection);
+		}
+	}
+	else if (!error_a && !connection->hard_stop.load ())
+	{
+		receive_block ();
+	}
 }
 
-void rai::bulk_pull_client::received_type ()
+size_t rai::bulk_pull_client::block_size (rai::block_type type_a)
 {
-	auto this_l (shared_from_this ());
-	rai::block_type type (static_cast<rai::block_type> (connection->receive_buffer[0]));
-	switch (type)
+	size_t result (0);
+	switch (type_a)
 	{
 		case rai::block_type::send:
-		{
-			connection->start_timeout ();
-			boost::asio::async_read (connection->socket, boost::asio::buffer (connection->receive_buffer.data () + 1, rai::send_block::size), [this_l](boost::system::error_code const & ec, size_t size_a) {
-				this_l->connection->stop_timeout ();
-				this_l->received_block (ec, size_a);
-			});
+			result = rai::send_block::size;
 			break;
-		}
 		case rai::block_type::receive:
-		{
-			connection->start_timeout ();
-			boost::asio::async_read (connection->socket, boost::asio::buffer (connection->receive_buffer.data () + 1, rai::receive_block::size), [this_l](boost::system::error_code const & ec, size_t size_a) {
-				this_l->connection->stop_timeout ();
-				this_l->received_block (ec, size_a);
-			});
+			result = rai::receive_block::size;
 			break;
-		}
 		case rai::block_type::open:
-		{
-			connection->start_timeout ();
-			boost::asio::async_read (connection->socket, boost::asio::buffer (connection->receive_buffer.data () + 1, rai::open_block::size), [this_l](boost::system::error_code const & ec, size_t size_a) {
-				this_l->connection->stop_timeout ();
-				this_l->received_block (ec, size_a);
-			});
+			result = rai::open_block::size;
 			break;
-		}
 		case rai::block_type::change:
-		{
-			connection->start_timeout ();
-			boost::asio::async_read (connection->socket, boost::asio::buffer (connection->receive_buffer.data () + 1, rai::change_block::size), [this_l](boost::system::error_code const & ec, size_t size_a) {
-				this_l->connection->stop_timeout ();
-				this_l->received_block (ec, size_a);
-			});
-			break;
-		}
-		case rai::block_type::not_a_block:
-		{
-			// Avoid re-using slow peers, or peers that sent the wrong blocks.
-			if (!connection->pending_stop && expected == pull.end)
-			{
-				connection->attempt->pool_connection (connection);
-			}
+			result = rai::change_block::size;
 			break;
-		}
 		default:
-		{
-			BOOST_LOG (connection->node->log) << boost::str (boost::format ("Unknown type received as block type: %1%") % static_cast<int> (type));
 			break;
-		}
 	}
+	return result;
 }
 
 void rai::bulk_pull_client::received_block (boost::system::error_code const & ec, size_t size_a)
 {
-	if (!ec)
+	// An issue with asio is that sometimes, instead of reporting a bad file descriptor during disconnect,
+	// we simply get a size of 0.
+	if (!ec && size_a != 0)
 	{
-		rai::bufferstream stream (connection->receive_buffer.data (), 1 + size_a);
-		std::shared_ptr<rai::block> block (rai::deserialize_block (stream));
-		if (block != nullptr && !rai::work_validate (*block))
+		if (requested != std::chrono::steady_clock::time_point ())
 		{
-			auto hash (block->hash ());
-			if (connection->node->config.logging.bulk_pull_logging ())
-			{
-				std::string block_l;
-				block->serialize_json (block_l);
-				BOOST_LOG (connection->node->log) << boost::str (boost::format ("Pulled block %1% %2%") % hash.to_string () % block_l);
-			}
-			if (hash == expected)
-			{
-				expected = block->previous ();
-			}
-			if (connection->block_count++ == 0)
+			connection->rtt_sample (std::chrono::steady_clock::now () - requested);
+			requested = std::chrono::steady_clock::time_point ();
+		}
+		buffered += size_a;
+		assert (buffered <= buffer.size ());
+		std::vector<std::shared_ptr<rai::block>> blocks;
+		auto finished (false);
+		auto error (false);
+		size_t offset (0);
+		while (!finished && !error && offset < buffered)
+		{
+			rai::block_type type (static_cast<rai::block_type> (buffer[offset]));
+			if (type == rai::block_type::not_a_block)
 			{
-				connection->start_time = std::chrono::steady_clock::now ();
+				finished = true;
+				offset += 1;
 			}
-			connection->attempt->total_blocks++;
-			connection->attempt->node->block_processor.add (rai::block_processor_item (block));
-			if (!connection->hard_stop.load ())
+			else
 			{
-				receive_block ();
+				auto size_l (block_size (type));
+				if (size_l != 0)
+				{
+					if (buffered - offset >= 1 + size_l)
+					{
+						rai::bufferstream stream (buffer.data () + offset + 1, size_l);
+						auto block (rai::deserialize_block_pooled (stream, type));
+						if (block != nullptr)
+						{
+							blocks.push_back (block);
+							offset += 1 + size_l;
+						}
+						else
+						{
+							BOOST_LOG (connection->node->log) << "Error deserializing block received from pull request";
+							error = true;
+						}
+					}
+					else
+					{
+						// Rest of the block hasn't arrived yet
+						break;
+					}
+				}
+				else
+				{
+					BOOST_LOG (connection->node->log) << boost::str (boost::format ("Unknown type received as block type: %1%") % static_cast<int> (type));
+					error = true;
+				}
 			}
 		}
-		else
+		std::copy (buffer.begin () + offset, buffer.begin () + buffered, buffer.begin ());
+		buffered -= offset;
+		// Work is checked for the whole batch before anything is queued, blocks ahead of an invalid one are kept
+		auto valid (std::find_if (blocks.begin (), blocks.end (), [](std::shared_ptr<rai::block> const & block_a) {
+			return rai::work_validate (*block_a);
+		}));
+		if (valid != blocks.end ())
 		{
-			BOOST_LOG (connection->node->log) << "Error deserializing block received from pull request";
+			BOOST_LOG (connection->node->log) << "Insufficient work for block received from pull request";
+			blocks.erase (valid, blocks.end ());
+			error = true;
 		}
+		backlog.insert (backlog.end (), blocks.begin (), blocks.end ());
+		queue_blocks (finished, error);
 	}
 	else
 	{
@@ -772,13 +952,40 @@ attempts (0)
 {
 }
 
+void rai::pull_info::serialize (rai::stream & stream_a) const
+{
+	rai::write (stream_a, head.bytes);
+	rai::write (stream_a, end.bytes);
+	rai::write (stream_a, static_cast<uint32_t> (attempts));
+}
+
+bool rai::pull_info::deserialize (rai::stream & stream_a)
+{
+	auto error (rai::read (stream_a, head.bytes));
+	if (!error)
+	{
+		error = rai::read (stream_a, end.bytes);
+		if (!error)
+		{
+			uint32_t attempts_l;
+			error = rai::read (stream_a, attempts_l);
+			attempts = attempts_l;
+		}
+	}
+	return error;
+}
+
 rai::bootstrap_attempt::bootstrap_attempt (std::shared_ptr<rai::node> node_a) :
 connections (0),
 pulling (0),
 node (node_a),
 account_count (0),
-stopped (false),
-total_blocks (0)
+total_blocks (0),
+frontier_cursor (0),
+frontiers_complete (false),
+progress_dirty (false),
+target (0),
+stopped (false)
 {
 	BOOST_LOG (node->log) << "Starting bootstrap attempt";
 	node->bootstrap_initiator.notify_listeners (true);
@@ -807,9 +1014,11 @@ bool rai::bootstrap_attempt::request_frontier (std::unique_lock<std::mutex> & lo
 		lock_a.unlock ();
 		result = consume_future (future);
 		lock_a.lock ();
-		if (result)
+		// Pulls found before a failure stay queued, the retry resumes from the frontier cursor
+		if (!result)
 		{
-			pulls.clear ();
+			frontiers_complete = true;
+			progress_dirty = true;
 		}
 		if (node->config.logging.network_logging ())
 		{
@@ -882,10 +1091,12 @@ bool rai::bootstrap_attempt::still_pulling ()
 
 void rai::bootstrap_attempt::run ()
 {
+	restore ();
 	populate_connections ();
 	resolve_forks ();
+	ongoing_flush_progress ();
 	std::unique_lock<std::mutex> lock (mutex);
-	auto frontier_failure (true);
+	auto frontier_failure (!frontiers_complete);
 	while (!stopped && frontier_failure)
 	{
 		frontier_failure = request_frontier (lock);
@@ -916,10 +1127,30 @@ void rai::bootstrap_attempt::run ()
 		lock.lock ();
 		BOOST_LOG (node->log) << "Finished flushing unchecked blocks";
 	}
-	if (!stopped)
+	auto completed (!stopped);
+	if (completed)
 	{
 		BOOST_LOG (node->log) << "Completed pulls";
 	}
+	lock.unlock ();
+	if (completed)
+	{
+		// Nothing left to resume, the next attempt scans frontiers from the start
+		node->write_scheduler.submit_wait ([this](MDB_txn * transaction) {
+			node->store.bootstrap_clear (transaction);
+		});
+		lock.lock ();
+		progress_puts.clear ();
+		progress_dels.clear ();
+		progress_pending.clear ();
+		pull_accounts.clear ();
+		progress_dirty = false;
+	}
+	else
+	{
+		flush_progress (true);
+		lock.lock ();
+	}
 	auto push_failure (true);
 	while (!stopped && push_failure)
 	{
@@ -939,8 +1170,17 @@ std::shared_ptr<rai::bootstrap_client> rai::bootstrap_attempt::connection (std::
 	std::shared_ptr<rai::bootstrap_client> result;
 	if (!idle.empty ())
 	{
-		result = idle.back ();
-		idle.pop_back ();
+		// Hand out the best scoring connection, requeued pulls are at the front of the queue so partially pulled chains go to the fastest peers
+		auto best (idle.end () - 1);
+		for (auto i (idle.begin ()), n (idle.end ()); i != n; ++i)
+		{
+			if ((*i)->score () > (*best)->score ())
+			{
+				best = i;
+			}
+		}
+		result = *best;
+		idle.erase (best);
 	}
 	return result;
 }
@@ -1053,14 +1293,6 @@ void rai::bootstrap_attempt::resolve_forks ()
 	}
 }
 
-struct block_rate_cmp
-{
-	bool operator() (const std::shared_ptr<rai::bootstrap_client> & lhs, const std::shared_ptr<rai::bootstrap_client> & rhs) const
-	{
-		return lhs->block_rate () > rhs->block_rate ();
-	}
-};
-
 unsigned rai::bootstrap_attempt::target_connections (size_t pulls_remaining)
 {
 	if (node->config.bootstrap_connections >= node->config.bootstrap_connections_max)
@@ -1074,11 +1306,42 @@ unsigned rai::bootstrap_attempt::target_connections (size_t pulls_remaining)
 	return std::max (1U, (unsigned)(target + 0.5f));
 }
 
+namespace
+{
+class peer_rank
+{
+public:
+	double score;
+	double error_rate;
+	uint64_t pulls;
+	std::shared_ptr<rai::bootstrap_client> client;
+};
+}
+
+void rai::bootstrap_attempt::decide (std::string const & decision_a)
+{
+	assert (!mutex.try_lock ());
+	if (node->config.logging.bulk_pull_logging ())
+	{
+		BOOST_LOG (node->log) << decision_a;
+	}
+	decisions.push_front (decision_a);
+	if (decisions.size () > decisions_max)
+	{
+		decisions.pop_back ();
+	}
+}
+
 void rai::bootstrap_attempt::populate_connections ()
 {
 	double rate_sum = 0.0;
 	size_t num_pulls = 0;
-	std::priority_queue<std::shared_ptr<rai::bootstrap_client>, std::vector<std::shared_ptr<rai::bootstrap_client>>, block_rate_cmp> sorted_connections;
+	// Measurements are copied under the lock, io threads keep updating the live values
+	std::vector<peer_rank> ranked;
+	std::vector<std::string> decisions_l;
+	// Pulls are held back while the block processor is saturated, rates don't reflect the peers then
+	auto throttled (node->block_processor.saturated ());
+	auto now (std::chrono::steady_clock::now ());
 	{
 		std::unique_lock<std::mutex> lock (mutex);
 		num_pulls = pulls.size ();
@@ -1086,36 +1349,61 @@ void rai::bootstrap_attempt::populate_connections ()
 		{
 			if (auto client = c.lock ())
 			{
+				// Time spent idle or throttled doesn't count against a peer
+				auto active (!throttled && std::find (idle.begin (), idle.end (), client) == idle.end ());
+				client->sample (now, active);
 				double elapsed_sec = client->elapsed_seconds ();
 				auto blocks_per_sec = client->block_rate ();
 				rate_sum += blocks_per_sec;
-				if (client->elapsed_seconds () > bootstrap_connection_warmup_time_sec && client->block_count > 0)
+				if (elapsed_sec > bootstrap_connection_warmup_time_sec && client->block_count > 0 && !client->pending_stop)
 				{
-					sorted_connections.push (client);
+					auto pulls (client->pulls_completed + client->pulls_failed);
+					ranked.push_back (peer_rank{ client->score (), client->error_rate (), pulls, client });
 				}
 				// Force-stop the slowest peers, since they can take the whole bootstrap hostage by dribbling out blocks on the last remaining pull.
 				// This is ~1.5kilobits/sec.
-				if (elapsed_sec > bootstrap_minimum_termination_time_sec && blocks_per_sec < bootstrap_minimum_blocks_per_sec)
+				if (!throttled && !client->hard_stop && elapsed_sec > bootstrap_minimum_termination_time_sec && blocks_per_sec < bootstrap_minimum_blocks_per_sec)
 				{
 					client->stop (true);
+					decisions_l.push_back (boost::str (boost::format ("Stopped %1% at %2% blocks/sec, below the %3% minimum") % client->endpoint % (int)blocks_per_sec % bootstrap_minimum_blocks_per_sec));
 				}
 			}
 		}
 	}
 
-	auto target = target_connections (num_pulls);
+	auto target_l = target_connections (num_pulls);
 
-	// We only want to drop slow peers when more than 2/3 are active. 2/3 because 1/2 is too aggressive, and 100% rarely happens.
-	// Probably needs more tuning.
-	if (sorted_connections.size () >= (target * 2) / 3 && target >= 4)
+	// Peers are only compared once more than 2/3 are past warmup, 2/3 because 1/2 is too aggressive, and 100% rarely happens.
+	if (!throttled && ranked.size () >= (target_l * 2) / 3 && target_l >= 4)
 	{
-		// 4 -> 1, 8 -> 2, 16 -> 4, arbitrary, but seems to work well.
-		auto drop = (int)roundf (sqrtf ((float)target - 2.0f));
-		for (int i = 0; i < drop; i++)
+		std::sort (ranked.begin (), ranked.end (), [](peer_rank const & lhs, peer_rank const & rhs) {
+			return lhs.score > rhs.score;
+		});
+		auto median (ranked[ranked.size () / 2].score);
+		// 4 -> 1, 8 -> 2, 16 -> 4 at most per tick, only peers well below the median or failing most of their pulls are dropped
+		auto drop = (int)roundf (sqrtf ((float)target_l - 2.0f));
+		for (auto i (ranked.rbegin ()), n (ranked.rend ()); i != n && drop > 0; ++i)
 		{
-			auto client = sorted_connections.top ();
-			client->stop (false);
-			sorted_connections.pop ();
+			auto failing (i->pulls >= bootstrap_error_rate_min_pulls && i->error_rate > bootstrap_drop_error_rate);
+			if (failing || i->score < median * bootstrap_drop_score_fraction)
+			{
+				i->client->stop (false);
+				decisions_l.push_back (boost::str (boost::format ("Dropped %1% with score %2% against median %3%, error rate %4%") % i->client->endpoint % (int)i->score % (int)median % i->error_rate));
+				--drop;
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock (mutex);
+		if (target_l != target)
+		{
+			decisions_l.push_back (boost::str (boost::format ("Target connections %1% -> %2% with %3% pulls remaining") % target % target_l % num_pulls));
+			target = target_l;
+		}
+		for (auto & i : decisions_l)
+		{
+			decide (i);
 		}
 	}
 
@@ -1125,9 +1413,9 @@ void rai::bootstrap_attempt::populate_connections ()
 		BOOST_LOG (node->log) << boost::str (boost::format ("Bulk pull connections: %1%, rate: %2% blocks/sec, remaining account pulls: %3%, total blocks: %4%") % connections.load () % (int)rate_sum % pulls.size () % (int)total_blocks.load ());
 	}
 
-	if (connections < target)
+	if (connections < target_l)
 	{
-		auto delta = std::min ((target - connections) * 2, bootstrap_max_new_connections);
+		auto delta = std::min ((target_l - connections) * 2, bootstrap_max_new_connections);
 		// TODO - tune this better
 		// Not many peers respond, need to try to make more connections than we need.
 		for (int i = 0; i < delta; i++)
@@ -1210,8 +1498,12 @@ void rai::bootstrap_attempt::stop ()
 void rai::bootstrap_attempt::add_pull (rai::pull_info const & pull)
 {
 	std::lock_guard<std::mutex> lock (mutex);
-	pulls.push_back (pull);
-	condition.notify_all ();
+	if (pull_accounts.insert (pull.account).second)
+	{
+		pulls.push_back (pull);
+		record_pull (pull);
+		condition.notify_all ();
+	}
 }
 
 void rai::bootstrap_attempt::requeue_pull (rai::pull_info const & pull_a)
@@ -1221,6 +1513,7 @@ void rai::bootstrap_attempt::requeue_pull (rai::pull_info const & pull_a)
 	{
 		std::lock_guard<std::mutex> lock (mutex);
 		pulls.push_front (pull);
+		record_pull (pull);
 		condition.notify_all ();
 	}
 	else if (pull.attempts == bootstrap_frontier_retry_limit)
@@ -1238,6 +1531,10 @@ void rai::bootstrap_attempt::requeue_pull (rai::pull_info const & pull_a)
 				BOOST_LOG (node->log) << boost::str (boost::format ("Requesting pull account %1% from frontier peer after %2% attempts") % pull.account.to_account () % pull.attempts);
 			}
 		}
+		else
+		{
+			record_pull_done (pull.account);
+		}
 	}
 	else
 	{
@@ -1245,9 +1542,172 @@ void rai::bootstrap_attempt::requeue_pull (rai::pull_info const & pull_a)
 		{
 			BOOST_LOG (node->log) << boost::str (boost::format ("Failed to pull account %1% down to %2% after %3% attempts") % pull.account.to_account () % pull.end.to_string () % pull.attempts);
 		}
+		std::lock_guard<std::mutex> lock (mutex);
+		record_pull_done (pull.account);
+	}
+}
+
+void rai::bootstrap_attempt::record_pull (rai::pull_info const & pull_a)
+{
+	assert (!mutex.try_lock ());
+	progress_dels.erase (pull_a.account);
+	progress_pending.erase (pull_a.account);
+	progress_puts[pull_a.account] = pull_a;
+}
+
+void rai::bootstrap_attempt::record_pull_done (rai::account const & account_a)
+{
+	assert (!mutex.try_lock ());
+	progress_pending.erase (account_a);
+	progress_puts.erase (account_a);
+	progress_dels.insert (account_a);
+}
+
+void rai::bootstrap_attempt::record_pull_done (rai::account const & account_a, std::shared_future<void> const & processed_a)
+{
+	assert (!mutex.try_lock ());
+	if (processed_a.valid ())
+	{
+		progress_pending[account_a] = processed_a;
+	}
+	else
+	{
+		record_pull_done (account_a);
+	}
+}
+
+void rai::bootstrap_attempt::restore ()
+{
+	std::deque<rai::pull_info> pulls_l;
+	rai::account cursor (0);
+	auto complete (false);
+	{
+		rai::transaction transaction (node->store.environment, nullptr, false);
+		for (auto i (node->store.bootstrap_begin (transaction)), n (node->store.bootstrap_end ()); i != n; ++i)
+		{
+			rai::account account (i->first.uint256 ());
+			rai::bufferstream stream (reinterpret_cast<uint8_t const *> (i->second.data ()), i->second.size ());
+			if (account.is_zero ())
+			{
+				uint8_t complete_l;
+				auto error (rai::read (stream, cursor.bytes) || rai::read (stream, complete_l));
+				assert (!error);
+				complete = complete_l != 0;
+			}
+			else
+			{
+				rai::pull_info pull;
+				pull.account = account;
+				auto error (pull.deserialize (stream));
+				assert (!error);
+				pulls_l.push_back (pull);
+			}
+		}
+	}
+	if (!cursor.is_zero () || complete || !pulls_l.empty ())
+	{
+		BOOST_LOG (node->log) << boost::str (boost::format ("Resuming bootstrap with %1% pulls, frontiers %2%") % pulls_l.size () % (complete ? std::string ("complete") : "from " + cursor.to_account ()));
+	}
+	std::lock_guard<std::mutex> lock (mutex);
+	frontier_cursor = cursor;
+	frontiers_complete = complete;
+	for (auto & i : pulls_l)
+	{
+		pull_accounts.insert (i.account);
+	}
+	pulls.insert (pulls.end (), pulls_l.begin (), pulls_l.end ());
+}
+
+void rai::bootstrap_attempt::flush_progress (bool wait_a)
+{
+	{
+		std::lock_guard<std::mutex> lock (mutex);
+		for (auto i (progress_pending.begin ()), n (progress_pending.end ()); i != n;)
+		{
+			if (i->second.wait_for (std::chrono::seconds (0)) == std::future_status::ready)
+			{
+				auto discarded (false);
+				try
+				{
+					i->second.get ();
+				}
+				catch (std::exception const &)
+				{
+					// The block processor stopped before reaching these blocks, the row stays so they're pulled again
+					discarded = true;
+				}
+				if (!discarded)
+				{
+					progress_puts.erase (i->first);
+					progress_dels.insert (i->first);
+				}
+				i = progress_pending.erase (i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+		if (progress_dirty || !progress_puts.empty () || !progress_dels.empty ())
+		{
+			auto puts (std::make_shared<std::unordered_map<rai::account, rai::pull_info>> ());
+			auto dels (std::make_shared<std::unordered_set<rai::account>> ());
+			puts->swap (progress_puts);
+			dels->swap (progress_dels);
+			auto cursor (frontier_cursor);
+			auto complete (frontiers_complete);
+			progress_dirty = false;
+			auto node_l (node);
+			// Queued under the mutex so flushes are written in the order their changes were taken
+			node->write_scheduler.submit ([node_l, puts, dels, cursor, complete](MDB_txn * transaction) {
+				std::vector<uint8_t> buffer;
+				{
+					rai::vectorstream stream (buffer);
+					rai::write (stream, cursor.bytes);
+					rai::write (stream, static_cast<uint8_t> (complete ? 1 : 0));
+				}
+				node_l->store.bootstrap_put (transaction, rai::account (0), rai::mdb_val (buffer.size (), buffer.data ()));
+				for (auto & i : *puts)
+				{
+					buffer.clear ();
+					{
+						rai::vectorstream stream (buffer);
+						i.second.serialize (stream);
+					}
+					node_l->store.bootstrap_put (transaction, i.first, rai::mdb_val (buffer.size (), buffer.data ()));
+				}
+				for (auto & i : *dels)
+				{
+					node_l->store.bootstrap_del (transaction, i);
+				}
+			});
+		}
+	}
+	if (wait_a)
+	{
+		// Writes commit in the order they're queued, once this one has the flush has too
+		node->write_scheduler.submit_wait ([](MDB_txn *) {});
 	}
 }
 
+void rai::bootstrap_attempt::ongoing_flush_progress ()
+{
+	std::weak_ptr<rai::bootstrap_attempt> this_w (shared_from_this ());
+	node->alarm.add (std::chrono::steady_clock::now () + bootstrap_progress_flush_interval, [this_w]() {
+		if (auto this_l = this_w.lock ())
+		{
+			std::unique_lock<std::mutex> lock (this_l->mutex);
+			if (!this_l->stopped)
+			{
+				lock.unlock ();
+				// Alarms run on io threads, the flush is committed by the writer without waiting for it
+				this_l->flush_progress (false);
+				this_l->ongoing_flush_progress ();
+			}
+		}
+	});
+}
+
 rai::bootstrap_initiator::bootstrap_initiator (rai::node & node_a) :
 node (node_a),
 stopped (false),
@@ -1320,6 +1780,12 @@ bool rai::bootstrap_initiator::in_progress ()
 	return attempt != nullptr;
 }
 
+std::shared_ptr<rai::bootstrap_attempt> rai::bootstrap_initiator::current_attempt ()
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	return attempt;
+}
+
 void rai::bootstrap_initiator::stop ()
 {
 	std::unique_lock<std::mutex> lock (mutex);
@@ -1702,36 +2168,103 @@ void rai::bulk_pull_server::set_current_end ()
 
 void rai::bulk_pull_server::send_next ()
 {
-	std::unique_ptr<rai::block> block (get_next ());
-	if (block != nullptr)
+	read_ahead ();
+}
+
+void rai::bulk_pull_server::fill ()
+{
+	// Only one fill runs at a time so the chain position is read without the mutex, which the io thread may be waiting on
+	std::vector<uint8_t> chunk;
+	chunk.reserve (chunk_size + 1024);
+	auto finished_l (false);
 	{
+		rai::vectorstream stream (chunk);
+		rai::transaction transaction (connection->node->store.environment, nullptr, false);
+		while (!finished_l && chunk.size () < chunk_size)
 		{
-			send_buffer.clear ();
-			rai::vectorstream stream (send_buffer);
-			rai::serialize_block (stream, *block);
+			auto block (get_next (transaction));
+			if (block != nullptr)
+			{
+				rai::serialize_block (stream, *block);
+				if (connection->node->config.logging.bulk_pull_logging ())
+				{
+					BOOST_LOG (connection->node->log) << boost::str (boost::format ("Sending block: %1%") % block->hash ().to_string ());
+				}
+			}
+			else
+			{
+				rai::write (stream, rai::block_type::not_a_block);
+				finished_l = true;
+				if (connection->node->config.logging.bulk_pull_logging ())
+				{
+					BOOST_LOG (connection->node->log) << "Bulk sending finished";
+				}
+			}
 		}
-		auto this_l (shared_from_this ());
-		if (connection->node->config.logging.bulk_pull_logging ())
+	}
+	std::lock_guard<std::mutex> lock (mutex);
+	chunks.push_back (std::move (chunk));
+	finished = finished_l;
+}
+
+void rai::bulk_pull_server::read_ahead ()
+{
+	auto start (false);
+	{
+		std::lock_guard<std::mutex> lock (mutex);
+		if (!filling && !finished && chunks.size () < chunks_max)
 		{
-			BOOST_LOG (connection->node->log) << boost::str (boost::format ("Sending block: %1%") % block->hash ().to_string ());
+			filling = true;
+			start = true;
 		}
-		async_write (*connection->socket, boost::asio::buffer (send_buffer.data (), send_buffer.size ()), [this_l](boost::system::error_code const & ec, size_t size_a) {
-			this_l->sent_action (ec, size_a);
+	}
+	if (start)
+	{
+		auto this_l (shared_from_this ());
+		connection->node->background ([this_l]() {
+			this_l->fill ();
+			{
+				std::lock_guard<std::mutex> lock (this_l->mutex);
+				this_l->filling = false;
+			}
+			// Each chunk goes out as soon as it's read, reading continues while the socket is busy
+			this_l->write ();
+			this_l->read_ahead ();
 		});
 	}
-	else
+}
+
+void rai::bulk_pull_server::write ()
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	if (!writing && !chunks.empty ())
 	{
-		send_finished ();
+		writing = true;
+		sending.swap (chunks);
+		std::vector<boost::asio::const_buffer> buffers;
+		for (auto & i : sending)
+		{
+			buffers.push_back (boost::asio::buffer (i.data (), i.size ()));
+		}
+		auto this_l (shared_from_this ());
+		async_write (*connection->socket, buffers, [this_l](boost::system::error_code const & ec, size_t size_a) {
+			this_l->sent_action (ec, size_a);
+		});
 	}
 }
 
-std::unique_ptr<rai::block> rai::bulk_pull_server::get_next ()
+std::shared_ptr<rai::block const> rai::bulk_pull_server::get_next ()
 {
-	std::unique_ptr<rai::block> result;
+	rai::transaction transaction (connection->node->store.environment, nullptr, false);
+	return get_next (transaction);
+}
+
+std::shared_ptr<rai::block const> rai::bulk_pull_server::get_next (MDB_txn * transaction_a)
+{
+	std::shared_ptr<rai::block const> result;
 	if (current != request->end)
 	{
-		rai::transaction transaction (connection->node->store.environment, nullptr, false);
-		result = connection->node->store.block_get (transaction, current);
+		result = connection->node->store.block_get_cached (transaction_a, current);
 		if (result != nullptr)
 		{
 			auto previous (result->previous ());
@@ -1756,7 +2289,23 @@ void rai::bulk_pull_server::sent_action (boost::system::error_code const & ec, s
 {
 	if (!ec)
 	{
-		send_next ();
+		auto done (false);
+		{
+			std::lock_guard<std::mutex> lock (mutex);
+			writing = false;
+			sending.clear ();
+			done = finished && chunks.empty ();
+		}
+		if (done)
+		{
+			connection->finish_request ();
+		}
+		else
+		{
+			// Start on what's ready before reading more so the socket stays busy
+			write ();
+			read_ahead ();
+		}
 	}
 	else
 	{
@@ -1764,36 +2313,12 @@ void rai::bulk_pull_server::sent_action (boost::system::error_code const & ec, s
 	}
 }
 
-void rai::bulk_pull_server::send_finished ()
-{
-	send_buffer.clear ();
-	send_buffer.push_back (static_cast<uint8_t> (rai::block_type::not_a_block));
-	auto this_l (shared_from_this ());
-	if (connection->node->config.logging.bulk_pull_logging ())
-	{
-		BOOST_LOG (connection->node->log) << "Bulk sending finished";
-	}
-	async_write (*connection->socket, boost::asio::buffer (send_buffer.data (), 1), [this_l](boost::system::error_code const & ec, size_t size_a) {
-		this_l->no_block_sent (ec, size_a);
-	});
-}
-
-void rai::bulk_pull_server::no_block_sent (boost::system::error_code const & ec, size_t size_a)
-{
-	if (!ec)
-	{
-		assert (size_a == 1);
-		connection->finish_request ();
-	}
-	else
-	{
-		BOOST_LOG (connection->node->log) << "Unable to send not-a-block";
-	}
-}
-
 rai::bulk_pull_server::bulk_pull_server (std::shared_ptr<rai::bootstrap_server> const & connection_a, std::unique_ptr<rai::bulk_pull> request_a) :
 connection (connection_a),
-request (std::move (request_a))
+request (std::move (request_a)),
+writing (false),
+filling (false),
+finished (false)
 {
 	set_current_end ();
 }
@@ -2059,9 +2584,13 @@ void rai::bulk_push_server::received_block (boost::system::error_code const & ec
 		{
 			if (!connection->node->bootstrap_initiator.in_progress ())
 			{
-				connection->node->process_active (std::move (block));
+				connection->node->block_arrival.add (block->hash ());
+				queue_block (std::move (block));
+			}
+			else
+			{
+				receive ();
 			}
-			receive ();
 		}
 		else
 		{
@@ -2070,6 +2599,23 @@ void rai::bulk_push_server::received_block (boost::system::error_code const & ec
 	}
 }
 
+void rai::bulk_push_server::queue_block (std::shared_ptr<rai::block> block_a)
+{
+	std::vector<rai::block_processor_item> items (1, rai::block_processor_item (block_a));
+	if (connection->node->block_processor.add (items, rai::block_origin::bootstrap) != 0)
+	{
+		receive ();
+	}
+	else
+	{
+		// The bootstrap lane is full, leave the rest in the socket until it drains
+		auto this_l (shared_from_this ());
+		connection->node->alarm.add (std::chrono::steady_clock::now () + std::chrono::milliseconds (50), [this_l, block_a]() {
+			this_l->queue_block (block_a);
+		});
+	}
+}
+
 rai::frontier_req_server::frontier_req_server (std::shared_ptr<rai::bootstrap_server> const & connection_a, std::unique_ptr<rai::frontier_req> request_a) :
 connection (connection_a),
 current (request_a->start.number () - 1),
@@ -63,6 +63,9 @@ class pull_info
 public:
 	pull_info ();
 	pull_info (rai::account const &, rai::block_hash const &, rai::block_hash const &);
+	// Account is the key the pull is stored under and isn't part of the serialized value
+	void serialize (rai::stream &) const;
+	bool deserialize (rai::stream &);
 	rai::account account;
 	rai::block_hash head;
 	rai::block_hash end;
@@ -92,6 +95,18 @@ public:
 	void try_resolve_fork (MDB_txn *, std::shared_ptr<rai::block>, bool);
 	void resolve_forks ();
 	unsigned target_connections (size_t pulls_remaining);
+	// Records a scheduling decision for the bootstrap_status RPC, mutex must be held
+	void decide (std::string const &);
+	// Loads the frontier cursor and outstanding pulls left by an earlier attempt
+	void restore ();
+	// Writes pull and frontier progress changed since the last flush, mutex must be held for the record functions
+	// Optionally waits for the write to commit, io threads shouldn't
+	void flush_progress (bool);
+	void ongoing_flush_progress ();
+	void record_pull (rai::pull_info const &);
+	void record_pull_done (rai::account const &);
+	// Marks the pull done once its last queued block has been processed
+	void record_pull_done (rai::account const &, std::shared_future<void> const &);
 	std::deque<std::weak_ptr<rai::bootstrap_client>> clients;
 	std::weak_ptr<rai::bootstrap_client> connection_frontier_request;
 	std::weak_ptr<rai::frontier_req_client> frontiers;
@@ -104,6 +119,21 @@ public:
 	std::atomic<unsigned> account_count;
 	std::atomic<uint64_t> total_blocks;
 	std::unordered_map<rai::block_hash, std::shared_ptr<rai::block>> unresolved_forks;
+	// Last frontier account resolved and whether the frontier scan completed, saved so a restart resumes from there
+	rai::account frontier_cursor;
+	bool frontiers_complete;
+	// Progress changes not yet written to the bootstrap table
+	std::unordered_map<rai::account, rai::pull_info> progress_puts;
+	std::unordered_set<rai::account> progress_dels;
+	// Pulls that finished streaming, their rows are kept until the block processor has committed their blocks
+	std::unordered_map<rai::account, std::shared_future<void>> progress_pending;
+	// Accounts given a pull this attempt, frontiers re-read after a restore don't schedule them again
+	std::unordered_set<rai::account> pull_accounts;
+	bool progress_dirty;
+	// Connection target from the last scheduler tick and its most recent decisions, newest first
+	unsigned target;
+	std::deque<std::string> decisions;
+	static size_t constexpr decisions_max = 32;
 	bool stopped;
 	std::mutex mutex;
 	std::condition_variable condition;
@@ -116,11 +146,14 @@ public:
 	void run ();
 	void receive_frontier ();
 	void received_frontier (boost::system::error_code const &, size_t);
+	void process_frontiers (std::vector<std::pair<rai::account, rai::block_hash>> const &, bool);
 	void request_account (rai::account const &, rai::block_hash const &);
 	void unsynced (MDB_txn *, rai::account const &, rai::block_hash const &);
 	void next (MDB_txn *);
 	void insert_pull (rai::pull_info const &);
 	std::shared_ptr<rai::bootstrap_client> connection;
+	// Frontier cursor the request continues after, zero scans from the start
+	rai::account resume;
 	rai::account current;
 	rai::account_info info;
 	unsigned count;
@@ -129,6 +162,10 @@ public:
 	std::chrono::steady_clock::time_point start_time;
 	std::chrono::steady_clock::time_point next_report;
 	std::promise<bool> promise;
+	// Frontiers read but not yet processed, a partial frontier may remain between reads
+	std::vector<uint8_t> buffer;
+	size_t buffered;
+	static size_t constexpr frontier_batch = 4096;
 };
 class bulk_pull_client : public std::enable_shared_from_this<rai::bulk_pull_client>
 {
@@ -137,12 +174,25 @@ public:
 	~bulk_pull_client ();
 	void request (rai::pull_info const &);
 	void receive_block ();
-	void received_type ();
 	void received_block (boost::system::error_code const &, size_t);
+	// Hands the backlog to the block processor, reading resumes once all of it has been queued
+	void queue_blocks (bool, bool);
+	// Serialized size of a block body following its type byte, zero for types that aren't blocks
+	static size_t block_size (rai::block_type);
 	rai::block_hash first ();
 	std::shared_ptr<rai::bootstrap_client> connection;
 	rai::block_hash expected;
 	rai::pull_info pull;
+	// When the request was sent, cleared once the first response arrives
+	std::chrono::steady_clock::time_point requested;
+	// Received bytes not yet parsed, at most one partial block remains between reads
+	std::vector<uint8_t> buffer;
+	size_t buffered;
+	// Parsed blocks the block processor had no room for yet
+	std::vector<std::shared_ptr<rai::block>> backlog;
+	// Ready once the last block handed to the block processor has been processed
+	std::shared_future<void> processed;
+	static size_t constexpr chunk_size = 64 * 1024;
 };
 class bootstrap_client : public std::enable_shared_from_this<bootstrap_client>
 {
@@ -156,6 +206,12 @@ public:
 	void stop (bool force);
 	double block_rate () const;
 	double elapsed_seconds () const;
+	// Updates the smoothed block rate, inactive periods only move the baseline
+	void sample (std::chrono::steady_clock::time_point, bool);
+	void rtt_sample (std::chrono::steady_clock::duration);
+	double error_rate () const;
+	// Smoothed blocks per second discounted by failed pulls and round trip time, idle connections are handed out best first
+	double score () const;
 	std::shared_ptr<rai::node> node;
 	std::shared_ptr<rai::bootstrap_attempt> attempt;
 	boost::asio::ip::tcp::socket socket;
@@ -166,6 +222,13 @@ public:
 	std::atomic<uint64_t> block_count;
 	std::atomic<bool> pending_stop;
 	std::atomic<bool> hard_stop;
+	// Written by the scheduler tick under the attempt mutex, read under it by score () callers
+	double rate;
+	uint64_t sampled_blocks;
+	std::chrono::steady_clock::time_point sampled_time;
+	std::atomic<uint64_t> rtt_microseconds;
+	std::atomic<uint64_t> pulls_completed;
+	std::atomic<uint64_t> pulls_failed;
 };
 class bulk_push_client : public std::enable_shared_from_this<rai::bulk_push_client>
 {
@@ -191,6 +254,7 @@ public:
 	void notify_listeners (bool);
 	void add_observer (std::function<void(bool)> const &);
 	bool in_progress ();
+	std::shared_ptr<rai::bootstrap_attempt> current_attempt ();
 	void process_fork (MDB_txn *, std::shared_ptr<rai::block>);
 	void stop ();
 	rai::node & node;
@@ -243,20 +307,35 @@ public:
 	std::queue<std::unique_ptr<rai::message>> requests;
 };
 class bulk_pull;
+/**
+ * Streams an account chain in chunks, each read under one transaction, while earlier chunks are being written
+ * Only one write may be outstanding on the socket so every chunk ready when it completes goes out in a single gathered write
+ */
 class bulk_pull_server : public std::enable_shared_from_this<rai::bulk_pull_server>
 {
 public:
 	bulk_pull_server (std::shared_ptr<rai::bootstrap_server> const &, std::unique_ptr<rai::bulk_pull>);
 	void set_current_end ();
-	std::unique_ptr<rai::block> get_next ();
+	std::shared_ptr<rai::block const> get_next ();
+	std::shared_ptr<rai::block const> get_next (MDB_txn *);
 	void send_next ();
+	// Serializes the next chunk and queues it, the last ends with not_a_block
+	void fill ();
+	// Reads the next chunk on a background thread unless a read is running, the pull is finished or chunks_max are waiting
+	void read_ahead ();
+	void write ();
 	void sent_action (boost::system::error_code const &, size_t);
-	void send_finished ();
-	void no_block_sent (boost::system::error_code const &, size_t);
 	std::shared_ptr<rai::bootstrap_server> connection;
 	std::unique_ptr<rai::bulk_pull> request;
-	std::vector<uint8_t> send_buffer;
 	rai::block_hash current;
+	std::mutex mutex;
+	std::deque<std::vector<uint8_t>> chunks;
+	std::deque<std::vector<uint8_t>> sending;
+	bool writing;
+	bool filling;
+	bool finished;
+	static size_t constexpr chunk_size = 128 * 1024;
+	static size_t constexpr chunks_max = 4;
 };
 class bulk_pull_blocks;
 class bulk_pull_blocks_server : public std::enable_shared_from_this<rai::bulk_pull_blocks_server>
@@ -285,6 +364,8 @@ public:
 	void receive_block ();
 	void received_type ();
 	void received_block (boost::system::error_code const &, size_t);
+	// Queues on the bootstrap lane, reading resumes once the block is queued
+	void queue_block (std::shared_ptr<rai::block>);
 	std::array<uint8_t, 256> receive_buffer;
 	std::shared_ptr<rai::bootstrap_server> connection;
 };
@@ -284,7 +284,7 @@ bool rai::publish::deserialize (rai::stream & stream_a)
 	assert (type == rai::message_type::publish);
 	if (!result)
 	{
-		block = rai::deserialize_block (stream_a, block_type ());
+		block = rai::deserialize_block_pooled (stream_a, block_type ());
 		result = block == nullptr;
 	}
 	return result;
@@ -326,7 +326,7 @@ bool rai::confirm_req::deserialize (rai::stream & stream_a)
 	assert (type == rai::message_type::confirm_req);
 	if (!result)
 	{
-		block = rai::deserialize_block (stream_a, block_type ());
+		block = rai::deserialize_block_pooled (stream_a, block_type ());
 		result = block == nullptr;
 	}
 	return result;
@@ -351,7 +351,7 @@ bool rai::confirm_req::operator== (rai::confirm_req const & other_a) const
 
 rai::confirm_ack::confirm_ack (bool & error_a, rai::stream & stream_a) :
 message (error_a, stream_a),
-vote (std::make_shared<rai::vote> (error_a, stream_a, block_type ()))
+vote (std::allocate_shared<rai::vote> (rai::pool_allocator<rai::vote> (), error_a, stream_a, block_type ()))
 {
 }
 
@@ -378,7 +378,7 @@ bool rai::confirm_ack::deserialize (rai::stream & stream_a)
 				result = read (stream_a, vote->sequence);
 				if (!result)
 				{
-					vote->block = rai::deserialize_block (stream_a, block_type ());
+					vote->block = rai::deserialize_block_pooled (stream_a, block_type ());
 					result = vote->block == nullptr;
 				}
 			}
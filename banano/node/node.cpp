@@ -31,6 +31,12 @@ std::chrono::minutes constexpr rai::node::backup_interval;
 int constexpr rai::port_mapping::mapping_timeout;
 int constexpr rai::port_mapping::check_timeout;
 unsigned constexpr rai::active_transactions::announce_interval_ms;
+size_t constexpr rai::signature_checker::batch_size;
+size_t constexpr rai::block_processor::batch_size;
+size_t constexpr rai::block_processor::wallet_capacity;
+size_t constexpr rai::vote_processor::max_votes;
+size_t constexpr rai::vote_processor::batch_size;
+uint64_t constexpr rai::vote_processor::replay_window;
 
 rai::message_statistics::message_statistics () :
 keepalive (0),
@@ -40,8 +46,308 @@ confirm_ack (0)
 {
 }
 
+uint64_t rai::message_statistics::get (rai::message_type type_a) const
+{
+	uint64_t result (0);
+	switch (type_a)
+	{
+		case rai::message_type::keepalive:
+			result = keepalive;
+			break;
+		case rai::message_type::publish:
+			result = publish;
+			break;
+		case rai::message_type::confirm_req:
+			result = confirm_req;
+			break;
+		case rai::message_type::confirm_ack:
+			result = confirm_ack;
+			break;
+		default:
+			break;
+	}
+	return result;
+}
+
+void rai::message_statistics::add (rai::message_type type_a, uint64_t count_a)
+{
+	switch (type_a)
+	{
+		case rai::message_type::keepalive:
+			keepalive += count_a;
+			break;
+		case rai::message_type::publish:
+			publish += count_a;
+			break;
+		case rai::message_type::confirm_req:
+			confirm_req += count_a;
+			break;
+		case rai::message_type::confirm_ack:
+			confirm_ack += count_a;
+			break;
+		default:
+			break;
+	}
+}
+
+rai::datagram_batch::datagram_batch (std::shared_ptr<std::vector<uint8_t>> buffer_a, std::vector<rai::endpoint> const & targets_a, std::function<void(boost::system::error_code const &, size_t)> const & callback_a) :
+buffer (buffer_a),
+targets (targets_a),
+position (0),
+sent (0),
+callback (callback_a)
+{
+}
+
+rai::network_socket::network_socket (rai::network & network_a, uint16_t port_a, bool shared_a) :
+network (network_a),
+work (new boost::asio::io_service::work (service)),
+datagrams (network_a.node.config.udp_receive_batch > 1 ? network_a.node.config.udp_receive_batch : 0),
+socket (service),
+shared (false),
+batches (0),
+batch_errors (0)
+{
+	rai::endpoint endpoint_l (boost::asio::ip::address_v6::any (), port_a);
+	socket.open (endpoint_l.protocol ());
+	if (shared_a)
+	{
+		boost::system::error_code ec;
+		rai::reuse_port (socket, ec);
+		shared = !ec;
+	}
+	socket.bind (endpoint_l);
+	thread = std::thread ([this]() {
+		try
+		{
+			service.run ();
+		}
+		catch (...)
+		{
+			assert (false && "Unhandled network service exception");
+		}
+	});
+}
+
+rai::network_socket::~network_socket ()
+{
+	stop ();
+	if (thread.joinable ())
+	{
+		thread.join ();
+	}
+}
+
+void rai::network_socket::stop ()
+{
+	{
+		std::lock_guard<std::mutex> lock (socket_mutex);
+		boost::system::error_code ec;
+		socket.close (ec);
+	}
+	work.reset ();
+}
+
+void rai::network_socket::receive ()
+{
+	if (network.node.config.logging.network_packet_logging ())
+	{
+		BOOST_LOG (network.node.log) << "Receiving packet";
+	}
+	std::unique_lock<std::mutex> lock (socket_mutex);
+	if (!datagrams.empty ())
+	{
+		socket.async_wait (boost::asio::ip::udp::socket::wait_read, [this](boost::system::error_code const & error) {
+			receive_batch_action (error);
+		});
+	}
+	else
+	{
+		socket.async_receive_from (boost::asio::buffer (buffer.data (), buffer.size ()), remote, [this](boost::system::error_code const & error, size_t size_a) {
+			receive_action (error, size_a);
+		});
+	}
+}
+
+void rai::network_socket::receive_action (boost::system::error_code const & error, size_t size_a)
+{
+	auto & node (network.node);
+	if (!error && network.on)
+	{
+		network.process_datagram (remote, buffer.data (), size_a, incoming);
+		receive ();
+	}
+	else
+	{
+		if (error)
+		{
+			if (node.config.logging.network_logging ())
+			{
+				BOOST_LOG (node.log) << boost::str (boost::format ("UDP Receive error: %1%") % error.message ());
+			}
+		}
+		if (network.on)
+		{
+			node.alarm.add (std::chrono::steady_clock::now () + std::chrono::seconds (5), [this]() { receive (); });
+		}
+	}
+}
+
+void rai::network_socket::receive_batch_action (boost::system::error_code const & error_a)
+{
+	auto & node (network.node);
+	auto error (error_a);
+	if (!error && network.on)
+	{
+		auto count (rai::receive_datagrams (socket, datagrams, error));
+		for (size_t i (0); i < count; ++i)
+		{
+			auto & datagram (datagrams[i]);
+			network.process_datagram (datagram.endpoint, datagram.buffer.data (), datagram.size, incoming);
+		}
+		if (error == boost::asio::error::operation_not_supported)
+		{
+			// Fall back to reading one datagram at a time
+			datagrams.clear ();
+			error = boost::system::error_code ();
+		}
+	}
+	if (!error && network.on)
+	{
+		receive ();
+	}
+	else
+	{
+		if (error)
+		{
+			if (node.config.logging.network_logging ())
+			{
+				BOOST_LOG (node.log) << boost::str (boost::format ("UDP Receive error: %1%") % error.message ());
+			}
+		}
+		if (network.on)
+		{
+			node.alarm.add (std::chrono::steady_clock::now () + std::chrono::seconds (5), [this]() { receive (); });
+		}
+	}
+}
+
+void rai::network_socket::send_buffer (uint8_t const * data_a, size_t size_a, rai::endpoint const & endpoint_a, std::function<void(boost::system::error_code const &, size_t)> callback_a)
+{
+	std::unique_lock<std::mutex> lock (socket_mutex);
+	if (network.node.config.logging.network_packet_logging ())
+	{
+		BOOST_LOG (network.node.log) << "Sending packet";
+	}
+	socket.async_send_to (boost::asio::buffer (data_a, size_a), endpoint_a, [this, callback_a](boost::system::error_code const & ec, size_t size_a) {
+		callback_a (ec, size_a);
+		if (network.node.config.logging.network_packet_logging ())
+		{
+			BOOST_LOG (network.node.log) << "Packet send complete";
+		}
+	});
+}
+
+void rai::network_socket::send_batch (std::shared_ptr<rai::datagram_batch> batch_a)
+{
+	service.post ([this, batch_a]() { send_batch_next (batch_a); });
+}
+
+void rai::network_socket::send_batch_next (std::shared_ptr<rai::datagram_batch> batch_a)
+{
+	auto blocked (false);
+	auto unsupported (false);
+	{
+		std::lock_guard<std::mutex> lock (socket_mutex);
+		while (batch_a->position < batch_a->targets.size () && !blocked && !unsupported)
+		{
+			boost::system::error_code ec;
+			auto count (rai::send_datagrams (socket, batch_a->buffer->data (), batch_a->buffer->size (), batch_a->targets.data () + batch_a->position, batch_a->targets.size () - batch_a->position, ec));
+			batch_a->position += count;
+			batch_a->sent += count;
+			if (ec == boost::asio::error::operation_not_supported)
+			{
+				unsupported = true;
+			}
+			else if (ec)
+			{
+				if (!batch_a->error)
+				{
+					batch_a->error = ec;
+				}
+				// Skip the peer that failed
+				++batch_a->position;
+			}
+			else if (count == 0)
+			{
+				blocked = true;
+			}
+		}
+	}
+	if (unsupported)
+	{
+		send_batch_single (batch_a);
+	}
+	else if (blocked)
+	{
+		std::lock_guard<std::mutex> lock (socket_mutex);
+		socket.async_wait (boost::asio::ip::udp::socket::wait_write, [this, batch_a](boost::system::error_code const & ec) {
+			if (!ec)
+			{
+				send_batch_next (batch_a);
+			}
+			else
+			{
+				if (!batch_a->error)
+				{
+					batch_a->error = ec;
+				}
+				send_batch_finish (batch_a);
+			}
+		});
+	}
+	else
+	{
+		send_batch_finish (batch_a);
+	}
+}
+
+void rai::network_socket::send_batch_single (std::shared_ptr<rai::datagram_batch> batch_a)
+{
+	// Completion handlers all run on this socket's thread so the batch needs no locking
+	auto remaining (std::make_shared<size_t> (batch_a->targets.size () - batch_a->position));
+	std::lock_guard<std::mutex> lock (socket_mutex);
+	for (auto i (batch_a->targets.begin () + batch_a->position), n (batch_a->targets.end ()); i != n; ++i)
+	{
+		socket.async_send_to (boost::asio::buffer (batch_a->buffer->data (), batch_a->buffer->size ()), *i, [this, batch_a, remaining](boost::system::error_code const & ec, size_t) {
+			if (!ec)
+			{
+				++batch_a->sent;
+			}
+			else if (!batch_a->error)
+			{
+				batch_a->error = ec;
+			}
+			if (--*remaining == 0)
+			{
+				send_batch_finish (batch_a);
+			}
+		});
+	}
+	batch_a->position = batch_a->targets.size ();
+}
+
+void rai::network_socket::send_batch_finish (std::shared_ptr<rai::datagram_batch> batch_a)
+{
+	++batches;
+	if (batch_a->error)
+	{
+		++batch_errors;
+	}
+	batch_a->callback (batch_a->error, batch_a->sent);
+}
+
 rai::network::network (rai::node & node_a, uint16_t port) :
-socket (node_a.service, rai::endpoint (boost::asio::ip::address_v6::any (), port)),
 resolver (node_a.service),
 node (node_a),
 bad_sender_count (0),
@@ -49,27 +355,59 @@ on (true),
 insufficient_work_count (0),
 error_count (0)
 {
+	auto count (std::max<unsigned> (1, node_a.config.udp_sockets));
+	sockets.push_back (std::unique_ptr<rai::network_socket> (new rai::network_socket (*this, port, count > 1)));
+	// Later sockets bind to whatever port the first one got, which matters when binding to port 0
+	auto port_l (sockets.front ()->socket.local_endpoint ().port ());
+	for (auto i (1u); i < count && sockets.front ()->shared; ++i)
+	{
+		sockets.push_back (std::unique_ptr<rai::network_socket> (new rai::network_socket (*this, port_l, true)));
+	}
 }
 
 void rai::network::receive ()
 {
-	if (node.config.logging.network_packet_logging ())
+	for (auto & i : sockets)
 	{
-		BOOST_LOG (node.log) << "Receiving packet";
+		i->receive ();
 	}
-	std::unique_lock<std::mutex> lock (socket_mutex);
-	socket.async_receive_from (boost::asio::buffer (buffer.data (), buffer.size ()), remote, [this](boost::system::error_code const & error, size_t size_a) {
-		receive_action (error, size_a);
-	});
 }
 
 void rai::network::stop ()
 {
 	on = false;
-	socket.close ();
+	for (auto & i : sockets)
+	{
+		i->stop ();
+	}
 	resolver.cancel ();
 }
 
+rai::network_socket & rai::network::socket_for (rai::endpoint const & endpoint_a)
+{
+	return *sockets[std::hash<rai::endpoint> () (endpoint_a) % sockets.size ()];
+}
+
+uint64_t rai::network::incoming_count (rai::message_type type_a)
+{
+	uint64_t result (0);
+	for (auto & i : sockets)
+	{
+		result += i->incoming.get (type_a);
+	}
+	return result;
+}
+
+uint64_t rai::network::outgoing_count (rai::message_type type_a)
+{
+	uint64_t result (0);
+	for (auto & i : sockets)
+	{
+		result += i->outgoing.get (type_a);
+	}
+	return result;
+}
+
 void rai::network::send_keepalive (rai::endpoint const & endpoint_a)
 {
 	assert (endpoint_a.address ().is_v6 ());
@@ -84,7 +422,7 @@ void rai::network::send_keepalive (rai::endpoint const & endpoint_a)
 	{
 		BOOST_LOG (node.log) << boost::str (boost::format ("Keepalive req sent to %1%") % endpoint_a);
 	}
-	++outgoing.keepalive;
+	++socket_for (endpoint_a).outgoing.keepalive;
 	std::weak_ptr<rai::node> node_w (node.shared ());
 	send_buffer (bytes->data (), bytes->size (), endpoint_a, [bytes, node_w, endpoint_a](boost::system::error_code const & ec, size_t) {
 		if (auto node_l = node_w.lock ())
@@ -122,7 +460,7 @@ void rai::node::keepalive (std::string const & address_a, uint16_t port_a)
 
 void rai::network::republish (rai::block_hash const & hash_a, std::shared_ptr<std::vector<uint8_t>> buffer_a, rai::endpoint endpoint_a)
 {
-	++outgoing.publish;
+	++socket_for (endpoint_a).outgoing.publish;
 	if (node.config.logging.network_publish_logging ())
 	{
 		BOOST_LOG (node.log) << boost::str (boost::format ("Publishing %1% to %2%") % hash_a.to_string () % endpoint_a);
@@ -149,10 +487,16 @@ void rai::network::rebroadcast_reps (std::shared_ptr<rai::block> block_a)
 		message.serialize (stream);
 	}
 	auto representatives (node.peers.representatives (2 * node.peers.size_sqrt ()));
-	for (auto i : representatives)
+	std::vector<rai::endpoint> targets;
+	for (auto & i : representatives)
+	{
+		targets.push_back (i.endpoint);
+	}
+	if (node.config.logging.network_publish_logging ())
 	{
-		republish (hash, bytes, i.endpoint);
+		BOOST_LOG (node.log) << boost::str (boost::format ("Publishing %1% to %2% representatives") % hash.to_string () % targets.size ());
 	}
+	broadcast (bytes, targets, rai::message_type::publish);
 }
 
 template <typename T>
@@ -170,10 +514,11 @@ bool confirm_block (MDB_txn * transaction_a, rai::node & node_a, T & list_a, std
 				rai::vectorstream stream (*bytes);
 				confirm.serialize (stream);
 			}
-			for (auto j (list_a.begin ()), m (list_a.end ()); j != m; ++j)
+			if (node_a.config.logging.network_publish_logging ())
 			{
-				node_a.network.confirm_send (confirm, bytes, *j);
+				BOOST_LOG (node_a.log) << boost::str (boost::format ("Sending confirm_ack for block %1% to %2% peers sequence %3%") % block_a->hash ().to_string () % list_a.size () % std::to_string (vote->sequence));
 			}
+			node_a.network.broadcast (bytes, std::vector<rai::endpoint> (list_a.begin (), list_a.end ()), rai::message_type::confirm_ack);
 		});
 	}
 	return result;
@@ -201,11 +546,11 @@ void rai::network::republish_block (MDB_txn * transaction, std::shared_ptr<rai::
 			rai::vectorstream stream (*bytes);
 			message.serialize (stream);
 		}
-		auto hash (block->hash ());
-		for (auto i (list.begin ()), n (list.end ()); i != n; ++i)
+		if (node.config.logging.network_publish_logging ())
 		{
-			republish (hash, bytes, *i);
+			BOOST_LOG (node.log) << boost::str (boost::format ("Publishing %1% to %2% peers") % hash.to_string () % list.size ());
 		}
+		broadcast (bytes, list, rai::message_type::publish);
 		if (node.config.logging.network_logging ())
 		{
 			BOOST_LOG (node.log) << boost::str (boost::format ("Block %1% was republished to peers") % hash.to_string ());
@@ -236,22 +581,26 @@ void rai::network::republish_vote (std::chrono::steady_clock::time_point const &
 				rai::vectorstream stream (*bytes);
 				confirm.serialize (stream);
 			}
-			auto list (node.peers.list_sqrt ());
-			for (auto j (list.begin ()), m (list.end ()); j != m; ++j)
-			{
-				node.network.confirm_send (confirm, bytes, *j);
-			}
+			broadcast (bytes, node.peers.list_sqrt (), rai::message_type::confirm_ack);
 		}
 	}
 }
 
 void rai::network::broadcast_confirm_req (std::shared_ptr<rai::block> block_a)
 {
+	rai::confirm_req message (block_a);
+	std::shared_ptr<std::vector<uint8_t>> bytes (new std::vector<uint8_t>);
+	{
+		rai::vectorstream stream (*bytes);
+		message.serialize (stream);
+	}
 	auto list (node.peers.representatives (std::numeric_limits<size_t>::max ()));
-	for (auto i (list.begin ()), j (list.end ()); i != j; ++i)
+	std::vector<rai::endpoint> targets;
+	for (auto & i : list)
 	{
-		node.network.send_confirm_req (i->endpoint, block_a);
+		targets.push_back (i.endpoint);
 	}
+	broadcast (bytes, targets, rai::message_type::confirm_req);
 	if (node.config.logging.network_logging ())
 	{
 		BOOST_LOG (node.log) << boost::str (boost::format ("Broadcasted confirm req to %1% representatives") % list.size ());
@@ -271,7 +620,7 @@ void rai::network::send_confirm_req (rai::endpoint const & endpoint_a, std::shar
 		BOOST_LOG (node.log) << boost::str (boost::format ("Sending confirm req to %1%") % endpoint_a);
 	}
 	std::weak_ptr<rai::node> node_w (node.shared ());
-	++outgoing.confirm_req;
+	++socket_for (endpoint_a).outgoing.confirm_req;
 	send_buffer (bytes->data (), bytes->size (), endpoint_a, [bytes, node_w](boost::system::error_code const & ec, size_t size) {
 		if (auto node_l = node_w.lock ())
 		{
@@ -317,9 +666,10 @@ namespace
 class network_message_visitor : public rai::message_visitor
 {
 public:
-	network_message_visitor (rai::node & node_a, rai::endpoint const & sender_a) :
+	network_message_visitor (rai::node & node_a, rai::endpoint const & sender_a, rai::message_statistics & incoming_a) :
 	node (node_a),
-	sender (sender_a)
+	sender (sender_a),
+	incoming (incoming_a)
 	{
 	}
 	virtual ~network_message_visitor () = default;
@@ -329,7 +679,7 @@ public:
 		{
 			BOOST_LOG (node.log) << boost::str (boost::format ("Received keepalive message from %1%") % sender);
 		}
-		++node.network.incoming.keepalive;
+		++incoming.keepalive;
 		node.peers.contacted (sender, message_a.version_using);
 		node.network.merge_peers (message_a.peers);
 	}
@@ -339,7 +689,7 @@ public:
 		{
 			BOOST_LOG (node.log) << boost::str (boost::format ("Publish message from %1% for %2%") % sender % message_a.block->hash ().to_string ());
 		}
-		++node.network.incoming.publish;
+		++incoming.publish;
 		node.peers.contacted (sender, message_a.version_using);
 		node.peers.insert (sender, message_a.version_using);
 		node.process_active (message_a.block);
@@ -350,7 +700,7 @@ public:
 		{
 			BOOST_LOG (node.log) << boost::str (boost::format ("Confirm_req message from %1% for %2%") % sender % message_a.block->hash ().to_string ());
 		}
-		++node.network.incoming.confirm_req;
+		++incoming.confirm_req;
 		node.peers.contacted (sender, message_a.version_using);
 		node.peers.insert (sender, message_a.version_using);
 		node.process_active (message_a.block);
@@ -366,28 +716,11 @@ public:
 		{
 			BOOST_LOG (node.log) << boost::str (boost::format ("Received confirm_ack message from %1% for %2% sequence %3%") % sender % message_a.vote->block->hash ().to_string () % std::to_string (message_a.vote->sequence));
 		}
-		++node.network.incoming.confirm_ack;
+		++incoming.confirm_ack;
 		node.peers.contacted (sender, message_a.version_using);
 		node.peers.insert (sender, message_a.version_using);
 		node.process_active (message_a.vote->block);
-		auto vote (node.vote_processor.vote (message_a.vote, sender));
-		if (vote.code == rai::vote_code::replay)
-		{
-			assert (vote.vote->sequence > message_a.vote->sequence);
-			// This tries to assist rep nodes that have lost track of their highest sequence number by replaying our highest known vote back to them
-			// Only do this if the sequence number is significantly different to account for network reordering
-			// Amplify attack considerations: We're sending out a confirm_ack in response to a confirm_ack for no net traffic increase
-			if (vote.vote->sequence - message_a.vote->sequence > 10000)
-			{
-				rai::confirm_ack confirm (vote.vote);
-				std::shared_ptr<std::vector<uint8_t>> bytes (new std::vector<uint8_t>);
-				{
-					rai::vectorstream stream (*bytes);
-					confirm.serialize (stream);
-				}
-				node.network.confirm_send (confirm, bytes, sender);
-			}
-		}
+		node.vote_processor.vote (message_a.vote, sender);
 	}
 	void bulk_pull (rai::bulk_pull const &) override
 	{
@@ -407,102 +740,85 @@ public:
 	}
 	rai::node & node;
 	rai::endpoint sender;
+	rai::message_statistics & incoming;
 };
 }
 
-void rai::network::receive_action (boost::system::error_code const & error, size_t size_a)
+void rai::network::process_datagram (rai::endpoint const & endpoint_a, uint8_t const * data_a, size_t size_a, rai::message_statistics & incoming_a)
 {
-	if (!error && on)
+	if (!rai::reserved_address (endpoint_a) && endpoint_a != endpoint ())
 	{
-		if (!rai::reserved_address (remote) && remote != endpoint ())
+		network_message_visitor visitor (node, endpoint_a, incoming_a);
+		rai::message_parser parser (visitor, node.work);
+		parser.deserialize_buffer (data_a, size_a);
+		if (parser.status != rai::message_parser::parse_status::success)
 		{
-			network_message_visitor visitor (node, remote);
-			rai::message_parser parser (visitor, node.work);
-			parser.deserialize_buffer (buffer.data (), size_a);
-			if (parser.status != rai::message_parser::parse_status::success)
-			{
-				++error_count;
-
-				if (parser.status == rai::message_parser::parse_status::insufficient_work)
-				{
-					if (node.config.logging.insufficient_work_logging ())
-					{
-						BOOST_LOG (node.log) << "Insufficient work in message";
-					}
+			++error_count;
 
-					++insufficient_work_count;
-				}
-				else if (parser.status == rai::message_parser::parse_status::invalid_message_type)
+			if (parser.status == rai::message_parser::parse_status::insufficient_work)
+			{
+				if (node.config.logging.insufficient_work_logging ())
 				{
-					if (node.config.logging.network_logging ())
-					{
-						BOOST_LOG (node.log) << "Invalid message type in message";
-					}
+					BOOST_LOG (node.log) << "Insufficient work in message";
 				}
-				else if (parser.status == rai::message_parser::parse_status::invalid_header)
+
+				++insufficient_work_count;
+			}
+			else if (parser.status == rai::message_parser::parse_status::invalid_message_type)
+			{
+				if (node.config.logging.network_logging ())
 				{
-					if (node.config.logging.network_logging ())
-					{
-						BOOST_LOG (node.log) << "Invalid header in message";
-					}
+					BOOST_LOG (node.log) << "Invalid message type in message";
 				}
-				else if (parser.status == rai::message_parser::parse_status::invalid_keepalive_message)
+			}
+			else if (parser.status == rai::message_parser::parse_status::invalid_header)
+			{
+				if (node.config.logging.network_logging ())
 				{
-					if (node.config.logging.network_logging ())
-					{
-						BOOST_LOG (node.log) << "Invalid keepalive message";
-					}
+					BOOST_LOG (node.log) << "Invalid header in message";
 				}
-				else if (parser.status == rai::message_parser::parse_status::invalid_publish_message)
+			}
+			else if (parser.status == rai::message_parser::parse_status::invalid_keepalive_message)
+			{
+				if (node.config.logging.network_logging ())
 				{
-					if (node.config.logging.network_logging ())
-					{
-						BOOST_LOG (node.log) << "Invalid publish message";
-					}
+					BOOST_LOG (node.log) << "Invalid keepalive message";
 				}
-				else if (parser.status == rai::message_parser::parse_status::invalid_confirm_req_message)
+			}
+			else if (parser.status == rai::message_parser::parse_status::invalid_publish_message)
+			{
+				if (node.config.logging.network_logging ())
 				{
-					if (node.config.logging.network_logging ())
-					{
-						BOOST_LOG (node.log) << "Invalid confirm_req message";
-					}
+					BOOST_LOG (node.log) << "Invalid publish message";
 				}
-				else if (parser.status == rai::message_parser::parse_status::invalid_confirm_ack_message)
+			}
+			else if (parser.status == rai::message_parser::parse_status::invalid_confirm_req_message)
+			{
+				if (node.config.logging.network_logging ())
 				{
-					if (node.config.logging.network_logging ())
-					{
-						BOOST_LOG (node.log) << "Invalid confirm_ack message";
-					}
+					BOOST_LOG (node.log) << "Invalid confirm_req message";
 				}
-				else
+			}
+			else if (parser.status == rai::message_parser::parse_status::invalid_confirm_ack_message)
+			{
+				if (node.config.logging.network_logging ())
 				{
-					BOOST_LOG (node.log) << "Could not deserialize buffer";
+					BOOST_LOG (node.log) << "Invalid confirm_ack message";
 				}
 			}
-		}
-		else
-		{
-			if (node.config.logging.network_logging ())
+			else
 			{
-				BOOST_LOG (node.log) << boost::str (boost::format ("Reserved sender %1%") % remote.address ().to_string ());
+				BOOST_LOG (node.log) << "Could not deserialize buffer";
 			}
-			++bad_sender_count;
 		}
-		receive ();
 	}
 	else
 	{
-		if (error)
-		{
-			if (node.config.logging.network_logging ())
-			{
-				BOOST_LOG (node.log) << boost::str (boost::format ("UDP Receive error: %1%") % error.message ());
-			}
-		}
-		if (on)
+		if (node.config.logging.network_logging ())
 		{
-			node.alarm.add (std::chrono::steady_clock::now () + std::chrono::seconds (5), [this]() { receive (); });
+			BOOST_LOG (node.log) << boost::str (boost::format ("Reserved sender %1%") % endpoint_a.address ().to_string ());
 		}
+		++bad_sender_count;
 	}
 }
 
@@ -802,8 +1118,27 @@ work_threads (std::max<unsigned> (4, std::thread::hardware_concurrency ())),
 enable_voting (true),
 bootstrap_connections (4),
 bootstrap_connections_max (64),
+signature_checker_threads (std::thread::hardware_concurrency () / 2),
+block_processor_capacity (128 * 1024),
+block_processor_high_water (16 * 1024),
+udp_receive_batch (64),
+udp_sockets (1),
+block_cache_size (64 * 1024),
+unchecked_cache_size (64 * 1024),
+unchecked_ttl (24 * 60 * 60),
+write_batch_size (1024),
+write_batch_interval (100),
 callback_port (0),
-lmdb_max_dbs (128)
+lmdb_max_dbs (128),
+lmdb_nosync (false),
+lmdb_nometasync (false),
+lmdb_writemap (false),
+lmdb_nordahead (false),
+lmdb_map_size (1ULL * 1024 * 1024 * 1024 * 1024),
+lmdb_sync_interval (30),
+bootstrap_fast_mode (false),
+block_info_stride (32),
+block_info_dense_threshold (0)
 {
 	switch (rai::rai_network)
 	{
@@ -826,7 +1161,7 @@ lmdb_max_dbs (128)
 
 void rai::node_config::serialize_json (boost::property_tree::ptree & tree_a) const
 {
-	tree_a.put ("version", "9");
+	tree_a.put ("version", "18");
 	tree_a.put ("peering_port", std::to_string (peering_port));
 	tree_a.put ("bootstrap_fraction_numerator", std::to_string (bootstrap_fraction_numerator));
 	tree_a.put ("receive_minimum", receive_minimum.to_string_dec ());
@@ -864,10 +1199,29 @@ void rai::node_config::serialize_json (boost::property_tree::ptree & tree_a) con
 	tree_a.put ("enable_voting", enable_voting);
 	tree_a.put ("bootstrap_connections", bootstrap_connections);
 	tree_a.put ("bootstrap_connections_max", bootstrap_connections_max);
+	tree_a.put ("signature_checker_threads", signature_checker_threads);
+	tree_a.put ("block_processor_capacity", block_processor_capacity);
+	tree_a.put ("block_processor_high_water", block_processor_high_water);
+	tree_a.put ("udp_receive_batch", udp_receive_batch);
+	tree_a.put ("udp_sockets", udp_sockets);
+	tree_a.put ("block_cache_size", block_cache_size);
+	tree_a.put ("unchecked_cache_size", unchecked_cache_size);
+	tree_a.put ("unchecked_ttl", unchecked_ttl);
+	tree_a.put ("write_batch_size", write_batch_size);
+	tree_a.put ("write_batch_interval", write_batch_interval);
 	tree_a.put ("callback_address", callback_address);
 	tree_a.put ("callback_port", std::to_string (callback_port));
 	tree_a.put ("callback_target", callback_target);
 	tree_a.put ("lmdb_max_dbs", lmdb_max_dbs);
+	tree_a.put ("lmdb_nosync", lmdb_nosync);
+	tree_a.put ("lmdb_nometasync", lmdb_nometasync);
+	tree_a.put ("lmdb_writemap", lmdb_writemap);
+	tree_a.put ("lmdb_nordahead", lmdb_nordahead);
+	tree_a.put ("lmdb_map_size", std::to_string (lmdb_map_size));
+	tree_a.put ("lmdb_sync_interval", lmdb_sync_interval);
+	tree_a.put ("bootstrap_fast_mode", bootstrap_fast_mode);
+	tree_a.put ("block_info_stride", std::to_string (block_info_stride));
+	tree_a.put ("block_info_dense_threshold", std::to_string (block_info_dense_threshold));
 }
 
 bool rai::node_config::upgrade_json (unsigned version, boost::property_tree::ptree & tree_a)
@@ -942,9 +1296,64 @@ bool rai::node_config::upgrade_json (unsigned version, boost::property_tree::ptr
 			tree_a.put ("version", "9");
 			result = true;
 		case 9:
-			break;
-		default:
-			throw std::runtime_error ("Unknown node_config version");
+			tree_a.put ("signature_checker_threads", std::to_string (signature_checker_threads));
+			tree_a.erase ("version");
+			tree_a.put ("version", "10");
+			result = true;
+		case 10:
+			tree_a.put ("block_processor_capacity", std::to_string (block_processor_capacity));
+			tree_a.put ("block_processor_high_water", std::to_string (block_processor_high_water));
+			tree_a.erase ("version");
+			tree_a.put ("version", "11");
+			result = true;
+		case 11:
+			tree_a.put ("udp_receive_batch", std::to_string (udp_receive_batch));
+			tree_a.erase ("version");
+			tree_a.put ("version", "12");
+			result = true;
+		case 12:
+			tree_a.put ("udp_sockets", std::to_string (udp_sockets));
+			tree_a.erase ("version");
+			tree_a.put ("version", "13");
+			result = true;
+		case 13:
+			tree_a.put ("block_cache_size", std::to_string (block_cache_size));
+			tree_a.erase ("version");
+			tree_a.put ("version", "14");
+			result = true;
+		case 14:
+			tree_a.put ("unchecked_cache_size", std::to_string (unchecked_cache_size));
+			tree_a.put ("unchecked_ttl", std::to_string (unchecked_ttl));
+			tree_a.erase ("version");
+			tree_a.put ("version", "15");
+			result = true;
+		case 15:
+			tree_a.put ("write_batch_size", std::to_string (write_batch_size));
+			tree_a.put ("write_batch_interval", std::to_string (write_batch_interval));
+			tree_a.erase ("version");
+			tree_a.put ("version", "16");
+			result = true;
+		case 16:
+			tree_a.put ("lmdb_nosync", lmdb_nosync);
+			tree_a.put ("lmdb_nometasync", lmdb_nometasync);
+			tree_a.put ("lmdb_writemap", lmdb_writemap);
+			tree_a.put ("lmdb_nordahead", lmdb_nordahead);
+			tree_a.put ("lmdb_map_size", std::to_string (lmdb_map_size));
+			tree_a.put ("lmdb_sync_interval", std::to_string (lmdb_sync_interval));
+			tree_a.put ("bootstrap_fast_mode", bootstrap_fast_mode);
+			tree_a.erase ("version");
+			tree_a.put ("version", "17");
+			result = true;
+		case 17:
+			tree_a.put ("block_info_stride", std::to_string (block_info_stride));
+			tree_a.put ("block_info_dense_threshold", std::to_string (block_info_dense_threshold));
+			tree_a.erase ("version");
+			tree_a.put ("version", "18");
+			result = true;
+		case 18:
+			break;
+		default:
+			throw std::runtime_error ("Unknown node_config version");
 	}
 	return result;
 }
@@ -1010,10 +1419,29 @@ bool rai::node_config::deserialize_json (bool & upgraded_a, boost::property_tree
 		enable_voting = tree_a.get<bool> ("enable_voting");
 		auto bootstrap_connections_l (tree_a.get<std::string> ("bootstrap_connections"));
 		auto bootstrap_connections_max_l (tree_a.get<std::string> ("bootstrap_connections_max"));
+		auto signature_checker_threads_l (tree_a.get<std::string> ("signature_checker_threads"));
+		auto block_processor_capacity_l (tree_a.get<std::string> ("block_processor_capacity"));
+		auto block_processor_high_water_l (tree_a.get<std::string> ("block_processor_high_water"));
+		auto udp_receive_batch_l (tree_a.get<std::string> ("udp_receive_batch"));
+		auto udp_sockets_l (tree_a.get<std::string> ("udp_sockets"));
+		auto block_cache_size_l (tree_a.get<std::string> ("block_cache_size"));
+		auto unchecked_cache_size_l (tree_a.get<std::string> ("unchecked_cache_size"));
+		auto unchecked_ttl_l (tree_a.get<std::string> ("unchecked_ttl"));
+		auto write_batch_size_l (tree_a.get<std::string> ("write_batch_size"));
+		auto write_batch_interval_l (tree_a.get<std::string> ("write_batch_interval"));
 		callback_address = tree_a.get<std::string> ("callback_address");
 		auto callback_port_l (tree_a.get<std::string> ("callback_port"));
 		callback_target = tree_a.get<std::string> ("callback_target");
 		auto lmdb_max_dbs_l = tree_a.get<std::string> ("lmdb_max_dbs");
+		lmdb_nosync = tree_a.get<bool> ("lmdb_nosync");
+		lmdb_nometasync = tree_a.get<bool> ("lmdb_nometasync");
+		lmdb_writemap = tree_a.get<bool> ("lmdb_writemap");
+		lmdb_nordahead = tree_a.get<bool> ("lmdb_nordahead");
+		auto lmdb_map_size_l (tree_a.get<std::string> ("lmdb_map_size"));
+		auto lmdb_sync_interval_l (tree_a.get<std::string> ("lmdb_sync_interval"));
+		bootstrap_fast_mode = tree_a.get<bool> ("bootstrap_fast_mode");
+		auto block_info_stride_l (tree_a.get<std::string> ("block_info_stride"));
+		auto block_info_dense_threshold_l (tree_a.get<std::string> ("block_info_dense_threshold"));
 		result |= parse_port (callback_port_l, callback_port);
 		try
 		{
@@ -1024,7 +1452,21 @@ bool rai::node_config::deserialize_json (bool & upgraded_a, boost::property_tree
 			work_threads = std::stoul (work_threads_l);
 			bootstrap_connections = std::stoul (bootstrap_connections_l);
 			bootstrap_connections_max = std::stoul (bootstrap_connections_max_l);
+			signature_checker_threads = std::stoul (signature_checker_threads_l);
+			block_processor_capacity = std::stoul (block_processor_capacity_l);
+			block_processor_high_water = std::stoul (block_processor_high_water_l);
+			udp_receive_batch = std::stoul (udp_receive_batch_l);
+			udp_sockets = std::stoul (udp_sockets_l);
+			block_cache_size = std::stoul (block_cache_size_l);
+			unchecked_cache_size = std::stoul (unchecked_cache_size_l);
+			unchecked_ttl = std::stoul (unchecked_ttl_l);
+			write_batch_size = std::stoul (write_batch_size_l);
+			write_batch_interval = std::stoul (write_batch_interval_l);
 			lmdb_max_dbs = std::stoi (lmdb_max_dbs_l);
+			lmdb_map_size = std::stoull (lmdb_map_size_l);
+			lmdb_sync_interval = std::stoul (lmdb_sync_interval_l);
+			block_info_stride = std::stoull (block_info_stride_l);
+			block_info_dense_threshold = std::stoull (block_info_dense_threshold_l);
 			result |= peering_port > std::numeric_limits<uint16_t>::max ();
 			result |= logging.deserialize_json (upgraded_a, logging_l);
 			result |= receive_minimum.decode_dec (receive_minimum_l);
@@ -1033,154 +1475,731 @@ bool rai::node_config::deserialize_json (bool & upgraded_a, boost::property_tree
 			result |= password_fanout > 1024 * 1024;
 			result |= io_threads == 0;
 			result |= work_threads == 0;
+			result |= block_processor_capacity == 0;
+			result |= udp_sockets == 0;
+			result |= block_processor_high_water > block_processor_capacity;
+			result |= unchecked_ttl == 0;
+			result |= write_batch_size == 0;
+			result |= write_batch_interval == 0;
+			result |= lmdb_map_size == 0;
+			result |= block_info_stride == 0;
+		}
+		catch (std::logic_error const &)
+		{
+			result = true;
+		}
+	}
+	catch (std::runtime_error const &)
+	{
+		result = true;
+	}
+	return result;
+}
+
+unsigned rai::node_config::lmdb_flags () const
+{
+	unsigned result (0);
+	result |= lmdb_nosync ? MDB_NOSYNC : 0;
+	result |= lmdb_nometasync ? MDB_NOMETASYNC : 0;
+	result |= lmdb_writemap ? MDB_WRITEMAP : 0;
+	result |= lmdb_nordahead ? MDB_NORDAHEAD : 0;
+	return result;
+}
+
+rai::account rai::node_config::random_representative ()
+{
+	assert (preconfigured_representatives.size () > 0);
+	size_t index (rai::random_pool.GenerateWord32 (0, preconfigured_representatives.size () - 1));
+	auto result (preconfigured_representatives[index]);
+	return result;
+}
+
+rai::vote_processor::vote_processor (rai::node & node_a) :
+node (node_a),
+stopped (false),
+idle (true),
+thread ([this]() { process_loop (); })
+{
+}
+
+rai::vote_processor::~vote_processor ()
+{
+	stop ();
+}
+
+bool rai::vote_processor::vote (std::shared_ptr<rai::vote> vote_a, rai::endpoint endpoint_a)
+{
+	auto result (false);
+	std::lock_guard<std::mutex> lock (mutex);
+	if (!stopped && votes.size () < max_votes)
+	{
+		votes.push_back (std::make_pair (vote_a, endpoint_a));
+		condition.notify_all ();
+	}
+	else
+	{
+		result = true;
+	}
+	return result;
+}
+
+void rai::vote_processor::process_loop ()
+{
+	std::unique_lock<std::mutex> lock (mutex);
+	while (!stopped)
+	{
+		if (!votes.empty ())
+		{
+			std::deque<std::pair<std::shared_ptr<rai::vote>, rai::endpoint>> votes_processing;
+			if (votes.size () <= batch_size)
+			{
+				std::swap (votes, votes_processing);
+			}
+			else
+			{
+				votes_processing.assign (votes.begin (), votes.begin () + batch_size);
+				votes.erase (votes.begin (), votes.begin () + batch_size);
+			}
+			lock.unlock ();
+			process_votes (votes_processing);
+			lock.lock ();
+		}
+		else
+		{
+			idle = true;
+			condition.notify_all ();
+			condition.wait (lock);
+			idle = false;
+		}
+	}
+}
+
+void rai::vote_processor::process_votes (std::deque<std::pair<std::shared_ptr<rai::vote>, rai::endpoint>> & votes_a)
+{
+	std::vector<rai::vote_result> results (votes_a.size (), rai::vote_result ({ rai::vote_code::invalid, nullptr }));
+	std::vector<size_t> indices;
+	{
+		// Replays of a recently seen vote are dropped before paying for a signature check, these are too close to need a replay sent back
+		std::lock_guard<std::mutex> lock (node.store.cache_mutex);
+		for (size_t i (0), n (votes_a.size ()); i < n; ++i)
+		{
+			auto & vote_l (votes_a[i].first);
+			auto existing (node.store.vote_cache.find (vote_l->account));
+			if (existing != node.store.vote_cache.end () && existing->second->sequence > vote_l->sequence && existing->second->sequence - vote_l->sequence <= replay_window)
+			{
+				results[i].code = rai::vote_code::replay;
+				results[i].vote = existing->second;
+			}
+			else
+			{
+				indices.push_back (i);
+			}
+		}
+	}
+	auto size (indices.size ());
+	std::vector<rai::uint256_union> hashes (size);
+	std::vector<unsigned char const *> messages (size);
+	std::vector<size_t> lengths (size, sizeof (rai::uint256_union));
+	std::vector<unsigned char const *> keys (size);
+	std::vector<unsigned char const *> signatures (size);
+	std::vector<int> valid (size, 0);
+	for (size_t i (0); i < size; ++i)
+	{
+		auto & vote_l (votes_a[indices[i]].first);
+		hashes[i] = vote_l->hash ();
+		messages[i] = hashes[i].bytes.data ();
+		keys[i] = vote_l->account.bytes.data ();
+		signatures[i] = vote_l->signature.bytes.data ();
+	}
+	node.checker.verify (size, messages.data (), lengths.data (), keys.data (), signatures.data (), valid.data ());
+	{
+		rai::transaction transaction (node.store.environment, nullptr, false);
+		for (size_t i (0); i < size; ++i)
+		{
+			if (valid[i] == 1)
+			{
+				auto & vote_l (votes_a[indices[i]].first);
+				auto & result (results[indices[i]]);
+				// Make sure this sequence number is > any we've seen from this account before
+				result.vote = node.store.vote_max (transaction, vote_l);
+				result.code = result.vote == vote_l ? rai::vote_code::vote : rai::vote_code::replay;
+			}
+		}
+	}
+	std::vector<std::shared_ptr<rai::vote>> accepted;
+	for (size_t i (0), n (votes_a.size ()); i < n; ++i)
+	{
+		auto & vote_l (votes_a[i].first);
+		auto & result (results[i]);
+		if (node.config.logging.vote_logging ())
+		{
+			char const * status;
+			switch (result.code)
+			{
+				case rai::vote_code::invalid:
+					status = "Invalid";
+					break;
+				case rai::vote_code::replay:
+					status = "Replay";
+					break;
+				case rai::vote_code::vote:
+					status = "Vote";
+					break;
+			}
+			BOOST_LOG (node.log) << boost::str (boost::format ("Vote from: %1% sequence: %2% block: %3% status: %4%") % vote_l->account.to_account () % std::to_string (vote_l->sequence) % vote_l->block->hash ().to_string () % status);
+		}
+		switch (result.code)
+		{
+			case rai::vote_code::vote:
+				accepted.push_back (vote_l);
+				break;
+			case rai::vote_code::replay:
+				assert (result.vote->sequence > vote_l->sequence);
+				// This tries to assist rep nodes that have lost track of their highest sequence number by replaying our highest known vote back to them
+				// Only do this if the sequence number is significantly different to account for network reordering
+				// Amplify attack considerations: We're sending out a confirm_ack in response to a confirm_ack for no net traffic increase
+				if (result.vote->sequence - vote_l->sequence > replay_window)
+				{
+					rai::confirm_ack confirm (result.vote);
+					std::shared_ptr<std::vector<uint8_t>> bytes (new std::vector<uint8_t>);
+					{
+						rai::vectorstream stream (*bytes);
+						confirm.serialize (stream);
+					}
+					node.network.confirm_send (confirm, bytes, votes_a[i].second);
+				}
+				break;
+			case rai::vote_code::invalid:
+				break;
+		}
+	}
+	if (!accepted.empty ())
+	{
+		node.active.vote (accepted);
+	}
+	for (size_t i (0), n (votes_a.size ()); i < n; ++i)
+	{
+		if (results[i].code == rai::vote_code::vote)
+		{
+			node.observers.vote (votes_a[i].first, votes_a[i].second);
+		}
+	}
+}
+
+void rai::vote_processor::flush ()
+{
+	std::unique_lock<std::mutex> lock (mutex);
+	while (!stopped && (!votes.empty () || !idle))
+	{
+		condition.wait (lock);
+	}
+}
+
+void rai::vote_processor::stop ()
+{
+	{
+		std::lock_guard<std::mutex> lock (mutex);
+		stopped = true;
+		condition.notify_all ();
+	}
+	if (thread.joinable ())
+	{
+		thread.join ();
+	}
+}
+
+void rai::rep_crawler::add (rai::block_hash const & hash_a)
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	active.insert (hash_a);
+}
+
+void rai::rep_crawler::remove (rai::block_hash const & hash_a)
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	active.erase (hash_a);
+}
+
+bool rai::rep_crawler::exists (rai::block_hash const & hash_a)
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	return active.count (hash_a) != 0;
+}
+
+rai::block_processor_item::block_processor_item (std::shared_ptr<rai::block> block_a) :
+block_processor_item (block_a, false)
+{
+}
+
+rai::block_processor_item::block_processor_item (std::shared_ptr<rai::block> block_a, bool force_a) :
+block (block_a),
+force (force_a),
+verified (0),
+origin (rai::block_origin::live)
+{
+}
+
+rai::block_processor_lane::block_processor_lane (size_t capacity_a, unsigned weight_a) :
+blocks (capacity_a),
+weight (weight_a),
+processed (0),
+latency_microseconds (0)
+{
+}
+
+rai::signature_checker::signature_checker (unsigned threads_a) :
+stopped (false)
+{
+	for (auto i (0u); i < threads_a; ++i)
+	{
+		threads.push_back (std::thread ([this]() { run (); }));
+	}
+}
+
+rai::signature_checker::~signature_checker ()
+{
+	stop ();
+}
+
+void rai::signature_checker::stop ()
+{
+	{
+		std::lock_guard<std::mutex> lock (mutex);
+		stopped = true;
+		condition.notify_all ();
+	}
+	for (auto & i : threads)
+	{
+		if (i.joinable ())
+		{
+			i.join ();
+		}
+	}
+}
+
+void rai::signature_checker::run ()
+{
+	std::unique_lock<std::mutex> lock (mutex);
+	while (!stopped || !tasks.empty ())
+	{
+		if (!tasks.empty ())
+		{
+			auto task (tasks.front ());
+			tasks.pop_front ();
+			lock.unlock ();
+			task ();
+			lock.lock ();
+		}
+		else
+		{
+			condition.wait (lock);
+		}
+	}
+}
+
+void rai::signature_checker::verify (size_t size_a, unsigned char const ** messages_a, size_t * lengths_a, unsigned char const ** keys_a, unsigned char const ** signatures_a, int * valid_a)
+{
+	std::vector<std::future<void>> pending;
+	{
+		std::lock_guard<std::mutex> lock (mutex);
+		if (!stopped && !threads.empty ())
+		{
+			// The first batch is checked by the calling thread, the rest are handed out
+			for (size_t i (batch_size); i < size_a; i += batch_size)
+			{
+				auto size_l (std::min (batch_size, size_a - i));
+				auto task (std::make_shared<std::packaged_task<void()>> ([messages_a, lengths_a, keys_a, signatures_a, valid_a, i, size_l]() {
+					rai::validate_message_batch (messages_a + i, lengths_a + i, keys_a + i, signatures_a + i, size_l, valid_a + i);
+				}));
+				pending.push_back (task->get_future ());
+				tasks.push_back ([task]() { (*task) (); });
+			}
+			condition.notify_all ();
+		}
+	}
+	auto size_l (pending.empty () ? size_a : std::min (batch_size, size_a));
+	rai::validate_message_batch (messages_a, lengths_a, keys_a, signatures_a, size_l, valid_a);
+	for (auto & i : pending)
+	{
+		i.wait ();
+	}
+}
+
+rai::write_scheduler::write_scheduler (rai::block_store & store_a, boost::log::sources::logger_mt & log_a, size_t batch_size_a, std::chrono::milliseconds interval_a) :
+transactions (0),
+writes (0),
+store (store_a),
+log (log_a),
+batch_size (batch_size_a),
+interval (interval_a),
+stopped (false)
+{
+}
+
+rai::write_scheduler::~write_scheduler ()
+{
+	stop ();
+}
+
+void rai::write_scheduler::stop ()
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	stopped = true;
+	condition.notify_all ();
+}
+
+void rai::write_scheduler::submit (std::function<void(MDB_txn *)> const & write_a)
+{
+	enqueue (write_a, nullptr);
+}
+
+void rai::write_scheduler::submit_wait (std::function<void(MDB_txn *)> const & write_a)
+{
+	auto committed (std::make_shared<std::promise<void>> ());
+	auto future (committed->get_future ());
+	enqueue (write_a, committed);
+	// Rethrows anything the write threw
+	future.get ();
+}
+
+void rai::write_scheduler::write (MDB_txn * transaction_a, std::pair<std::function<void(MDB_txn *)>, std::shared_ptr<std::promise<void>>> const & write_a, std::vector<std::shared_ptr<std::promise<void>>> & committed_a)
+{
+	try
+	{
+		write_a.first (transaction_a);
+		if (write_a.second != nullptr)
+		{
+			committed_a.push_back (write_a.second);
+		}
+	}
+	catch (...)
+	{
+		// The rest of the batch is still committed, other writes have already changed in-memory state alongside the transaction so it can't be replayed
+		if (write_a.second != nullptr)
+		{
+			// The waiter gets the exception instead of hanging
+			write_a.second->set_exception (std::current_exception ());
+		}
+		else
+		{
+			try
+			{
+				throw;
+			}
+			catch (std::exception const & e)
+			{
+				BOOST_LOG (log) << boost::str (boost::format ("Scheduled write failed: %1%") % e.what ());
+			}
+			catch (...)
+			{
+				BOOST_LOG (log) << "Scheduled write failed with an unknown exception";
+			}
+		}
+	}
+}
+
+void rai::write_scheduler::enqueue (std::function<void(MDB_txn *)> const & write_a, std::shared_ptr<std::promise<void>> committed_a)
+{
+	std::unique_lock<std::mutex> lock (mutex);
+	if (!stopped)
+	{
+		queue.push_back (std::make_pair (write_a, committed_a));
+		condition.notify_all ();
+	}
+	else
+	{
+		// The writer thread may have exited, write on the caller's thread instead
+		lock.unlock ();
+		std::vector<std::shared_ptr<std::promise<void>>> committed;
+		{
+			rai::transaction transaction (store.environment, nullptr, true);
+			write (transaction, std::make_pair (write_a, committed_a), committed);
+		}
+		for (auto & i : committed)
+		{
+			i->set_value ();
+		}
+	}
+}
+
+void rai::write_scheduler::run ()
+{
+	std::unique_lock<std::mutex> lock (mutex);
+	// Writes queued before stopping are still committed
+	while (!stopped || !queue.empty ())
+	{
+		if (!queue.empty ())
+		{
+			std::vector<std::shared_ptr<std::promise<void>>> committed;
+			lock.unlock ();
+			{
+				rai::transaction transaction (store.environment, nullptr, true);
+				auto cutoff (std::chrono::steady_clock::now () + interval);
+				size_t count (0);
+				lock.lock ();
+				// At least one write goes into every transaction, the deadline only ends a batch after that
+				do
+				{
+					auto write_l (std::move (queue.front ()));
+					queue.pop_front ();
+					lock.unlock ();
+					write (transaction, write_l, committed);
+					++count;
+					lock.lock ();
+				} while (!queue.empty () && count < batch_size && std::chrono::steady_clock::now () < cutoff);
+				lock.unlock ();
+				++transactions;
+				writes += count;
+			}
+			for (auto & i : committed)
+			{
+				i->set_value ();
+			}
+			lock.lock ();
 		}
-		catch (std::logic_error const &)
+		else
 		{
-			result = true;
+			condition.wait (lock);
 		}
 	}
-	catch (std::runtime_error const &)
-	{
-		result = true;
-	}
-	return result;
 }
 
-rai::account rai::node_config::random_representative ()
+rai::block_processor::block_processor (rai::node & node_a) :
+enqueued (0),
+enqueue_waits (0),
+enqueue_wait_microseconds (0),
+dropped (0),
+waiting (0),
+stopped (false),
+idle (false),
+high_water (node_a.config.block_processor_high_water),
+node (node_a)
 {
-	assert (preconfigured_representatives.size () > 0);
-	size_t index (rai::random_pool.GenerateWord32 (0, preconfigured_representatives.size () - 1));
-	auto result (preconfigured_representatives[index]);
-	return result;
+	// Live traffic is confirmed ahead of wallet and bootstrap blocks when every lane has work
+	// Wallet actions are few and bootstrap backs off at the high-water mark, so only the live lane needs the full capacity
+	size_t capacity (node_a.config.block_processor_capacity);
+	lanes[static_cast<size_t> (rai::block_origin::live)].reset (new rai::block_processor_lane (capacity, 16));
+	lanes[static_cast<size_t> (rai::block_origin::wallet)].reset (new rai::block_processor_lane (std::min (capacity, wallet_capacity), 8));
+	lanes[static_cast<size_t> (rai::block_origin::bootstrap)].reset (new rai::block_processor_lane (std::min (capacity, std::max<size_t> (1, 2 * high_water)), 4));
 }
 
-rai::vote_processor::vote_processor (rai::node & node_a) :
-node (node_a)
+rai::block_processor::~block_processor ()
+{
+	stop ();
+}
+
+void rai::block_processor::stop ()
+{
+	std::lock_guard<std::mutex> lock (mutex);
+	stopped = true;
+	condition.notify_all ();
+	room.notify_all ();
+}
+
+void rai::block_processor::flush ()
 {
+	std::unique_lock<std::mutex> lock (mutex);
+	while (!stopped && (!empty () || !idle))
+	{
+		condition.wait (lock);
+	}
 }
 
-rai::vote_result rai::vote_processor::vote (std::shared_ptr<rai::vote> vote_a, rai::endpoint endpoint_a)
+bool rai::block_processor::add (rai::block_processor_item const & item_a, rai::block_origin origin_a)
 {
-	rai::vote_result result;
+	// Live blocks arrive on network threads which must never stall, they are dropped when their lane is full
+	// Forced blocks are confirmed winners queued from background threads, losing one would keep the losing fork
+	auto drop (origin_a == rai::block_origin::live && !item_a.force);
+	auto result (push (item_a, origin_a, !drop));
+	if (!result)
 	{
-		rai::transaction transaction (node.store.environment, nullptr, false);
-		result = node.store.vote_validate (transaction, vote_a);
+		wake ();
 	}
-	if (node.config.logging.vote_logging ())
+	else if (drop)
 	{
-		char const * status;
-		switch (result.code)
+		++dropped;
+	}
+	return result;
+}
+
+size_t rai::block_processor::add (std::vector<rai::block_processor_item> const & items_a, rai::block_origin origin_a)
+{
+	size_t result (0);
+	auto full (false);
+	for (auto i (items_a.begin ()), n (items_a.end ()); i != n && !full; ++i)
+	{
+		full = push (*i, origin_a, false);
+		if (!full)
 		{
-			case rai::vote_code::invalid:
-				status = "Invalid";
-				break;
-			case rai::vote_code::replay:
-				status = "Replay";
-				break;
-			case rai::vote_code::vote:
-				status = "Vote";
-				break;
+			++result;
 		}
-		BOOST_LOG (node.log) << boost::str (boost::format ("Vote from: %1% sequence: %2% block: %3% status: %4%") % vote_a->account.to_account () % std::to_string (vote_a->sequence) % vote_a->block->hash ().to_string () % status);
 	}
-	switch (result.code)
+	if (result != 0)
 	{
-		case rai::vote_code::vote:
-			node.observers.vote (vote_a, endpoint_a);
-		case rai::vote_code::replay:
-		case rai::vote_code::invalid:
-			break;
+		wake ();
 	}
 	return result;
 }
 
-void rai::rep_crawler::add (rai::block_hash const & hash_a)
+bool rai::block_processor::push (rai::block_processor_item const & item_a, rai::block_origin origin_a, bool wait_a)
 {
-	std::lock_guard<std::mutex> lock (mutex);
-	active.insert (hash_a);
+	auto item_l (item_a);
+	item_l.origin = origin_a;
+	item_l.arrival = std::chrono::steady_clock::now ();
+	auto & blocks (lane (origin_a).blocks);
+	auto result (blocks.push (item_l));
+	if (result && wait_a)
+	{
+		auto start (std::chrono::steady_clock::now ());
+		std::unique_lock<std::mutex> lock (mutex);
+		++waiting;
+		// Pairs with the fence in process_blocks so either the processor sees us waiting or we see the room it made
+		std::atomic_thread_fence (std::memory_order_seq_cst);
+		result = blocks.push (item_l);
+		while (result && !stopped)
+		{
+			room.wait (lock);
+			result = blocks.push (item_l);
+		}
+		--waiting;
+		lock.unlock ();
+		++enqueue_waits;
+		enqueue_wait_microseconds += std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ();
+	}
+	if (!result)
+	{
+		++enqueued;
+	}
+	return result;
 }
 
-void rai::rep_crawler::remove (rai::block_hash const & hash_a)
+void rai::block_processor::wake ()
 {
-	std::lock_guard<std::mutex> lock (mutex);
-	active.erase (hash_a);
+	// Pairs with the fence in process_blocks so either the processor sees these blocks or we see it idle
+	std::atomic_thread_fence (std::memory_order_seq_cst);
+	if (idle)
+	{
+		std::lock_guard<std::mutex> lock (mutex);
+		condition.notify_all ();
+	}
 }
 
-bool rai::rep_crawler::exists (rai::block_hash const & hash_a)
+void rai::block_processor::process_wait (rai::block_processor_item const & item_a)
 {
-	std::lock_guard<std::mutex> lock (mutex);
-	return active.count (hash_a) != 0;
+	auto item_l (item_a);
+	item_l.processed = std::make_shared<std::promise<void>> ();
+	auto future (item_l.processed->get_future ());
+	if (!add (item_l, rai::block_origin::wallet))
+	{
+		while (future.wait_for (std::chrono::milliseconds (100)) != std::future_status::ready)
+		{
+			if (stopped)
+			{
+				// The processing thread may already be gone, release whatever is still queued
+				discard ();
+			}
+		}
+	}
 }
 
-rai::block_processor_item::block_processor_item (std::shared_ptr<rai::block> block_a) :
-block_processor_item (block_a, false)
+void rai::block_processor::discard ()
 {
+	rai::block_processor_item item (nullptr);
+	for (auto & i : lanes)
+	{
+		while (!i->blocks.pop (item))
+		{
+			if (item.processed != nullptr)
+			{
+				// Waiters can tell the block was dropped rather than processed
+				item.processed->set_exception (std::make_exception_ptr (std::runtime_error ("Block processor stopped")));
+			}
+		}
+	}
 }
 
-rai::block_processor_item::block_processor_item (std::shared_ptr<rai::block> block_a, bool force_a) :
-block (block_a),
-force (force_a)
+bool rai::block_processor::saturated () const
 {
+	return lanes[static_cast<size_t> (rai::block_origin::bootstrap)]->blocks.size () >= high_water;
 }
 
-rai::block_processor::block_processor (rai::node & node_a) :
-stopped (false),
-idle (true),
-node (node_a)
+size_t rai::block_processor::size () const
 {
+	size_t result (0);
+	for (auto & i : lanes)
+	{
+		result += i->blocks.size ();
+	}
+	return result;
 }
 
-rai::block_processor::~block_processor ()
+bool rai::block_processor::empty () const
 {
-	stop ();
+	auto result (true);
+	for (auto & i : lanes)
+	{
+		result = result && i->blocks.empty ();
+	}
+	return result;
 }
 
-void rai::block_processor::stop ()
+rai::block_processor_lane & rai::block_processor::lane (rai::block_origin origin_a)
 {
-	std::lock_guard<std::mutex> lock (mutex);
-	stopped = true;
-	condition.notify_all ();
+	return *lanes[static_cast<size_t> (origin_a)];
 }
 
-void rai::block_processor::flush ()
+void rai::block_processor::next_batch (std::deque<rai::block_processor_item> & blocks_a)
 {
-	std::unique_lock<std::mutex> lock (mutex);
-	while (!stopped && (!blocks.empty () || !idle))
+	auto more (true);
+	rai::block_processor_item item (nullptr);
+	while (more && blocks_a.size () < batch_size)
 	{
-		condition.wait (lock);
+		more = false;
+		for (auto & i : lanes)
+		{
+			for (auto j (0u); j < i->weight && !i->blocks.pop (item); ++j)
+			{
+				blocks_a.push_back (std::move (item));
+				more = true;
+			}
+		}
 	}
 }
 
-void rai::block_processor::add (rai::block_processor_item const & item_a)
-{
-	std::lock_guard<std::mutex> lock (mutex);
-	blocks.push_back (item_a);
-	condition.notify_all ();
-}
-
 void rai::block_processor::process_blocks ()
 {
-	std::unique_lock<std::mutex> lock (mutex);
 	while (!stopped)
 	{
-		if (!blocks.empty ())
+		std::deque<rai::block_processor_item> blocks_processing;
+		next_batch (blocks_processing);
+		if (!blocks_processing.empty ())
 		{
-			std::deque<rai::block_processor_item> blocks_processing;
-			std::swap (blocks, blocks_processing);
-			lock.unlock ();
+			std::atomic_thread_fence (std::memory_order_seq_cst);
+			if (waiting > 0)
+			{
+				// Taking the batch made room for anyone waiting on a full lane
+				std::lock_guard<std::mutex> lock (mutex);
+				room.notify_all ();
+			}
+			verify_signatures (blocks_processing);
 			process_receive_many (blocks_processing);
 			// Let other threads get an opportunity to transaction lock
 			std::this_thread::yield ();
-			lock.lock ();
 		}
 		else
 		{
+			std::unique_lock<std::mutex> lock (mutex);
 			idle = true;
 			condition.notify_all ();
-			condition.wait (lock);
+			std::atomic_thread_fence (std::memory_order_seq_cst);
+			while (!stopped && empty ())
+			{
+				condition.wait (lock);
+			}
 			idle = false;
 		}
 	}
+	discard ();
 }
 
 void rai::block_processor::process_receive_many (rai::block_processor_item const & item_a)
@@ -1195,8 +2214,9 @@ void rai::block_processor::process_receive_many (std::deque<rai::block_processor
 	while (!blocks_processing.empty ())
 	{
 		std::deque<std::pair<std::shared_ptr<rai::block>, rai::process_return>> progress;
-		{
-			rai::transaction transaction (node.store.environment, nullptr, true);
+		std::vector<std::shared_ptr<std::promise<void>>> waiting;
+		// Other queued writes share this transaction rather than waiting on the write lock
+		node.write_scheduler.submit_wait ([this, &blocks_processing, &progress, &waiting](MDB_txn * transaction) {
 			auto cutoff (std::chrono::steady_clock::now () + rai::transaction_timeout);
 			while (!blocks_processing.empty () && std::chrono::steady_clock::now () < cutoff)
 			{
@@ -1213,19 +2233,33 @@ void rai::block_processor::process_receive_many (std::deque<rai::block_processor
 						node.ledger.rollback (transaction, successor->hash ());
 					}
 				}
-				auto process_result (process_receive_one (transaction, item.block));
+				auto process_result (process_receive_one (transaction, item.block, item.verified));
+				if (item.arrival != std::chrono::steady_clock::time_point ())
+				{
+					auto & lane_l (lane (item.origin));
+					++lane_l.processed;
+					lane_l.latency_microseconds += std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - item.arrival).count ();
+				}
+				if (item.processed != nullptr)
+				{
+					waiting.push_back (item.processed);
+				}
 				switch (process_result.code)
 				{
 					case rai::process_result::progress:
 					{
 						progress.push_back (std::make_pair (item.block, process_result));
+						if (node.block_arrival.recent (hash))
+						{
+							// Elections generate our vote, it's written in this batch rather than in a transaction of its own
+							node.active.start (transaction, item.block);
+						}
 					}
 					case rai::process_result::old:
 					{
-						auto cached (node.store.unchecked_get (transaction, hash));
-						for (auto i (cached.begin ()), n (cached.end ()); i != n; ++i)
+						auto released (node.store.unchecked_release (transaction, hash));
+						for (auto i (released.begin ()), n (released.end ()); i != n; ++i)
 						{
-							node.store.unchecked_del (transaction, hash, **i);
 							blocks_processing.push_front (rai::block_processor_item (*i));
 						}
 						std::lock_guard<std::mutex> lock (node.gap_cache.mutex);
@@ -1236,7 +2270,7 @@ void rai::block_processor::process_receive_many (std::deque<rai::block_processor
 						break;
 				}
 			}
-		}
+		});
 		for (auto & i : progress)
 		{
 			node.observers.blocks (i.first, i.second.account, i.second.amount);
@@ -1249,13 +2283,80 @@ void rai::block_processor::process_receive_many (std::deque<rai::block_processor
 				}
 			}
 		}
+		for (auto & i : waiting)
+		{
+			i->set_value ();
+		}
+	}
+}
+
+void rai::block_processor::verify_signatures (std::deque<rai::block_processor_item> & blocks_a)
+{
+	std::vector<rai::block_processor_item *> items;
+	std::vector<rai::block_hash> hashes;
+	std::vector<rai::account> accounts;
+	items.reserve (blocks_a.size ());
+	hashes.reserve (blocks_a.size ());
+	accounts.reserve (blocks_a.size ());
+	{
+		// Blocks pulled during bootstrap usually extend each other so accounts are also resolved from earlier blocks in the batch
+		std::unordered_map<rai::block_hash, rai::account> batch_accounts;
+		rai::transaction transaction (node.store.environment, nullptr, false);
+		for (auto & i : blocks_a)
+		{
+			auto hash (i.block->hash ());
+			rai::account account (0);
+			if (i.block->type () == rai::block_type::open)
+			{
+				account = static_cast<rai::open_block const &> (*i.block).hashables.account;
+			}
+			else
+			{
+				auto previous (i.block->previous ());
+				auto existing (batch_accounts.find (previous));
+				account = existing != batch_accounts.end () ? existing->second : node.store.frontier_get (transaction, previous);
+			}
+			if (!account.is_zero ())
+			{
+				batch_accounts[hash] = account;
+				items.push_back (&i);
+				hashes.push_back (hash);
+				accounts.push_back (account);
+			}
+		}
+	}
+	auto size (items.size ());
+	if (size > 0)
+	{
+		std::vector<unsigned char const *> messages (size);
+		std::vector<size_t> lengths (size, sizeof (rai::block_hash));
+		std::vector<unsigned char const *> keys (size);
+		std::vector<rai::signature> signatures (size);
+		std::vector<unsigned char const *> signature_pointers (size);
+		std::vector<int> valid (size, 0);
+		for (size_t i (0); i < size; ++i)
+		{
+			messages[i] = hashes[i].bytes.data ();
+			keys[i] = accounts[i].bytes.data ();
+			signatures[i] = items[i]->block->block_signature ();
+			signature_pointers[i] = signatures[i].bytes.data ();
+		}
+		node.checker.verify (size, messages.data (), lengths.data (), keys.data (), signature_pointers.data (), valid.data ());
+		for (size_t i (0); i < size; ++i)
+		{
+			// Failed checks are left unverified so the ledger reports them with its usual checks
+			if (valid[i] == 1)
+			{
+				items[i]->verified = accounts[i];
+			}
+		}
 	}
 }
 
-rai::process_return rai::block_processor::process_receive_one (MDB_txn * transaction_a, std::shared_ptr<rai::block> block_a)
+rai::process_return rai::block_processor::process_receive_one (MDB_txn * transaction_a, std::shared_ptr<rai::block> block_a, rai::account const & verified_a)
 {
 	rai::process_return result;
-	result = node.ledger.process (transaction_a, *block_a);
+	result = node.ledger.process (transaction_a, *block_a, verified_a);
 	switch (result.code)
 	{
 		case rai::process_result::progress:
@@ -1388,7 +2489,7 @@ service (service_a),
 config (config_a),
 alarm (alarm_a),
 work (work_a),
-store (init_a.block_store_init, application_path_a / "data.ldb", config_a.lmdb_max_dbs),
+store (init_a.block_store_init, application_path_a / "data.ldb", config_a.lmdb_max_dbs, config_a.block_cache_size, config_a.unchecked_cache_size, config_a.lmdb_flags (), config_a.lmdb_map_size, config_a.block_info_stride, config_a.block_info_dense_threshold),
 gap_cache (*this),
 ledger (store, config_a.inactive_supply.number ()),
 active (*this),
@@ -1399,11 +2500,20 @@ bootstrap (service_a, config.peering_port, *this),
 peers (network.endpoint ()),
 application_path (application_path_a),
 port_mapping (*this),
+checker (config.signature_checker_threads),
 vote_processor (*this),
 warmed_up (0),
+write_scheduler (store, log, config.write_batch_size, std::chrono::milliseconds (config.write_batch_interval)),
+write_scheduler_thread ([this]() { this->write_scheduler.run (); }),
 block_processor (*this),
 block_processor_thread ([this]() { this->block_processor.process_blocks (); })
 {
+	if (config.bootstrap_fast_mode)
+	{
+		bootstrap_initiator.add_observer ([this](bool in_progress_a) {
+			relax_durability (in_progress_a);
+		});
+	}
 	wallets.observer = [this](bool active) {
 		observers.wallet (active);
 	};
@@ -1413,13 +2523,6 @@ block_processor_thread ([this]() { this->block_processor.process_blocks (); })
 	peers.disconnect_observer = [this]() {
 		observers.disconnect ();
 	};
-	observers.blocks.add ([this](std::shared_ptr<rai::block> block_a, rai::account const & account_a, rai::amount const & amount_a) {
-		if (this->block_arrival.recent (block_a->hash ()))
-		{
-			rai::transaction transaction (store.environment, nullptr, true);
-			active.start (transaction, block_a);
-		}
-	});
 	observers.blocks.add ([this](std::shared_ptr<rai::block> block_a, rai::account const & account_a, rai::amount const & amount_a) {
 		if (this->block_arrival.recent (block_a->hash ()))
 		{
@@ -1524,9 +2627,6 @@ block_processor_thread ([this]() { this->block_processor.process_blocks (); })
 		this->network.send_keepalive (endpoint_a);
 		rep_query (*this, endpoint_a);
 	});
-	observers.vote.add ([this](std::shared_ptr<rai::vote> vote_a, rai::endpoint const &) {
-		active.vote (vote_a);
-	});
 	observers.vote.add ([this](std::shared_ptr<rai::vote> vote_a, rai::endpoint const &) {
 		this->gap_cache.vote (vote_a);
 	});
@@ -1650,8 +2750,8 @@ void rai::gap_cache::vote (std::shared_ptr<rai::vote> vote_a)
 	auto existing (blocks.get<1> ().find (hash));
 	if (existing != blocks.get<1> ().end ())
 	{
-		existing->votes->vote (vote_a);
-		auto winner (node.ledger.winner (transaction, *existing->votes));
+		existing->votes->vote (vote_a, node.ledger.weight (transaction, vote_a->account));
+		auto winner (existing->votes->leader ());
 		if (winner.first > bootstrap_threshold (transaction))
 		{
 			auto node_l (node.shared ());
@@ -1703,7 +2803,7 @@ void rai::network::confirm_send (rai::confirm_ack const & confirm_a, std::shared
 		BOOST_LOG (node.log) << boost::str (boost::format ("Sending confirm_ack for block %1% to %2% sequence %3%") % confirm_a.vote->block->hash ().to_string () % endpoint_a % std::to_string (confirm_a.vote->sequence));
 	}
 	std::weak_ptr<rai::node> node_w (node.shared ());
-	++outgoing.confirm_ack;
+	++socket_for (endpoint_a).outgoing.confirm_ack;
 	node.network.send_buffer (bytes_a->data (), bytes_a->size (), endpoint_a, [bytes_a, node_w, endpoint_a](boost::system::error_code const & ec, size_t size_a) {
 		if (auto node_l = node_w.lock ())
 		{
@@ -1869,6 +2969,10 @@ void rai::node::start ()
 	ongoing_keepalive ();
 	ongoing_bootstrap ();
 	ongoing_store_flush ();
+	if (config.lmdb_sync_interval > 0 && (config.lmdb_nosync || config.lmdb_nometasync || config.bootstrap_fast_mode))
+	{
+		ongoing_sync ();
+	}
 	ongoing_rep_crawl ();
 	bootstrap.start ();
 	backup_wallet ();
@@ -1886,6 +2990,8 @@ void rai::node::stop ()
 	{
 		block_processor_thread.join ();
 	}
+	vote_processor.stop ();
+	checker.stop ();
 	active.stop ();
 	network.stop ();
 	bootstrap_initiator.stop ();
@@ -1896,6 +3002,11 @@ void rai::node::stop ()
 	{
 		block_processor_thread.join ();
 	}
+	write_scheduler.stop ();
+	if (write_scheduler_thread.joinable ())
+	{
+		write_scheduler_thread.join ();
+	}
 }
 
 void rai::node::keepalive_preconfigured (std::vector<std::string> const & peers_a)
@@ -2009,11 +3120,19 @@ void rai::node::ongoing_bootstrap ()
 
 void rai::node::ongoing_store_flush ()
 {
-	{
-		rai::transaction transaction (store.environment, nullptr, true);
-		store.flush (transaction);
-	}
 	std::weak_ptr<rai::node> node_w (shared_from_this ());
+	write_scheduler.submit ([node_w](MDB_txn * transaction) {
+		if (auto node_l = node_w.lock ())
+		{
+			node_l->store.flush (transaction);
+			// Expiry is bounded per pass so a large backlog doesn't hold the write transaction for long
+			auto purged (node_l->store.unchecked_purge (transaction, rai::seconds_since_epoch () - node_l->config.unchecked_ttl, 64 * 1024));
+			if (purged > 0 && node_l->config.logging.ledger_logging ())
+			{
+				BOOST_LOG (node_l->log) << boost::str (boost::format ("Expired %1% unchecked blocks") % purged);
+			}
+		}
+	});
 	alarm.add (std::chrono::steady_clock::now () + std::chrono::seconds (5), [node_w]() {
 		if (auto node_l = node_w.lock ())
 		{
@@ -2022,6 +3141,35 @@ void rai::node::ongoing_store_flush ()
 	});
 }
 
+void rai::node::ongoing_sync ()
+{
+	// Flushing can take a long time after a fast bootstrap, it runs on the writer rather than an io thread and the next one is only scheduled once it's done
+	std::weak_ptr<rai::node> node_w (shared_from_this ());
+	write_scheduler.submit ([this, node_w](MDB_txn *) {
+		auto status (mdb_env_sync (store.environment, 1));
+		assert (status == 0);
+		alarm.add (std::chrono::steady_clock::now () + std::chrono::seconds (config.lmdb_sync_interval), [node_w]() {
+			if (auto node_l = node_w.lock ())
+			{
+				node_l->ongoing_sync ();
+			}
+		});
+	});
+}
+
+void rai::node::relax_durability (bool relax_a)
+{
+	if (!config.lmdb_nosync)
+	{
+		BOOST_LOG (log) << (relax_a ? "Relaxing database durability for bootstrap" : "Restoring database durability");
+		// Made on the writer so the change lines up with a commit, restoring syncs everything when that transaction commits
+		write_scheduler.submit ([this, relax_a](MDB_txn *) {
+			auto status (mdb_env_set_flags (store.environment, MDB_NOSYNC, relax_a ? 1 : 0));
+			assert (status == 0);
+		});
+	}
+}
+
 void rai::node::backup_wallet ()
 {
 	rai::transaction transaction (store.environment, nullptr, false);
@@ -2350,14 +3498,14 @@ void rai::node::process_confirmed (std::shared_ptr<rai::block> confirmed_a)
 
 void rai::node::process_message (rai::message & message_a, rai::endpoint const & sender_a)
 {
-	network_message_visitor visitor (*this, sender_a);
+	network_message_visitor visitor (*this, sender_a, network.socket_for (sender_a).incoming);
 	message_a.visit (visitor);
 }
 
 rai::endpoint rai::network::endpoint ()
 {
 	boost::system::error_code ec;
-	auto port (socket.local_endpoint (ec).port ());
+	auto port (sockets.front ()->socket.local_endpoint (ec).port ());
 	if (ec)
 	{
 		BOOST_LOG (node.log) << "Unable to retrieve port: " << ec.message ();
@@ -2712,18 +3860,31 @@ void rai::peer_container::contacted (rai::endpoint const & endpoint_a, unsigned
 
 void rai::network::send_buffer (uint8_t const * data_a, size_t size_a, rai::endpoint const & endpoint_a, std::function<void(boost::system::error_code const &, size_t)> callback_a)
 {
-	std::unique_lock<std::mutex> lock (socket_mutex);
-	if (node.config.logging.network_packet_logging ())
+	socket_for (endpoint_a).send_buffer (data_a, size_a, endpoint_a, callback_a);
+}
+
+void rai::network::broadcast (std::shared_ptr<std::vector<uint8_t>> buffer_a, std::vector<rai::endpoint> const & targets_a, rai::message_type type_a)
+{
+	std::unordered_map<rai::network_socket *, std::vector<rai::endpoint>> batches;
+	for (auto & i : targets_a)
 	{
-		BOOST_LOG (node.log) << "Sending packet";
+		batches[&socket_for (i)].push_back (i);
+	}
+	std::weak_ptr<rai::node> node_w (node.shared ());
+	for (auto & i : batches)
+	{
+		auto targets (i.second.size ());
+		i.first->outgoing.add (type_a, targets);
+		i.first->send_batch (std::make_shared<rai::datagram_batch> (buffer_a, i.second, [node_w, targets](boost::system::error_code const & ec, size_t sent_a) {
+			if (auto node_l = node_w.lock ())
+			{
+				if (ec && node_l->config.logging.network_logging ())
+				{
+					BOOST_LOG (node_l->log) << boost::str (boost::format ("Broadcast reached %1% of %2% peers: %3%") % sent_a % targets % ec.message ());
+				}
+			}
+		}));
 	}
-	socket.async_send_to (boost::asio::buffer (data_a, size_a), endpoint_a, [this, callback_a](boost::system::error_code const & ec, size_t size_a) {
-		callback_a (ec, size_a);
-		if (this->node.config.logging.network_packet_logging ())
-		{
-			BOOST_LOG (this->node.log) << "Packet send complete";
-		}
-	});
 }
 
 bool rai::peer_container::known_peer (rai::endpoint const & endpoint_a)
@@ -2754,18 +3915,18 @@ void rai::election::compute_rep_votes (MDB_txn * transaction_a)
 {
 	node.wallets.foreach_representative (transaction_a, [this, transaction_a](rai::public_key const & pub_a, rai::raw_key const & prv_a) {
 		auto vote (this->node.store.vote_generate (transaction_a, pub_a, prv_a, last_winner));
-		this->votes.vote (vote);
+		this->votes.vote (vote, this->node.ledger.weight (transaction_a, pub_a));
 	});
 }
 
 void rai::election::broadcast_winner ()
 {
-	{
-		rai::transaction transaction (node.store.environment, nullptr, true);
-		compute_rep_votes (transaction);
-	}
-	rai::transaction transaction_a (node.store.environment, nullptr, false);
-	node.network.republish_block (transaction_a, last_winner);
+	// Sequence numbers must be read under the write lock so a concurrent vote cache flush can't hand out a stale one
+	node.write_scheduler.submit_wait ([this](MDB_txn * transaction_a) {
+		compute_rep_votes (transaction_a);
+	});
+	rai::transaction transaction (node.store.environment, nullptr, false);
+	node.network.republish_block (transaction, last_winner);
 }
 
 rai::uint128_t rai::election::quorum_threshold (MDB_txn * transaction_a, rai::ledger & ledger_a)
@@ -2784,18 +3945,16 @@ void rai::election::confirm_once (MDB_txn * transaction_a)
 {
 	if (!confirmed.test_and_set ())
 	{
-		auto tally_l (node.ledger.tally (transaction_a, votes));
-		assert (tally_l.size () > 0);
-		auto winner (tally_l.begin ());
-		auto block_l (winner->second);
-		auto exceeded_min_threshold = winner->first > minimum_threshold (transaction_a, node.ledger);
+		auto winner (votes.leader ());
+		auto block_l (winner.second);
+		auto exceeded_min_threshold = winner.first > minimum_threshold (transaction_a, node.ledger);
 		if (!(*block_l == *last_winner))
 		{
 			if (exceeded_min_threshold)
 			{
 				auto node_l (node.shared ());
 				node.background ([node_l, block_l]() {
-					node_l->block_processor.process_receive_many (rai::block_processor_item (block_l, true));
+					node_l->block_processor.add (rai::block_processor_item (block_l, true));
 				});
 				last_winner = block_l;
 			}
@@ -2816,9 +3975,7 @@ void rai::election::confirm_once (MDB_txn * transaction_a)
 
 bool rai::election::have_quorum (MDB_txn * transaction_a)
 {
-	auto tally_l (node.ledger.tally (transaction_a, votes));
-	assert (tally_l.size () > 0);
-	auto result (tally_l.begin ()->first > quorum_threshold (transaction_a, node.ledger));
+	auto result (votes.leader ().first > quorum_threshold (transaction_a, node.ledger));
 	return result;
 }
 
@@ -2845,19 +4002,33 @@ void rai::election::confirm_cutoff (MDB_txn * transaction_a)
 }
 
 void rai::election::vote (std::shared_ptr<rai::vote> vote_a)
+{
+	rai::transaction transaction (node.store.environment, nullptr, true);
+	vote (transaction, vote_a);
+}
+
+void rai::election::vote (MDB_txn * transaction_a, std::shared_ptr<rai::vote> vote_a)
 {
 	node.network.republish_vote (last_vote, vote_a);
 	last_vote = std::chrono::steady_clock::now ();
-	rai::transaction transaction (node.store.environment, nullptr, true);
-	assert (node.store.vote_validate (transaction, vote_a).code != rai::vote_code::invalid);
-	votes.vote (vote_a);
-	confirm_if_quorum (transaction);
+	assert (node.store.vote_validate (transaction_a, vote_a).code != rai::vote_code::invalid);
+	votes.vote (vote_a, node.ledger.weight (transaction_a, vote_a->account));
+	confirm_if_quorum (transaction_a);
 }
 
 void rai::active_transactions::announce_votes ()
+{
+	// Runs as a write of the scheduler, the next round is queued once this one has been applied
+	auto node_l (node.shared ());
+	node.write_scheduler.submit ([node_l](MDB_txn * transaction) {
+		node_l->active.announce_votes (transaction);
+		node_l->alarm.add (std::chrono::steady_clock::now () + std::chrono::milliseconds (announce_interval_ms), [node_l]() { node_l->active.announce_votes (); });
+	});
+}
+
+void rai::active_transactions::announce_votes (MDB_txn * transaction)
 {
 	std::vector<rai::block_hash> inactive;
-	rai::transaction transaction (node.store.environment, nullptr, true);
 	std::lock_guard<std::mutex> lock (mutex);
 
 	{
@@ -2905,9 +4076,6 @@ void rai::active_transactions::announce_votes ()
 		assert (roots.find (*i) != roots.end ());
 		roots.erase (*i);
 	}
-	auto now (std::chrono::steady_clock::now ());
-	auto node_l (node.shared ());
-	node.alarm.add (now + std::chrono::milliseconds (announce_interval_ms), [node_l]() { node_l->active.announce_votes (); });
 }
 
 void rai::active_transactions::stop ()
@@ -2932,19 +4100,32 @@ bool rai::active_transactions::start (MDB_txn * transaction_a, std::shared_ptr<r
 // Validate a vote and apply it to the current election if one exists
 void rai::active_transactions::vote (std::shared_ptr<rai::vote> vote_a)
 {
-	std::shared_ptr<rai::election> election;
+	std::vector<std::shared_ptr<rai::vote>> votes_l (1, vote_a);
+	vote (votes_l);
+}
+
+void rai::active_transactions::vote (std::vector<std::shared_ptr<rai::vote>> const & votes_a)
+{
+	std::vector<std::pair<std::shared_ptr<rai::election>, std::shared_ptr<rai::vote>>> elections;
 	{
 		std::lock_guard<std::mutex> lock (mutex);
-		auto root (vote_a->block->root ());
-		auto existing (roots.find (root));
-		if (existing != roots.end ())
+		for (auto & i : votes_a)
 		{
-			election = existing->election;
+			auto existing (roots.find (i->block->root ()));
+			if (existing != roots.end ())
+			{
+				elections.push_back (std::make_pair (existing->election, i));
+			}
 		}
 	}
-	if (election)
+	if (!elections.empty ())
 	{
-		election->vote (vote_a);
+		node.write_scheduler.submit_wait ([&elections](MDB_txn * transaction) {
+			for (auto & i : elections)
+			{
+				i.first->vote (transaction, i.second);
+			}
+		});
 	}
 }
 
@@ -3669,7 +4850,34 @@ work (1, nullptr)
 {
 	boost::filesystem::create_directories (path);
 	logging.init (path);
-	node = std::make_shared<rai::node> (init, *service, 24000, path, alarm, logging, work);
+	rai::node_config config (24000, logging);
+	// Open the store with the node's configured layout, otherwise blocks_info is rebuilt at the default stride
+	auto config_path (path / "config.json");
+	if (boost::filesystem::exists (config_path))
+	{
+		try
+		{
+			boost::property_tree::ptree tree;
+			boost::property_tree::read_json (config_path.string (), tree);
+			auto node_l (tree.get_child_optional ("node"));
+			if (node_l)
+			{
+				rai::node_config configured;
+				auto upgraded (false);
+				if (!configured.deserialize_json (upgraded, *node_l))
+				{
+					config = configured;
+					config.peering_port = 24000;
+					config.logging = logging;
+				}
+			}
+		}
+		catch (std::runtime_error const &)
+		{
+			std::cerr << boost::str (boost::format ("Unable to read %1%, using the default node configuration\n") % config_path.string ());
+		}
+	}
+	node = std::make_shared<rai::node> (init, *service, path, alarm, config, work);
 }
 
 rai::inactive_node::~inactive_node ()
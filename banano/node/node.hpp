@@ -44,6 +44,7 @@ class election : public std::enable_shared_from_this<rai::election>
 public:
 	election (MDB_txn *, rai::node &, std::shared_ptr<rai::block>, std::function<void(std::shared_ptr<rai::block>, bool)> const &);
 	void vote (std::shared_ptr<rai::vote>);
+	void vote (MDB_txn *, std::shared_ptr<rai::vote>);
 	// Check if we have vote quorum
 	bool have_quorum (MDB_txn *);
 	// Tell the network our view of the winner
@@ -80,9 +81,12 @@ public:
 	// Call action with confirmed block, may be different than what we started with
 	bool start (MDB_txn *, std::shared_ptr<rai::block>, std::function<void(std::shared_ptr<rai::block>, bool)> const & = [](std::shared_ptr<rai::block>, bool) {});
 	void vote (std::shared_ptr<rai::vote>);
+	// Apply a group of validated votes inside a single transaction
+	void vote (std::vector<std::shared_ptr<rai::vote>> const &);
 	// Is the root of this block in the roots container
 	bool active (rai::block const &);
 	void announce_votes ();
+	void announce_votes (MDB_txn *);
 	void stop ();
 	boost::multi_index_container<
 	rai::conflict_info,
@@ -268,6 +272,8 @@ class message_statistics
 {
 public:
 	message_statistics ();
+	uint64_t get (rai::message_type) const;
+	void add (rai::message_type, uint64_t);
 	std::atomic<uint64_t> keepalive;
 	std::atomic<uint64_t> publish;
 	std::atomic<uint64_t> confirm_req;
@@ -294,13 +300,77 @@ public:
 	arrival;
 	std::mutex mutex;
 };
+class udp_datagram
+{
+public:
+	rai::endpoint endpoint;
+	size_t size;
+	std::array<uint8_t, 512> buffer;
+};
+// Reads as many datagrams as are waiting, up to the number of buffers, in one system call without blocking
+// Sets operation_not_supported where the platform has no batched receive
+size_t receive_datagrams (boost::asio::ip::udp::socket &, std::vector<rai::udp_datagram> &, boost::system::error_code &);
+// Lets several sockets bind the same port with the kernel spreading incoming datagrams between them
+// Sets operation_not_supported where the platform can't do this
+void reuse_port (boost::asio::ip::udp::socket &, boost::system::error_code &);
+// Sends one buffer to as many of the endpoints as the socket accepts without blocking in a single system call, returns how many were sent
+// Sets operation_not_supported where the platform has no batched send
+size_t send_datagrams (boost::asio::ip::udp::socket &, uint8_t const *, size_t, rai::endpoint const *, size_t, boost::system::error_code &);
+// The same datagram addressed to a list of peers
+class datagram_batch
+{
+public:
+	datagram_batch (std::shared_ptr<std::vector<uint8_t>>, std::vector<rai::endpoint> const &, std::function<void(boost::system::error_code const &, size_t)> const &);
+	std::shared_ptr<std::vector<uint8_t>> buffer;
+	std::vector<rai::endpoint> targets;
+	// Next target to send to
+	size_t position;
+	size_t sent;
+	// First error seen, later targets are still attempted
+	boost::system::error_code error;
+	// Called once with the first error and the number of datagrams sent
+	std::function<void(boost::system::error_code const &, size_t)> callback;
+};
+class network;
+// One UDP socket bound to the peering port, serviced by its own thread
+class network_socket
+{
+public:
+	network_socket (rai::network &, uint16_t, bool);
+	~network_socket ();
+	void receive ();
+	void stop ();
+	void receive_action (boost::system::error_code const &, size_t);
+	void receive_batch_action (boost::system::error_code const &);
+	void send_buffer (uint8_t const *, size_t, rai::endpoint const &, std::function<void(boost::system::error_code const &, size_t)>);
+	void send_batch (std::shared_ptr<rai::datagram_batch>);
+	void send_batch_next (std::shared_ptr<rai::datagram_batch>);
+	void send_batch_single (std::shared_ptr<rai::datagram_batch>);
+	void send_batch_finish (std::shared_ptr<rai::datagram_batch>);
+	rai::network & network;
+	boost::asio::io_service service;
+	std::unique_ptr<boost::asio::io_service::work> work;
+	rai::endpoint remote;
+	std::array<uint8_t, 512> buffer;
+	// Receive ring refilled by each batched receive, empty when datagrams are read one at a time
+	std::vector<rai::udp_datagram> datagrams;
+	boost::asio::ip::udp::socket socket;
+	std::mutex socket_mutex;
+	// Whether other sockets may bind the same port
+	bool shared;
+	rai::message_statistics incoming;
+	rai::message_statistics outgoing;
+	std::atomic<uint64_t> batches;
+	std::atomic<uint64_t> batch_errors;
+	std::thread thread;
+};
 class network
 {
 public:
 	network (rai::node &, uint16_t);
 	void receive ();
 	void stop ();
-	void receive_action (boost::system::error_code const &, size_t);
+	void process_datagram (rai::endpoint const &, uint8_t const *, size_t, rai::message_statistics &);
 	void rpc_action (boost::system::error_code const &, size_t);
 	void rebroadcast_reps (std::shared_ptr<rai::block>);
 	void republish_vote (std::chrono::steady_clock::time_point const &, std::shared_ptr<rai::vote>);
@@ -313,19 +383,21 @@ public:
 	void broadcast_confirm_req (std::shared_ptr<rai::block>);
 	void send_confirm_req (rai::endpoint const &, std::shared_ptr<rai::block>);
 	void send_buffer (uint8_t const *, size_t, rai::endpoint const &, std::function<void(boost::system::error_code const &, size_t)>);
+	// Sends an already serialized message to every target, one batch per socket
+	void broadcast (std::shared_ptr<std::vector<uint8_t>>, std::vector<rai::endpoint> const &, rai::message_type);
+	// Traffic with a given peer always goes through the same socket
+	rai::network_socket & socket_for (rai::endpoint const &);
+	// Sum of the per socket message counters
+	uint64_t incoming_count (rai::message_type);
+	uint64_t outgoing_count (rai::message_type);
 	rai::endpoint endpoint ();
-	rai::endpoint remote;
-	std::array<uint8_t, 512> buffer;
-	boost::asio::ip::udp::socket socket;
-	std::mutex socket_mutex;
 	boost::asio::ip::udp::resolver resolver;
 	rai::node & node;
+	std::vector<std::unique_ptr<rai::network_socket>> sockets;
 	uint64_t bad_sender_count;
 	bool on;
 	uint64_t insufficient_work_count;
 	uint64_t error_count;
-	rai::message_statistics incoming;
-	rai::message_statistics outgoing;
 	static uint16_t const node_port = rai::rai_network == rai::rai_networks::rai_live_network ? 7071 : 54001;
 };
 class logging
@@ -402,10 +474,34 @@ public:
 	bool enable_voting;
 	unsigned bootstrap_connections;
 	unsigned bootstrap_connections_max;
+	unsigned signature_checker_threads;
+	unsigned block_processor_capacity;
+	unsigned block_processor_high_water;
+	unsigned udp_receive_batch;
+	unsigned udp_sockets;
+	unsigned block_cache_size;
+	unsigned unchecked_cache_size;
+	unsigned unchecked_ttl;
+	unsigned write_batch_size;
+	unsigned write_batch_interval;
 	std::string callback_address;
 	uint16_t callback_port;
 	std::string callback_target;
 	int lmdb_max_dbs;
+	bool lmdb_nosync;
+	bool lmdb_nometasync;
+	bool lmdb_writemap;
+	bool lmdb_nordahead;
+	uint64_t lmdb_map_size;
+	// Seconds between forced syncs when commits don't sync on their own, zero disables
+	unsigned lmdb_sync_interval;
+	// Commits skip syncing while a bootstrap attempt runs
+	bool bootstrap_fast_mode;
+	// Blocks between balance index records, changing it rebuilds the index on the next start
+	uint64_t block_info_stride;
+	// Chain height from which every block gets a balance index record, zero disables
+	uint64_t block_info_dense_threshold;
+	unsigned lmdb_flags () const;
 	static std::chrono::seconds constexpr keepalive_period = std::chrono::seconds (60);
 	static std::chrono::seconds constexpr keepalive_cutoff = keepalive_period * 5;
 	static std::chrono::minutes constexpr wallet_backup_interval = std::chrono::minutes (5);
@@ -421,12 +517,54 @@ public:
 	rai::observer_set<> disconnect;
 	rai::observer_set<> started;
 };
+// Checks batches of signatures in parallel on a set of dedicated threads
+class signature_checker
+{
+public:
+	signature_checker (unsigned);
+	~signature_checker ();
+	// Blocks until every signature is checked, valid[i] is set to 1 for each correct signature
+	void verify (size_t, unsigned char const **, size_t *, unsigned char const **, unsigned char const **, int *);
+	void stop ();
+	void run ();
+	// Signatures checked per task handed to a thread
+	static size_t constexpr batch_size = 256;
+
+private:
+	bool stopped;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::vector<std::thread> threads;
+};
+// Votes are queued and processed in batches on a dedicated thread
+// Signatures are checked together in parallel and valid votes are handed to elections in groups
 class vote_processor
 {
 public:
 	vote_processor (rai::node &);
-	rai::vote_result vote (std::shared_ptr<rai::vote>, rai::endpoint);
+	~vote_processor ();
+	// Queue a vote for processing, returns true if the vote was dropped because the queue is full
+	bool vote (std::shared_ptr<rai::vote>, rai::endpoint);
+	void process_loop ();
+	void process_votes (std::deque<std::pair<std::shared_ptr<rai::vote>, rai::endpoint>> &);
+	void flush ();
+	void stop ();
 	rai::node & node;
+	// Votes are dropped instead of queued past this many waiting votes
+	static size_t constexpr max_votes = 64 * 1024;
+	// Largest number of votes checked and applied together
+	static size_t constexpr batch_size = 4096;
+	// Replays within this many sequence numbers of a cached vote are dropped before their signature is checked
+	static uint64_t constexpr replay_window = 10000;
+
+private:
+	bool stopped;
+	bool idle;
+	std::deque<std::pair<std::shared_ptr<rai::vote>, rai::endpoint>> votes;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread thread;
 };
 // The network is crawled for representatives by occasionally sending a unicast confirm_req for a specific block and watching to see if it's acknowledged with a vote.
 class rep_crawler
@@ -438,6 +576,42 @@ public:
 	std::mutex mutex;
 	std::unordered_set<rai::block_hash> active;
 };
+// Where a block came from, each origin is queued on its own block processor lane
+enum class block_origin
+{
+	live,
+	wallet,
+	bootstrap
+};
+// Single writer for the node database
+// Writes queued while a transaction is open are coalesced into the next one instead of each contending for the LMDB write lock
+class write_scheduler
+{
+public:
+	write_scheduler (rai::block_store &, boost::log::sources::logger_mt &, size_t, std::chrono::milliseconds);
+	~write_scheduler ();
+	// Queues a write for the next transaction
+	void submit (std::function<void(MDB_txn *)> const &);
+	// Queues a write and waits until its transaction has committed
+	void submit_wait (std::function<void(MDB_txn *)> const &);
+	void stop ();
+	void run ();
+	std::atomic<uint64_t> transactions;
+	std::atomic<uint64_t> writes;
+
+private:
+	void enqueue (std::function<void(MDB_txn *)> const &, std::shared_ptr<std::promise<void>>);
+	void write (MDB_txn *, std::pair<std::function<void(MDB_txn *)>, std::shared_ptr<std::promise<void>>> const &, std::vector<std::shared_ptr<std::promise<void>>> &);
+	rai::block_store & store;
+	boost::log::sources::logger_mt & log;
+	// Writes per transaction and how long a transaction stays open before it's committed
+	size_t const batch_size;
+	std::chrono::milliseconds const interval;
+	std::deque<std::pair<std::function<void(MDB_txn *)>, std::shared_ptr<std::promise<void>>>> queue;
+	bool stopped;
+	std::mutex mutex;
+	std::condition_variable condition;
+};
 class block_processor_item
 {
 public:
@@ -445,6 +619,24 @@ public:
 	block_processor_item (std::shared_ptr<rai::block>, bool);
 	std::shared_ptr<rai::block> block;
 	bool force;
+	// Account the block signature was checked against ahead of processing, zero if unchecked
+	rai::account verified;
+	rai::block_origin origin;
+	// Set when queued, blocks revisited from unchecked don't have one
+	std::chrono::steady_clock::time_point arrival;
+	// Fulfilled once the block and its observers have been processed
+	std::shared_ptr<std::promise<void>> processed;
+};
+class block_processor_lane
+{
+public:
+	block_processor_lane (size_t, unsigned);
+	rai::mpmc_queue<rai::block_processor_item> blocks;
+	// Blocks taken from this lane per scheduling round
+	unsigned const weight;
+	std::atomic<uint64_t> processed;
+	// Total time processed blocks spent between being queued and being written
+	std::atomic<uint64_t> latency_microseconds;
 };
 // Processing blocks is a potentially long IO operation
 // This class isolates block insertion from other operations like servicing network operations
@@ -455,18 +647,49 @@ public:
 	~block_processor ();
 	void stop ();
 	void flush ();
-	void add (rai::block_processor_item const &);
+	// Returns true if the block wasn't queued, unforced live blocks are dropped when their lane is full, everything else waits for room
+	bool add (rai::block_processor_item const &, rai::block_origin = rai::block_origin::live);
+	// Queues a batch in order without waiting, stops at the first block that doesn't fit and returns how many were queued
+	size_t add (std::vector<rai::block_processor_item> const &, rai::block_origin);
+	// Queues on the wallet lane and waits until the block has been processed
+	void process_wait (rai::block_processor_item const &);
+	// Bootstrap lane depth reached the configured high-water mark, bootstrap pulls back off until it drains
+	bool saturated () const;
+	size_t size () const;
+	rai::block_processor_lane & lane (rai::block_origin);
 	void process_receive_many (rai::block_processor_item const &);
 	void process_receive_many (std::deque<rai::block_processor_item> &);
-	rai::process_return process_receive_one (MDB_txn *, std::shared_ptr<rai::block>);
+	rai::process_return process_receive_one (MDB_txn *, std::shared_ptr<rai::block>, rai::account const & = rai::account (0));
+	// Batch check signatures of blocks whose signing account can be found without a write transaction
+	void verify_signatures (std::deque<rai::block_processor_item> &);
 	void process_blocks ();
+	// Fills a batch round robin across lanes, taking up to each lane's weight per round
+	void next_batch (std::deque<rai::block_processor_item> &);
+	std::atomic<uint64_t> enqueued;
+	// Number of adds that found a lane full and the total time they spent waiting for room
+	std::atomic<uint64_t> enqueue_waits;
+	std::atomic<uint64_t> enqueue_wait_microseconds;
+	// Live blocks dropped because their lane was full
+	std::atomic<uint64_t> dropped;
+	static size_t constexpr batch_size = 4096;
+	static size_t constexpr wallet_capacity = 1024;
 
 private:
-	bool stopped;
-	bool idle;
-	std::deque<rai::block_processor_item> blocks;
+	bool push (rai::block_processor_item const &, rai::block_origin, bool);
+	void wake ();
+	bool empty () const;
+	void discard ();
+	// Adds waiting for room on a full lane, woken through room after each batch is taken
+	std::atomic<unsigned> waiting;
+	std::atomic<bool> stopped;
+	std::atomic<bool> idle;
+	// Indexed by rai::block_origin, in scheduling order
+	std::array<std::unique_ptr<rai::block_processor_lane>, 3> lanes;
+	size_t high_water;
+	// Taken to park the processing thread when every lane is empty and by adds waiting for room
 	std::mutex mutex;
 	std::condition_variable condition;
+	std::condition_variable room;
 	rai::node & node;
 };
 class node : public std::enable_shared_from_this<rai::node>
@@ -502,6 +725,8 @@ public:
 	void ongoing_rep_crawl ();
 	void ongoing_bootstrap ();
 	void ongoing_store_flush ();
+	void ongoing_sync ();
+	void relax_durability (bool);
 	void backup_wallet ();
 	int price (rai::uint128_t const &, int);
 	void generate_work (rai::block &);
@@ -525,9 +750,12 @@ public:
 	rai::node_observers observers;
 	rai::wallets wallets;
 	rai::port_mapping port_mapping;
+	rai::signature_checker checker;
 	rai::vote_processor vote_processor;
 	rai::rep_crawler rep_crawler;
 	unsigned warmed_up;
+	rai::write_scheduler write_scheduler;
+	std::thread write_scheduler_thread;
 	rai::block_processor block_processor;
 	std::thread block_processor_thread;
 	rai::block_arrival block_arrival;
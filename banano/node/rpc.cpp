@@ -223,6 +223,47 @@ bool decode_unsigned (std::string const & text, uint64_t & number)
 	result = result || end != text.size ();
 	return result;
 }
+
+// Pending entries of each account as returned by the pending RPCs, read in one pass over the pending table
+// Accounts whose total can't reach the threshold are skipped without reading their entries
+std::unordered_map<rai::account, boost::property_tree::ptree> pending_entries (rai::block_store & store_a, MDB_txn * transaction_a, std::vector<rai::account> const & accounts_a, uint64_t count_a, rai::uint128_t const & threshold_a, bool source_a)
+{
+	std::unordered_map<rai::account, boost::property_tree::ptree> result;
+	std::vector<rai::account> accounts;
+	for (auto & i : accounts_a)
+	{
+		auto total (store_a.pending_total_get (transaction_a, i));
+		if (total.count > 0 && total.amount >= threshold_a && count_a > 0)
+		{
+			accounts.push_back (i);
+		}
+	}
+	store_a.pending_for_each (transaction_a, accounts, [&result, count_a, &threshold_a, source_a](rai::pending_key const & key_a, rai::pending_info const & info_a) {
+		auto & peers_l (result[key_a.account]);
+		if (threshold_a.is_zero () && !source_a)
+		{
+			boost::property_tree::ptree entry;
+			entry.put ("", key_a.hash.to_string ());
+			peers_l.push_back (std::make_pair ("", entry));
+		}
+		else if (info_a.amount.number () >= threshold_a)
+		{
+			if (source_a)
+			{
+				boost::property_tree::ptree pending_tree;
+				pending_tree.put ("amount", info_a.amount.number ().convert_to<std::string> ());
+				pending_tree.put ("source", info_a.source.to_account ());
+				peers_l.add_child (key_a.hash.to_string (), pending_tree);
+			}
+			else
+			{
+				peers_l.put (key_a.hash.to_string (), info_a.amount.number ().convert_to<std::string> ());
+			}
+		}
+		return peers_l.size () < count_a;
+	});
+	return result;
+}
 }
 
 void rai::rpc_handler::account_balance ()
@@ -841,50 +882,26 @@ void rai::rpc_handler::accounts_pending ()
 	}
 	boost::property_tree::ptree response_l;
 	boost::property_tree::ptree pending;
-	rai::transaction transaction (node.store.environment, nullptr, false);
+	std::vector<rai::account> accounts_l;
 	for (auto & accounts : request.get_child ("accounts"))
 	{
 		std::string account_text = accounts.second.data ();
 		rai::uint256_union account;
 		if (!account.decode_account (account_text))
 		{
-			boost::property_tree::ptree peers_l;
-			rai::account end (account.number () + 1);
-			for (auto i (node.store.pending_begin (transaction, rai::pending_key (account, 0))), n (node.store.pending_begin (transaction, rai::pending_key (end, 0))); i != n && peers_l.size () < count; ++i)
-			{
-				rai::pending_key key (i->first);
-				if (threshold.is_zero () && !source)
-				{
-					boost::property_tree::ptree entry;
-					entry.put ("", key.hash.to_string ());
-					peers_l.push_back (std::make_pair ("", entry));
-				}
-				else
-				{
-					rai::pending_info info (i->second);
-					if (info.amount.number () >= threshold.number ())
-					{
-						if (source)
-						{
-							boost::property_tree::ptree pending_tree;
-							pending_tree.put ("amount", info.amount.number ().convert_to<std::string> ());
-							pending_tree.put ("source", info.source.to_account ());
-							peers_l.add_child (key.hash.to_string (), pending_tree);
-						}
-						else
-						{
-							peers_l.put (key.hash.to_string (), info.amount.number ().convert_to<std::string> ());
-						}
-					}
-				}
-			}
-			pending.add_child (account.to_account (), peers_l);
+			accounts_l.push_back (account);
 		}
 		else
 		{
 			error_response (response, "Bad account number");
 		}
 	}
+	rai::transaction transaction (node.store.environment, nullptr, false);
+	auto entries (pending_entries (node.store, transaction, accounts_l, count, threshold.number (), source));
+	for (auto & account : accounts_l)
+	{
+		pending.add_child (account.to_account (), entries[account]);
+	}
 	response_l.add_child ("blocks", pending);
 	response (response_l);
 }
@@ -1376,6 +1393,41 @@ void rai::rpc_handler::successors ()
 	}
 }
 
+void rai::rpc_handler::block_cache ()
+{
+	boost::property_tree::ptree response_l;
+	response_l.put ("hits", std::to_string (node.store.block_cache.hits));
+	response_l.put ("misses", std::to_string (node.store.block_cache.misses));
+	response_l.put ("size", std::to_string (node.store.block_cache.size ()));
+	response_l.put ("capacity", std::to_string (node.store.block_cache.capacity));
+	response (response_l);
+}
+
+void rai::rpc_handler::block_processor ()
+{
+	boost::property_tree::ptree response_l;
+	boost::property_tree::ptree lanes_l;
+	std::vector<std::pair<std::string, rai::block_origin>> origins ({ { "live", rai::block_origin::live }, { "wallet", rai::block_origin::wallet }, { "bootstrap", rai::block_origin::bootstrap } });
+	for (auto & i : origins)
+	{
+		auto & lane (node.block_processor.lane (i.second));
+		uint64_t processed (lane.processed);
+		uint64_t latency (lane.latency_microseconds);
+		boost::property_tree::ptree entry;
+		entry.put ("depth", std::to_string (lane.blocks.size ()));
+		entry.put ("weight", std::to_string (lane.weight));
+		entry.put ("processed", std::to_string (processed));
+		entry.put ("average_latency_us", std::to_string (processed > 0 ? latency / processed : 0));
+		lanes_l.add_child (i.first, entry);
+	}
+	response_l.add_child ("lanes", lanes_l);
+	response_l.put ("enqueued", std::to_string (node.block_processor.enqueued));
+	response_l.put ("enqueue_waits", std::to_string (node.block_processor.enqueue_waits));
+	response_l.put ("enqueue_wait_us", std::to_string (node.block_processor.enqueue_wait_microseconds));
+	response_l.put ("dropped", std::to_string (node.block_processor.dropped));
+	response (response_l);
+}
+
 void rai::rpc_handler::bootstrap ()
 {
 	std::string address_text = request.get<std::string> ("address");
@@ -1411,6 +1463,61 @@ void rai::rpc_handler::bootstrap_any ()
 	response (response_l);
 }
 
+void rai::rpc_handler::bootstrap_status ()
+{
+	boost::property_tree::ptree response_l;
+	auto attempt (node.bootstrap_initiator.current_attempt ());
+	response_l.put ("in_progress", attempt != nullptr ? "1" : "0");
+	if (attempt != nullptr)
+	{
+		std::lock_guard<std::mutex> lock (attempt->mutex);
+		response_l.put ("pulls", std::to_string (attempt->pulls.size ()));
+		response_l.put ("pulling", std::to_string (attempt->pulling));
+		response_l.put ("connections", std::to_string (attempt->connections));
+		response_l.put ("target_connections", std::to_string (attempt->target));
+		response_l.put ("idle", std::to_string (attempt->idle.size ()));
+		response_l.put ("total_blocks", std::to_string (attempt->total_blocks));
+		response_l.put ("frontier_cursor", attempt->frontier_cursor.to_account ());
+		response_l.put ("frontiers_complete", attempt->frontiers_complete ? "1" : "0");
+		boost::property_tree::ptree peers;
+		for (auto & i : attempt->clients)
+		{
+			if (auto client = i.lock ())
+			{
+				boost::property_tree::ptree entry;
+				entry.put ("endpoint", boost::str (boost::format ("%1%") % client->endpoint));
+				entry.put ("blocks", std::to_string (client->block_count));
+				entry.put ("rate", std::to_string (client->rate));
+				entry.put ("rtt_ms", std::to_string (client->rtt_microseconds / 1000));
+				entry.put ("pulls_completed", std::to_string (client->pulls_completed));
+				entry.put ("pulls_failed", std::to_string (client->pulls_failed));
+				entry.put ("score", std::to_string (client->score ()));
+				std::string state ("pulling");
+				if (client->pending_stop)
+				{
+					state = "stopping";
+				}
+				else if (std::find (attempt->idle.begin (), attempt->idle.end (), client) != attempt->idle.end ())
+				{
+					state = "idle";
+				}
+				entry.put ("state", state);
+				peers.push_back (std::make_pair ("", entry));
+			}
+		}
+		response_l.add_child ("peers", peers);
+		boost::property_tree::ptree decisions;
+		for (auto & i : attempt->decisions)
+		{
+			boost::property_tree::ptree entry;
+			entry.put ("", i);
+			decisions.push_back (std::make_pair ("", entry));
+		}
+		response_l.add_child ("decisions", decisions);
+	}
+	response (response_l);
+}
+
 void rai::rpc_handler::chain ()
 {
 	std::string block_text (request.get<std::string> ("block"));
@@ -1463,16 +1570,21 @@ void rai::rpc_handler::delegators ()
 		boost::property_tree::ptree response_l;
 		boost::property_tree::ptree delegators;
 		rai::transaction transaction (node.store.environment, nullptr, false);
-		for (auto i (node.store.latest_begin (transaction)), n (node.store.latest_end ()); i != n; ++i)
+		auto done (false);
+		for (auto i (node.store.delegators_begin (transaction, account)), n (node.store.delegators_end ()); i != n && !done; ++i)
 		{
-			rai::account_info info (i->second);
-			auto block (node.store.block_get (transaction, info.rep_block));
-			assert (block != nullptr);
-			if (block->representative () == account)
+			auto key (reinterpret_cast<uint8_t const *> (i->first.data ()));
+			done = !std::equal (account.bytes.begin (), account.bytes.end (), key);
+			if (!done)
 			{
+				rai::account delegator;
+				std::copy (key + 32, key + 64, delegator.bytes.begin ());
+				rai::account_info info;
+				auto error (node.store.account_get (transaction, delegator, info));
+				assert (!error);
 				std::string balance;
 				rai::uint128_union (info.balance).encode_dec (balance);
-				delegators.put (rai::account (i->first.uint256 ()).to_account (), balance);
+				delegators.put (delegator.to_account (), balance);
 			}
 		}
 		response_l.add_child ("delegators", delegators);
@@ -1493,12 +1605,11 @@ void rai::rpc_handler::delegators_count ()
 	{
 		uint64_t count (0);
 		rai::transaction transaction (node.store.environment, nullptr, false);
-		for (auto i (node.store.latest_begin (transaction)), n (node.store.latest_end ()); i != n; ++i)
+		auto done (false);
+		for (auto i (node.store.delegators_begin (transaction, account)), n (node.store.delegators_end ()); i != n && !done; ++i)
 		{
-			rai::account_info info (i->second);
-			auto block (node.store.block_get (transaction, info.rep_block));
-			assert (block != nullptr);
-			if (block->representative () == account)
+			done = !std::equal (account.bytes.begin (), account.bytes.end (), reinterpret_cast<uint8_t const *> (i->first.data ()));
+			if (!done)
 			{
 				++count;
 			}
@@ -1658,7 +1769,7 @@ void rai::rpc_handler::history ()
 			boost::property_tree::ptree response_l;
 			boost::property_tree::ptree history;
 			rai::transaction transaction (node.store.environment, nullptr, false);
-			auto block (node.store.block_get (transaction, hash));
+			auto block (node.store.block_get_cached (transaction, hash));
 			while (block != nullptr && count > 0)
 			{
 				boost::property_tree::ptree entry;
@@ -1670,7 +1781,7 @@ void rai::rpc_handler::history ()
 					history.push_back (std::make_pair ("", entry));
 				}
 				hash = block->previous ();
-				block = node.store.block_get (transaction, hash);
+				block = node.store.block_get_cached (transaction, hash);
 				--count;
 			}
 			response_l.add_child ("history", history);
@@ -1698,27 +1809,43 @@ void rai::rpc_handler::account_history ()
 		uint64_t count;
 		if (!decode_unsigned (count_text, count))
 		{
-			boost::property_tree::ptree response_l;
-			boost::property_tree::ptree history;
-			rai::transaction transaction (node.store.environment, nullptr, false);
-			auto hash (node.ledger.latest (transaction, account));
-			auto block (node.store.block_get (transaction, hash));
-			while (block != nullptr && count > 0)
+			uint64_t offset (0);
+			boost::optional<std::string> offset_text (request.get_optional<std::string> ("offset"));
+			if (!offset_text.is_initialized () || !decode_unsigned (offset_text.get (), offset))
 			{
-				boost::property_tree::ptree entry;
-				history_visitor visitor (*this, transaction, entry, hash);
-				block->visit (visitor);
-				if (!entry.empty ())
+				boost::property_tree::ptree response_l;
+				boost::property_tree::ptree history;
+				rai::transaction transaction (node.store.environment, nullptr, false);
+				auto hash (node.ledger.latest (transaction, account));
+				if (offset > 0)
 				{
-					entry.put ("hash", hash.to_string ());
-					history.push_back (std::make_pair ("", entry));
+					// Seek to the block offset back from the head through the height index instead of walking to it
+					rai::account_info info;
+					auto error (node.store.account_get (transaction, account, info) || offset >= info.block_count);
+					hash = error ? rai::block_hash (0) : node.store.block_at_height (transaction, account, info.block_count - offset);
 				}
-				hash = block->previous ();
-				block = node.store.block_get (transaction, hash);
-				--count;
+				auto block (node.store.block_get_cached (transaction, hash));
+				while (block != nullptr && count > 0)
+				{
+					boost::property_tree::ptree entry;
+					history_visitor visitor (*this, transaction, entry, hash);
+					block->visit (visitor);
+					if (!entry.empty ())
+					{
+						entry.put ("hash", hash.to_string ());
+						history.push_back (std::make_pair ("", entry));
+					}
+					hash = block->previous ();
+					block = node.store.block_get_cached (transaction, hash);
+					--count;
+				}
+				response_l.add_child ("history", history);
+				response (response_l);
+			}
+			else
+			{
+				error_response (response, "Invalid offset");
 			}
-			response_l.add_child ("history", history);
-			response (response_l);
 		}
 		else
 		{
@@ -2728,24 +2855,20 @@ void rai::rpc_handler::representatives ()
 	}
 	boost::property_tree::ptree response_l;
 	boost::property_tree::ptree representatives;
-	rai::transaction transaction (node.store.environment, nullptr, false);
+	auto weights (node.store.rep_weights.list ());
 	if (!sorting) // Simple
 	{
-		for (auto i (node.store.representation_begin (transaction)), n (node.store.representation_end ()); i != n && representatives.size () < count; ++i)
+		for (auto i (weights.begin ()), n (weights.end ()); i != n && representatives.size () < count; ++i)
 		{
-			rai::account account (i->first.uint256 ());
-			auto amount (node.store.representation_get (transaction, account));
-			representatives.put (account.to_account (), amount.convert_to<std::string> ());
+			representatives.put (i->first.to_account (), i->second.convert_to<std::string> ());
 		}
 	}
 	else // Sorting
 	{
 		std::vector<std::pair<rai::uint128_union, std::string>> representation;
-		for (auto i (node.store.representation_begin (transaction)), n (node.store.representation_end ()); i != n; ++i)
+		for (auto & i : weights)
 		{
-			rai::account account (i->first.uint256 ());
-			auto amount (node.store.representation_get (transaction, account));
-			representation.push_back (std::make_pair (amount, account.to_account ()));
+			representation.push_back (std::make_pair (i.second, i.first.to_account ()));
 		}
 		std::sort (representation.begin (), representation.end ());
 		std::reverse (representation.begin (), representation.end ());
@@ -3661,42 +3784,18 @@ void rai::rpc_handler::wallet_pending ()
 			boost::property_tree::ptree response_l;
 			boost::property_tree::ptree pending;
 			rai::transaction transaction (node.store.environment, nullptr, false);
+			std::vector<rai::account> accounts;
 			for (auto i (existing->second->store.begin (transaction)), n (existing->second->store.end ()); i != n; ++i)
 			{
-				rai::account account (i->first.uint256 ());
-				boost::property_tree::ptree peers_l;
-				rai::account end (account.number () + 1);
-				for (auto ii (node.store.pending_begin (transaction, rai::pending_key (account, 0))), nn (node.store.pending_begin (transaction, rai::pending_key (end, 0))); ii != nn && peers_l.size () < count; ++ii)
-				{
-					rai::pending_key key (ii->first);
-					if (threshold.is_zero () && !source)
-					{
-						boost::property_tree::ptree entry;
-						entry.put ("", key.hash.to_string ());
-						peers_l.push_back (std::make_pair ("", entry));
-					}
-					else
-					{
-						rai::pending_info info (ii->second);
-						if (info.amount.number () >= threshold.number ())
-						{
-							if (source)
-							{
-								boost::property_tree::ptree pending_tree;
-								pending_tree.put ("amount", info.amount.number ().convert_to<std::string> ());
-								pending_tree.put ("source", info.source.to_account ());
-								peers_l.add_child (key.hash.to_string (), pending_tree);
-							}
-							else
-							{
-								peers_l.put (key.hash.to_string (), info.amount.number ().convert_to<std::string> ());
-							}
-						}
-					}
-				}
-				if (!peers_l.empty ())
+				accounts.push_back (i->first.uint256 ());
+			}
+			auto entries (pending_entries (node.store, transaction, accounts, count, threshold.number (), source));
+			for (auto & account : accounts)
+			{
+				auto peers_l (entries.find (account));
+				if (peers_l != entries.end () && !peers_l->second.empty ())
 				{
-					pending.add_child (account.to_account (), peers_l);
+					pending.add_child (account.to_account (), peers_l->second);
 				}
 			}
 			response_l.add_child ("blocks", pending);
@@ -4362,6 +4461,14 @@ void rai::rpc_handler::process_request ()
 		{
 			block_count_type ();
 		}
+		else if (action == "block_cache")
+		{
+			block_cache ();
+		}
+		else if (action == "block_processor")
+		{
+			block_processor ();
+		}
 		else if (action == "block_create")
 		{
 			block_create ();
@@ -4378,6 +4485,10 @@ void rai::rpc_handler::process_request ()
 		{
 			bootstrap_any ();
 		}
+		else if (action == "bootstrap_status")
+		{
+			bootstrap_status ();
+		}
 		else if (action == "chain")
 		{
 			chain ();
@@ -138,8 +138,11 @@ public:
 	void block_count ();
 	void block_count_type ();
 	void block_create ();
+	void block_cache ();
+	void block_processor ();
 	void bootstrap ();
 	void bootstrap_any ();
+	void bootstrap_status ();
 	void chain ();
 	void delegators ();
 	void delegators_count ();
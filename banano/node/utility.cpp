@@ -30,7 +30,7 @@ boost::filesystem::path rai::unique_path ()
 	return result;
 }
 
-rai::mdb_env::mdb_env (bool & error_a, boost::filesystem::path const & path_a, int max_dbs)
+rai::mdb_env::mdb_env (bool & error_a, boost::filesystem::path const & path_a, int max_dbs, unsigned flags_a, size_t map_size_a)
 {
 	boost::system::error_code error;
 	if (path_a.has_parent_path ())
@@ -42,12 +42,29 @@ rai::mdb_env::mdb_env (bool & error_a, boost::filesystem::path const & path_a, i
 			assert (status1 == 0);
 			auto status2 (mdb_env_set_maxdbs (environment, max_dbs));
 			assert (status2 == 0);
-			auto status3 (mdb_env_set_mapsize (environment, 1ULL * 1024 * 1024 * 1024 * 1024)); // 1 Terabyte
+			auto status3 (mdb_env_set_mapsize (environment, map_size_a));
 			assert (status3 == 0);
 			// It seems if there's ever more threads than mdb_env_set_maxreaders has read slots available, we get failures on transaction creation unless MDB_NOTLS is specified
 			// This can happen if something like 256 io_threads are specified in the node config
-			auto status4 (mdb_env_open (environment, path_a.string ().c_str (), MDB_NOSUBDIR | MDB_NOTLS, 00600));
+			auto status4 (mdb_env_open (environment, path_a.string ().c_str (), MDB_NOSUBDIR | MDB_NOTLS | flags_a, 00600));
 			error_a = status4 != 0;
+			if (!error_a)
+			{
+				// Resizing is only safe while no transactions are open so the map grows here, in whole gigabytes
+				MDB_envinfo info;
+				auto status5 (mdb_env_info (environment, &info));
+				assert (status5 == 0);
+				MDB_stat stat;
+				auto status6 (mdb_env_stat (environment, &stat));
+				assert (status6 == 0);
+				size_t const step (1024 * 1024 * 1024);
+				auto wanted ((info.me_last_pgno + 1) * stat.ms_psize * 2);
+				if (wanted > info.me_mapsize)
+				{
+					auto status7 (mdb_env_set_mapsize (environment, (wanted + step - 1) / step * step));
+					assert (status7 == 0);
+				}
+			}
 		}
 		else
 		{
@@ -104,7 +104,8 @@ bool fetch_object (T & object, boost::filesystem::path const & path_a, std::fstr
 class mdb_env
 {
 public:
-	mdb_env (bool &, boost::filesystem::path const &, int max_dbs = 128);
+	// Flags are added to MDB_NOSUBDIR | MDB_NOTLS, the map is grown at open to leave room for the data to double
+	mdb_env (bool &, boost::filesystem::path const &, int max_dbs = 128, unsigned flags = 0, size_t map_size = 1ULL * 1024 * 1024 * 1024 * 1024);
 	~mdb_env ();
 	operator MDB_env * () const;
 	MDB_env * environment;
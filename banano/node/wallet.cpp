@@ -875,7 +875,7 @@ std::shared_ptr<rai::block> rai::wallet::receive_action (rai::send_block const &
 	{
 		assert (block != nullptr);
 		node.block_arrival.add (block->hash ());
-		node.block_processor.process_receive_many (block);
+		node.block_processor.process_wait (block);
 		if (generate_work_a)
 		{
 			auto hash (block->hash ());
@@ -913,7 +913,7 @@ std::shared_ptr<rai::block> rai::wallet::change_action (rai::account const & sou
 	{
 		assert (block != nullptr);
 		node.block_arrival.add (block->hash ());
-		node.block_processor.process_receive_many (block);
+		node.block_processor.process_wait (block);
 		if (generate_work_a)
 		{
 			auto hash (block->hash ());
@@ -991,7 +991,7 @@ std::shared_ptr<rai::block> rai::wallet::send_action (rai::account const & sourc
 	if (!error && block != nullptr && !cached_block)
 	{
 		node.block_arrival.add (block->hash ());
-		node.block_processor.process_receive_many (block);
+		node.block_processor.process_wait (block);
 		auto hash (block->hash ());
 		auto this_l (shared_from_this ());
 		node.wallets.queue_wallet_action (rai::wallets::generate_priority, [this_l, source_a, hash] {
@@ -1118,7 +1118,7 @@ public:
 	{
 		for (auto i (wallet_a->store.begin (transaction_a)), n (wallet_a->store.end ()); i != n; ++i)
 		{
-			keys.insert (i->first.uint256 ());
+			keys.push_back (i->first.uint256 ());
 		}
 	}
 	void run ()
@@ -1126,42 +1126,36 @@ public:
 		BOOST_LOG (wallet->node.log) << "Beginning pending block search";
 		rai::transaction transaction (wallet->node.store.environment, nullptr, false);
 		std::unordered_set<rai::account> already_searched;
-		for (auto i (wallet->node.store.pending_begin (transaction)), n (wallet->node.store.pending_end ()); i != n; ++i)
-		{
-			rai::pending_key key (i->first);
-			rai::pending_info pending (i->second);
-			auto existing (keys.find (key.account));
-			if (existing != keys.end ())
+		wallet->node.store.pending_for_each (transaction, keys, [this, &transaction, &already_searched](rai::pending_key const & key, rai::pending_info const & pending) {
+			auto amount (pending.amount.number ());
+			if (wallet->node.config.receive_minimum.number () <= amount)
 			{
-				auto amount (pending.amount.number ());
-				if (wallet->node.config.receive_minimum.number () <= amount)
+				rai::account_info info;
+				auto error (wallet->node.store.account_get (transaction, pending.source, info));
+				assert (!error);
+				BOOST_LOG (wallet->node.log) << boost::str (boost::format ("Found a pending block %1% from account %2% with head %3%") % key.hash.to_string () % pending.source.to_account () % info.head.to_string ());
+				auto account (pending.source);
+				if (already_searched.find (account) == already_searched.end ())
 				{
-					rai::account_info info;
-					auto error (wallet->node.store.account_get (transaction, pending.source, info));
-					assert (!error);
-					BOOST_LOG (wallet->node.log) << boost::str (boost::format ("Found a pending block %1% from account %2% with head %3%") % key.hash.to_string () % pending.source.to_account () % info.head.to_string ());
-					auto account (pending.source);
-					if (already_searched.find (account) == already_searched.end ())
-					{
-						auto this_l (shared_from_this ());
-						std::shared_ptr<rai::block> block_l (wallet->node.store.block_get (transaction, info.head));
-						wallet->node.background ([this_l, account, block_l] {
-							rai::transaction transaction (this_l->wallet->node.store.environment, nullptr, true);
-							this_l->wallet->node.active.start (transaction, block_l, [this_l, account](std::shared_ptr<rai::block>, bool) {
-								// If there were any forks for this account they've been rolled back and we can receive anything remaining from this account
-								this_l->receive_all (account);
-							});
-							this_l->wallet->node.network.broadcast_confirm_req (block_l);
+					auto this_l (shared_from_this ());
+					std::shared_ptr<rai::block> block_l (wallet->node.store.block_get (transaction, info.head));
+					wallet->node.background ([this_l, account, block_l] {
+						rai::transaction transaction (this_l->wallet->node.store.environment, nullptr, true);
+						this_l->wallet->node.active.start (transaction, block_l, [this_l, account](std::shared_ptr<rai::block>, bool) {
+							// If there were any forks for this account they've been rolled back and we can receive anything remaining from this account
+							this_l->receive_all (account);
 						});
-						already_searched.insert (account);
-					}
-				}
-				else
-				{
-					BOOST_LOG (wallet->node.log) << boost::str (boost::format ("Not receiving block %1% due to minimum receive threshold") % key.hash.to_string ());
+						this_l->wallet->node.network.broadcast_confirm_req (block_l);
+					});
+					already_searched.insert (account);
 				}
 			}
-		}
+			else
+			{
+				BOOST_LOG (wallet->node.log) << boost::str (boost::format ("Not receiving block %1% due to minimum receive threshold") % key.hash.to_string ());
+			}
+			return true;
+		});
 		BOOST_LOG (wallet->node.log) << "Pending block search phase complete";
 	}
 	void receive_all (rai::account const & account_a)
@@ -1169,17 +1163,13 @@ public:
 		BOOST_LOG (wallet->node.log) << boost::str (boost::format ("Account %1% confirmed, receiving all blocks") % account_a.to_account ());
 		rai::transaction transaction (wallet->node.store.environment, nullptr, false);
 		auto representative (wallet->store.representative (transaction));
-		for (auto i (wallet->node.store.pending_begin (transaction)), n (wallet->node.store.pending_end ()); i != n; ++i)
-		{
-			rai::pending_key key (i->first);
-			rai::pending_info pending (i->second);
+		wallet->node.store.pending_for_each (transaction, keys, [this, &transaction, &representative, &account_a](rai::pending_key const & key, rai::pending_info const & pending) {
 			if (pending.source == account_a)
 			{
 				if (wallet->store.exists (transaction, key.account))
 				{
 					if (wallet->store.valid_password (transaction))
 					{
-						rai::pending_key key (i->first);
 						std::shared_ptr<rai::block> block (wallet->node.store.block_get (transaction, key.hash));
 						auto wallet_l (wallet);
 						auto amount (pending.amount.number ());
@@ -1198,9 +1188,11 @@ public:
 					}
 				}
 			}
-		}
+			return true;
+		});
 	}
-	std::unordered_set<rai::uint256_union> keys;
+	// Sorted as they come from the wallet store
+	std::vector<rai::account> keys;
 	std::shared_ptr<rai::wallet> wallet;
 };
 }
@@ -1265,11 +1257,13 @@ void rai::wallet::work_generate (rai::account const & account_a, rai::block_hash
 	{
 		BOOST_LOG (node.log) << "Work generation complete: " << (std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - begin).count ()) << " us";
 	}
-	rai::transaction transaction (store.environment, nullptr, true);
-	if (store.exists (transaction, account_a))
-	{
-		work_update (transaction, account_a, root_a, work);
-	}
+	// Wallets share the node database so the update is coalesced with other queued writes
+	node.write_scheduler.submit_wait ([this, &account_a, &root_a, work](MDB_txn * transaction_a) {
+		if (store.exists (transaction_a, account_a))
+		{
+			work_update (transaction_a, account_a, root_a, work);
+		}
+	});
 }
 
 rai::wallets::wallets (bool & error_a, rai::node & node_a) :
@@ -0,0 +1,18 @@
+#include <banano/node/node.hpp>
+
+size_t rai::receive_datagrams (boost::asio::ip::udp::socket &, std::vector<rai::udp_datagram> &, boost::system::error_code & error_a)
+{
+	error_a = boost::asio::error::operation_not_supported;
+	return 0;
+}
+
+void rai::reuse_port (boost::asio::ip::udp::socket &, boost::system::error_code & error_a)
+{
+	error_a = boost::asio::error::operation_not_supported;
+}
+
+size_t rai::send_datagrams (boost::asio::ip::udp::socket &, uint8_t const *, size_t, rai::endpoint const *, size_t, boost::system::error_code & error_a)
+{
+	error_a = boost::asio::error::operation_not_supported;
+	return 0;
+}
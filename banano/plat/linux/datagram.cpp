@@ -0,0 +1,85 @@
+#include <banano/node/node.hpp>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+size_t rai::receive_datagrams (boost::asio::ip::udp::socket & socket_a, std::vector<rai::udp_datagram> & datagrams_a, boost::system::error_code & error_a)
+{
+	// Headers are rebuilt every call but their storage is kept per receiving thread
+	thread_local std::vector<mmsghdr> headers;
+	thread_local std::vector<iovec> vectors;
+	headers.resize (datagrams_a.size ());
+	vectors.resize (datagrams_a.size ());
+	for (size_t i (0), n (datagrams_a.size ()); i < n; ++i)
+	{
+		auto & datagram (datagrams_a[i]);
+		vectors[i].iov_base = datagram.buffer.data ();
+		vectors[i].iov_len = datagram.buffer.size ();
+		headers[i].msg_hdr.msg_name = datagram.endpoint.data ();
+		headers[i].msg_hdr.msg_namelen = datagram.endpoint.capacity ();
+		headers[i].msg_hdr.msg_iov = &vectors[i];
+		headers[i].msg_hdr.msg_iovlen = 1;
+		headers[i].msg_hdr.msg_control = nullptr;
+		headers[i].msg_hdr.msg_controllen = 0;
+		headers[i].msg_hdr.msg_flags = 0;
+		headers[i].msg_len = 0;
+	}
+	size_t result (0);
+	auto received (recvmmsg (socket_a.native_handle (), headers.data (), headers.size (), MSG_DONTWAIT, nullptr));
+	if (received >= 0)
+	{
+		result = received;
+		for (size_t i (0); i < result; ++i)
+		{
+			datagrams_a[i].size = headers[i].msg_len;
+			datagrams_a[i].endpoint.resize (headers[i].msg_hdr.msg_namelen);
+		}
+	}
+	else if (errno != EAGAIN && errno != EWOULDBLOCK)
+	{
+		error_a = boost::system::error_code (errno, boost::system::system_category ());
+	}
+	return result;
+}
+
+void rai::reuse_port (boost::asio::ip::udp::socket & socket_a, boost::system::error_code & error_a)
+{
+	int enable (1);
+	if (setsockopt (socket_a.native_handle (), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof (enable)) != 0)
+	{
+		error_a = boost::system::error_code (errno, boost::system::system_category ());
+	}
+}
+
+size_t rai::send_datagrams (boost::asio::ip::udp::socket & socket_a, uint8_t const * data_a, size_t size_a, rai::endpoint const * endpoints_a, size_t count_a, boost::system::error_code & error_a)
+{
+	thread_local std::vector<mmsghdr> headers;
+	// Every message points at the same payload
+	iovec vector;
+	vector.iov_base = const_cast<uint8_t *> (data_a);
+	vector.iov_len = size_a;
+	auto count (std::min<size_t> (count_a, UIO_MAXIOV));
+	headers.resize (count);
+	for (size_t i (0); i < count; ++i)
+	{
+		headers[i].msg_hdr.msg_name = const_cast<sockaddr *> (endpoints_a[i].data ());
+		headers[i].msg_hdr.msg_namelen = endpoints_a[i].size ();
+		headers[i].msg_hdr.msg_iov = &vector;
+		headers[i].msg_hdr.msg_iovlen = 1;
+		headers[i].msg_hdr.msg_control = nullptr;
+		headers[i].msg_hdr.msg_controllen = 0;
+		headers[i].msg_hdr.msg_flags = 0;
+		headers[i].msg_len = 0;
+	}
+	size_t result (0);
+	auto sent (sendmmsg (socket_a.native_handle (), headers.data (), count, MSG_DONTWAIT | MSG_NOSIGNAL));
+	if (sent >= 0)
+	{
+		result = sent;
+	}
+	else if (errno != EAGAIN && errno != EWOULDBLOCK)
+	{
+		error_a = boost::system::error_code (errno, boost::system::system_category ());
+	}
+	return result;
+}